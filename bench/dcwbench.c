@@ -0,0 +1,257 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwbench -- microbenchmarks for dcwmsg_marshal(), dcwmsg_serialize() and
+  dcwmsg_dbgdump() across every message id, entry counts of 1/8/32 and SSID
+  lengths of 0/8/32.
+
+  Usage: dcwbench [-c] [-t <milliseconds per case>]
+    -c  emit CSV instead of the human readable table
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwproto.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ELEMENT_COUNT(ARR) (sizeof(ARR) / sizeof(ARR[0]))
+
+enum bench_op {
+  BENCH_MARSHAL,
+  BENCH_SERIALIZE,
+  BENCH_DBGDUMP,
+};
+
+static const char * const bench_op_names[] = {
+  "marshal",
+  "serialize",
+  "dbgdump",
+};
+
+static const struct {
+  enum dcwmsg_id  id;
+  const char     *name;
+  int             has_entries;
+  int             has_ssids;
+} bench_msgs[] = {
+  { DCWMSG_STA_JOIN,          "sta_join",          1, 0 },
+  { DCWMSG_STA_UNJOIN,        "sta_unjoin",        1, 0 },
+  { DCWMSG_STA_ACK,           "sta_ack",           1, 1 },
+  { DCWMSG_STA_NACK,          "sta_nack",          1, 0 },
+  { DCWMSG_AP_ACCEPT_STA,     "ap_accept_sta",     1, 1 },
+  { DCWMSG_AP_REJECT_STA,     "ap_reject_sta",     1, 0 },
+  { DCWMSG_AP_ACK_DISCONNECT, "ap_ack_disconnect", 0, 0 },
+  { DCWMSG_AP_QUIT,           "ap_quit",           0, 0 },
+};
+
+static const unsigned bench_entry_counts[] = { 1, 8, 32 };
+static const unsigned bench_ssid_lens[]    = { 0, 8, 32 };
+
+/* keeps the compiler from discarding benchmarked work */
+static volatile unsigned bench_sink;
+
+static double
+now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec;
+}
+
+static void
+build_msg(struct dcwmsg * const msg, const enum dcwmsg_id id, const unsigned count, const unsigned ssid_len) {
+  unsigned i;
+
+  memset(msg, 0, sizeof(*msg));
+  msg->id = id;
+
+  switch (id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    msg->sta_join.data_macaddr_count = count;
+    for (i = 0; i < count; i++) {
+      memcpy(msg->sta_join.data_macaddrs[i], "\x02\x00\x5E\x10\x20", 5);
+      msg->sta_join.data_macaddrs[i][5] = (unsigned char)i;
+    }
+    break;
+
+  case DCWMSG_STA_ACK:
+    msg->sta_ack.bonded_data_channel_count = count;
+    for (i = 0; i < count; i++) {
+      memcpy(msg->sta_ack.bonded_data_channels[i].macaddr, "\x02\x00\x5E\x10\x20", 5);
+      msg->sta_ack.bonded_data_channels[i].macaddr[5] = (unsigned char)i;
+      memset(msg->sta_ack.bonded_data_channels[i].ssid, 'a' + (i % 26), ssid_len);
+    }
+    break;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    msg->ap_accept_sta.data_ssid_count = count;
+    for (i = 0; i < count; i++) {
+      memset(msg->ap_accept_sta.data_ssids[i], 'a' + (i % 26), ssid_len);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+static unsigned long
+run_op(const enum bench_op op, const struct dcwmsg * const msg, const unsigned char * const wire, const unsigned wire_len, const unsigned long iterations) {
+  unsigned char buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg output;
+  unsigned long i;
+  unsigned acc;
+
+  acc = 0;
+  for (i = 0; i < iterations; i++) {
+    switch (op) {
+    case BENCH_MARSHAL:
+      acc += (unsigned)dcwmsg_marshal(&output, wire, wire_len);
+      acc += output.sta_join.data_macaddr_count;
+      break;
+    case BENCH_SERIALIZE:
+      acc += dcwmsg_serialize(buf, msg, sizeof(buf));
+      acc += buf[acc % sizeof(buf)];
+      break;
+    case BENCH_DBGDUMP:
+      dcwmsg_dbgdump(msg);
+      acc++;
+      break;
+    }
+  }
+  bench_sink += acc;
+  return iterations;
+}
+
+/* grows the iteration count until a run lasts at least "target_ns" */
+static double
+measure(const enum bench_op op, const struct dcwmsg * const msg, const unsigned char * const wire, const unsigned wire_len, const double target_ns) {
+  unsigned long iterations;
+  double start;
+  double elapsed;
+
+  run_op(op, msg, wire, wire_len, 64); /* warm up */
+
+  for (iterations = 64; ; iterations *= 2) {
+    start = now_ns();
+    run_op(op, msg, wire, wire_len, iterations);
+    elapsed = now_ns() - start;
+    if ((elapsed >= target_ns) || (iterations > (1UL << 40))) break;
+  }
+
+  return elapsed / (double)iterations;
+}
+
+static void
+usage(const char * const argv0) {
+  fprintf(stderr, "Usage: %s [-c] [-t <milliseconds per case>]\n", argv0);
+}
+
+int
+main(int argc, char *argv[]) {
+  unsigned char wire[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg msg;
+  unsigned wire_len;
+  unsigned m, c, s, op;
+  unsigned count_max, ssid_max;
+  double target_ns;
+  double ns_per_op;
+  int saved_stderr;
+  int devnull;
+  int csv;
+  int opt;
+
+  csv       = 0;
+  target_ns = 200e6;
+  while ((opt = getopt(argc, argv, "ct:")) != -1) {
+    switch (opt) {
+    case 'c': csv = 1; break;
+    case 't': target_ns = atof(optarg) * 1e6; break;
+    default:  usage(argv[0]); return 1;
+    }
+  }
+
+  /* dbgdump output is thrown away so the terminal doesn't dominate the numbers */
+  saved_stderr = dup(STDERR_FILENO);
+  devnull      = open("/dev/null", O_WRONLY);
+  if ((saved_stderr < 0) || (devnull < 0)) {
+    perror("dcwbench");
+    return 1;
+  }
+
+  if (csv) {
+    printf("op,msg,entries,ssid_len,wire_bytes,ns_per_op,msgs_per_sec,bytes_per_sec\n");
+  }
+  else {
+    printf("%-10s %-18s %7s %8s %10s %12s %14s %14s\n", "op", "msg", "entries", "ssid_len", "wire_bytes", "ns/op", "msgs/sec", "bytes/sec");
+  }
+
+  for (m = 0; m < ELEMENT_COUNT(bench_msgs); m++) {
+    count_max = bench_msgs[m].has_entries ? ELEMENT_COUNT(bench_entry_counts) : 1;
+    ssid_max  = bench_msgs[m].has_ssids ? ELEMENT_COUNT(bench_ssid_lens) : 1;
+
+    for (c = 0; c < count_max; c++) {
+      for (s = 0; s < ssid_max; s++) {
+        build_msg(&msg, bench_msgs[m].id, bench_msgs[m].has_entries ? bench_entry_counts[c] : 0, bench_ssid_lens[s]);
+        wire_len = dcwmsg_serialize(wire, &msg, sizeof(wire));
+        if (wire_len == 0) {
+          fprintf(stderr, "dcwbench: failed to serialize %s\n", bench_msgs[m].name);
+          return 1;
+        }
+
+        for (op = 0; op < ELEMENT_COUNT(bench_op_names); op++) {
+          if (op == BENCH_DBGDUMP) dup2(devnull, STDERR_FILENO);
+          ns_per_op = measure((enum bench_op)op, &msg, wire, wire_len, target_ns);
+          if (op == BENCH_DBGDUMP) {
+            fflush(stderr);
+            dup2(saved_stderr, STDERR_FILENO);
+          }
+
+          printf(csv ? "%s,%s,%u,%u,%u,%.2f,%.0f,%.0f\n" : "%-10s %-18s %7u %8u %10u %12.2f %14.0f %14.0f\n",
+            bench_op_names[op],
+            bench_msgs[m].name,
+            bench_msgs[m].has_entries ? bench_entry_counts[c] : 0,
+            bench_msgs[m].has_ssids ? bench_ssid_lens[s] : 0,
+            wire_len,
+            ns_per_op,
+            1e9 / ns_per_op,
+            (1e9 / ns_per_op) * (double)wire_len);
+          fflush(stdout);
+        }
+      }
+    }
+  }
+
+  close(devnull);
+  close(saved_stderr);
+  return 0;
+}
+
@@ -0,0 +1,195 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwbench_endpoint -- loopback throughput of libdcwproto-endpoint.
+  One thread sends batches of STA_JOIN messages from one endpoint to another
+  and receives them, so the figure is send + receive + dispatch on one core.
+  Runs UDP over 127.0.0.1 and unix datagrams (abstract namespace) against
+  each available receive backend.
+
+  Usage: dcwbench_endpoint [-c] [-t <milliseconds per case>]
+    -c  emit CSV instead of the human readable table
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <config.h>
+#include <dcwendpoint.h>
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_BATCH 64
+
+struct bench_counts {
+  unsigned long received;
+  unsigned long mismatched;
+};
+
+static double
+now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec;
+}
+
+static void
+on_sta_join(struct dcwendpoint *ep, const struct dcwmsg *msg, const struct sockaddr *from, socklen_t from_len, void *ctx) {
+  struct bench_counts * const counts = ctx;
+
+  (void)ep;
+  (void)from;
+  (void)from_len;
+  counts->received++;
+  if (msg->sta_join.data_macaddr_count != 1) counts->mismatched++;
+}
+
+/* fills in both addresses; returns their length or 0 */
+static socklen_t
+make_addrs(const int unix_dgram, struct sockaddr_storage * const rx, struct sockaddr_storage * const tx) {
+  struct sockaddr_in *sin;
+  struct sockaddr_un *sun;
+  socklen_t len;
+
+  memset(rx, 0, sizeof(*rx));
+  memset(tx, 0, sizeof(*tx));
+  if (!unix_dgram) {
+    sin = (struct sockaddr_in *)rx;
+    sin->sin_family      = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    memcpy(tx, rx, sizeof(*sin));
+    return sizeof(*sin);
+  }
+
+  sun = (struct sockaddr_un *)rx;
+  sun->sun_family = AF_UNIX;
+  len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + snprintf(&sun->sun_path[1], sizeof(sun->sun_path) - 1, "dcwbench-%d-rx", (int)getpid()));
+  sun = (struct sockaddr_un *)tx;
+  sun->sun_family = AF_UNIX;
+  snprintf(&sun->sun_path[1], sizeof(sun->sun_path) - 1, "dcwbench-%d-tx", (int)getpid());
+  return len;
+}
+
+static int
+run_case(const int unix_dgram, const unsigned flags, const double target_ns, const int csv) {
+  struct sockaddr_storage rx_addr, tx_addr;
+  struct dcwendpoint *rx, *tx;
+  struct bench_counts counts;
+  struct dcwmsg msg;
+  socklen_t addr_len;
+  double start, elapsed;
+  unsigned long sent;
+  unsigned i;
+
+  addr_len = make_addrs(unix_dgram, &rx_addr, &tx_addr);
+  rx = dcwendpoint_open((struct sockaddr *)&rx_addr, addr_len, BENCH_BATCH, flags);
+  tx = dcwendpoint_open((struct sockaddr *)&tx_addr, addr_len, BENCH_BATCH, flags);
+  if ((rx == NULL) || (tx == NULL)) {
+    perror("dcwbench_endpoint: dcwendpoint_open");
+    return 0;
+  }
+  if (!unix_dgram) {
+    /* UDP was bound to an ephemeral port */
+    getsockname(dcwendpoint_fd(rx), (struct sockaddr *)&rx_addr, &addr_len);
+  }
+
+  memset(&counts, 0, sizeof(counts));
+  dcwendpoint_set_handler(rx, DCWMSG_STA_JOIN, on_sta_join, &counts);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.id = DCWMSG_STA_JOIN;
+  msg.sta_join.data_macaddr_count = 1;
+  memcpy(msg.sta_join.data_macaddrs[0], "\x02\x00\x5E\x10\x20\x30", 6);
+
+  sent  = 0;
+  start = now_ns();
+  do {
+    for (i = 0; i < BENCH_BATCH; i++) dcwendpoint_send(tx, &msg, (struct sockaddr *)&rx_addr, addr_len);
+    sent += BENCH_BATCH;
+    /* lock step, so the socket buffer never overflows */
+    while (counts.received < sent) {
+      if (dcwendpoint_flush(tx) == -1) {
+        perror("dcwbench_endpoint: dcwendpoint_flush");
+        return 0;
+      }
+      if (dcwendpoint_poll(rx, 1000) <= 0) break;
+    }
+    elapsed = now_ns() - start;
+  } while (elapsed < target_ns);
+
+  printf(csv ? "%s,%s,%lu,%lu,%lu,%.0f\n" : "%-6s %-9s %12lu %12lu %10lu %14.0f\n",
+    unix_dgram ? "unix" : "udp",
+    (dcwendpoint_backend(rx) == DCWENDPOINT_IO_URING) ? "io_uring" : "epoll",
+    sent,
+    counts.received,
+    counts.mismatched + dcwendpoint_dropped(rx),
+    (double)counts.received * 1e9 / elapsed);
+  fflush(stdout);
+
+  dcwendpoint_close(rx);
+  dcwendpoint_close(tx);
+  return (counts.received == sent) && (counts.mismatched == 0);
+}
+
+static void
+usage(const char * const argv0) {
+  fprintf(stderr, "Usage: %s [-c] [-t <milliseconds per case>]\n", argv0);
+}
+
+int
+main(int argc, char *argv[]) {
+  double target_ns;
+  int unix_dgram;
+  int ok;
+  int csv;
+  int opt;
+
+  csv       = 0;
+  target_ns = 200e6;
+  while ((opt = getopt(argc, argv, "ct:")) != -1) {
+    switch (opt) {
+    case 'c': csv = 1; break;
+    case 't': target_ns = atof(optarg) * 1e6; break;
+    default:  usage(argv[0]); return 1;
+    }
+  }
+
+  if (csv) {
+    printf("transport,backend,sent,received,errors,msgs_per_sec\n");
+  }
+  else {
+    printf("%-6s %-9s %12s %12s %10s %14s\n", "proto", "backend", "sent", "received", "errors", "msgs/sec");
+  }
+
+  ok = 1;
+  for (unix_dgram = 0; unix_dgram < 2; unix_dgram++) {
+    ok &= run_case(unix_dgram, 0, target_ns, csv);
+    ok &= run_case(unix_dgram, DCWENDPOINT_IO_URING_RECV, target_ns, csv);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwdispatch_check -- functional test of dcwdispatch ("make check").
+  Submits interleaved per-key message sequences (each message carries its
+  key and its sequence number in its MAC addresses) to several workers, and
+  checks that every key's messages are handled exactly once and in
+  submission order, that a malformed message is dropped, and that
+  dcwdispatch_drain() returns with everything submitted so far handled, both
+  part way through and at the end. Runs once keyed by sender and once with
+  DCWDISPATCH_KEY_MACADDR, where several keys share one sender. An alarm
+  fails the test if a drain never returns.
+
+  Usage: dcwdispatch_check
+  Exits non-zero if any case fails.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwdispatch.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WORKER_COUNT    4
+#define KEY_COUNT       64
+#define SENDER_COUNT    4   /* senders shared by the keys with DCWDISPATCH_KEY_MACADDR */
+#define PER_KEY         2000
+#define TIMEOUT_SECS    60
+
+struct check_sender {
+  unsigned  id;
+};
+
+/* each key is only ever handled by one worker at a time, so its slot needs no lock */
+struct check_log {
+  int             by_macaddr;
+  unsigned        next[KEY_COUNT];
+  atomic_ulong    handled;
+  atomic_ulong    misordered;
+  atomic_ulong    wrong_sender;
+};
+
+static int
+check(const int ok, const char * const name, const char * const what) {
+  if (!ok) printf("FAIL %s: %s\n", name, what);
+  return ok;
+}
+
+/* STA_JOIN with the key in the first MAC and the sequence number in the second */
+static unsigned
+make_msg(unsigned char * const buf, const unsigned key, const unsigned seq) {
+  struct dcwmsg msg;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.id = DCWMSG_STA_JOIN;
+  msg.sta_join.data_macaddr_count = 2;
+  msg.sta_join.data_macaddrs[0][0] = 0x02;
+  msg.sta_join.data_macaddrs[0][4] = (unsigned char)(key >> 8);
+  msg.sta_join.data_macaddrs[0][5] = (unsigned char)key;
+  msg.sta_join.data_macaddrs[1][0] = 0x02;
+  msg.sta_join.data_macaddrs[1][3] = (unsigned char)(seq >> 16);
+  msg.sta_join.data_macaddrs[1][4] = (unsigned char)(seq >> 8);
+  msg.sta_join.data_macaddrs[1][5] = (unsigned char)seq;
+  return dcwmsg_serialize(buf, &msg, DCWMSG_MAX_SERIALIZED_SIZE);
+}
+
+static unsigned
+sender_of(const struct check_log * const log, const unsigned key) {
+  return log->by_macaddr ? (key % SENDER_COUNT) : key;
+}
+
+static void
+on_msg(const struct dcwmsg *msg, const void *sender, unsigned sender_len, void *ctx) {
+  struct check_log * const log = ctx;
+  const unsigned char * const k = msg->sta_join.data_macaddrs[0];
+  const unsigned char * const s = msg->sta_join.data_macaddrs[1];
+  const unsigned key = ((unsigned)k[4] << 8) | k[5];
+  const unsigned seq = ((unsigned)s[3] << 16) | ((unsigned)s[4] << 8) | s[5];
+  struct check_sender from;
+
+  if ((msg->id != DCWMSG_STA_JOIN) || (key >= KEY_COUNT) || (log->next[key] != seq)) {
+    atomic_fetch_add(&log->misordered, 1);
+  }
+  else {
+    log->next[key] = seq + 1;
+  }
+
+  memcpy(&from, sender, (sender_len < sizeof(from)) ? sender_len : sizeof(from));
+  if ((sender_len != sizeof(from)) || ((key < KEY_COUNT) && (from.id != sender_of(log, key)))) {
+    atomic_fetch_add(&log->wrong_sender, 1);
+  }
+  atomic_fetch_add(&log->handled, 1);
+}
+
+/* submits the next message of a pseudo-randomly chosen key until "until" have been submitted */
+static int
+submit_until(struct dcwdispatch * const dispatch, const struct check_log * const log, unsigned * const submitted, unsigned long * const total, const unsigned long until, unsigned * const rng) {
+  unsigned char buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct check_sender sender;
+  unsigned len;
+  unsigned key;
+
+  while ((*total) < until) {
+    (*rng) = ((*rng) * 1103515245U) + 12345U;
+    key = ((*rng) >> 8) % KEY_COUNT;
+    if (submitted[key] == PER_KEY) continue;
+
+    len = make_msg(buf, key, submitted[key]);
+    memset(&sender, 0, sizeof(sender));
+    sender.id = sender_of(log, key);
+    while (!dcwdispatch_submit(dispatch, buf, len, &sender, sizeof(sender))) {
+      if (errno != EAGAIN) return 0;
+      sched_yield(); /* the key's shard is full */
+    }
+    submitted[key]++;
+    (*total)++;
+  }
+  return 1;
+}
+
+static int
+run_case(const char * const name, const unsigned flags) {
+  static const unsigned char malformed[] = { DCWMSG_STA_JOIN, 3, 0x02, 0x00 };
+  unsigned submitted[KEY_COUNT];
+  struct dcwdispatch *dispatch;
+  struct check_log *log;
+  struct check_sender sender;
+  unsigned long total;
+  unsigned rng;
+  unsigned i;
+  int ok;
+
+  log = calloc(1, sizeof(*log));
+  if (log == NULL) return check(0, name, "calloc");
+  log->by_macaddr = ((flags & DCWDISPATCH_KEY_MACADDR) != 0);
+  atomic_init(&log->handled, 0);
+  atomic_init(&log->misordered, 0);
+  atomic_init(&log->wrong_sender, 0);
+
+  /* a small shard depth, so the submitter also has to back off now and then */
+  dispatch = dcwdispatch_create(WORKER_COUNT, 0, 16, flags, on_msg, log);
+  if (dispatch == NULL) {
+    free(log);
+    return check(0, name, "dcwdispatch_create");
+  }
+
+  memset(submitted, 0, sizeof(submitted));
+  total = 0;
+  rng   = 1;
+  ok = check(submit_until(dispatch, log, submitted, &total, (KEY_COUNT * PER_KEY) / 2, &rng), name, "dcwdispatch_submit");
+
+  memset(&sender, 0, sizeof(sender));
+  ok &= check(!dcwdispatch_submit(dispatch, malformed, sizeof(malformed), &sender, sizeof(sender)) && (errno == EINVAL), name, "malformed message was accepted");
+
+  /* part way: a drain leaves nothing in flight */
+  dcwdispatch_drain(dispatch);
+  ok &= check(atomic_load(&log->handled) == total, name, "drain returned before everything submitted was handled");
+
+  ok &= check(submit_until(dispatch, log, submitted, &total, KEY_COUNT * PER_KEY, &rng), name, "dcwdispatch_submit");
+  dcwdispatch_drain(dispatch);
+  ok &= check(atomic_load(&log->handled) == total, name, "drain returned before everything submitted was handled");
+
+  for (i = 0; i < KEY_COUNT; i++) ok &= check(log->next[i] == PER_KEY, name, "a key's messages were lost or repeated");
+  ok &= check(atomic_load(&log->misordered) == 0, name, "a key's messages were handled out of order");
+  ok &= check(atomic_load(&log->wrong_sender) == 0, name, "a message was handled with the wrong sender");
+  ok &= check(dcwdispatch_dropped(dispatch) == 1, name, "dropped count");
+
+  dcwdispatch_destroy(dispatch);
+  if (ok) printf("ok   %s (%lu messages, %u keys, %u workers)\n", name, total, KEY_COUNT, WORKER_COUNT);
+  free(log);
+  return ok;
+}
+
+int
+main(void) {
+  int ok;
+
+  alarm(TIMEOUT_SECS); /* a drain that never returns fails the test */
+  ok  = run_case("sender key", DCWDISPATCH_KEY_SENDER);
+  ok &= run_case("macaddr key", DCWDISPATCH_KEY_MACADDR);
+  return ok ? 0 : 1;
+}
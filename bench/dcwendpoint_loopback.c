@@ -0,0 +1,216 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+/*
+  dcwendpoint_loopback -- functional test of libdcwproto-endpoint ("make check").
+  For UDP over 127.0.0.1 and unix datagrams, with each receive backend, one
+  endpoint sends another every message type one per datagram, a few more
+  packed into a container frame, a malformed datagram and a message with
+  no handler. Checks that each valid message arrives intact and in order,
+  from the sender's address, and that only the malformed datagram is
+  counted as dropped.
+
+  Usage: dcwendpoint_loopback
+  Exits non-zero if any case fails.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <config.h>
+#include <dcwendpoint.h>
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define ELEMENT_COUNT(ARR) (sizeof(ARR) / sizeof(ARR[0]))
+
+#define SAMPLE_COUNT  8
+#define PACKED_COUNT  3
+#define MAX_RECEIVED  32
+
+struct loopback_log {
+  unsigned                  count;
+  unsigned                  lens[MAX_RECEIVED];
+  unsigned char             bytes[MAX_RECEIVED][DCWMSG_MAX_SERIALIZED_SIZE];
+  struct sockaddr_storage   from;
+  socklen_t                 from_len;
+};
+
+static void
+on_msg(struct dcwendpoint *ep, const struct dcwmsg *msg, const struct sockaddr *from, socklen_t from_len, void *ctx) {
+  struct loopback_log * const log = ctx;
+
+  (void)ep;
+  if (log->count == MAX_RECEIVED) return;
+  /* messages are compared in their canonical serialized form */
+  log->lens[log->count] = dcwmsg_serialize(log->bytes[log->count], msg, DCWMSG_MAX_SERIALIZED_SIZE);
+  log->count++;
+  if (from_len <= sizeof(log->from)) memcpy(&log->from, from, from_len);
+  log->from_len = from_len;
+}
+
+/* one message of every type, with a few entries each */
+static void
+make_samples(struct dcwmsg * const samples) {
+  static const unsigned char macaddr[6] = { 0x02, 0x00, 0x5E, 0x10, 0x20, 0x30 };
+  unsigned i;
+
+  memset(samples, 0, sizeof(*samples) * SAMPLE_COUNT);
+  samples[0].id = DCWMSG_STA_JOIN;
+  samples[1].id = DCWMSG_STA_UNJOIN;
+  samples[2].id = DCWMSG_STA_NACK;
+  samples[3].id = DCWMSG_AP_REJECT_STA;
+  for (i = 0; i < 4; i++) {
+    /* all four MAC list structs share the same layout */
+    samples[i].sta_join.data_macaddr_count = i + 1;
+    memcpy(samples[i].sta_join.data_macaddrs[i], macaddr, sizeof(macaddr));
+  }
+
+  samples[4].id = DCWMSG_STA_ACK;
+  samples[4].sta_ack.bonded_data_channel_count = 2;
+  memcpy(samples[4].sta_ack.bonded_data_channels[0].macaddr, macaddr, sizeof(macaddr));
+  strcpy(samples[4].sta_ack.bonded_data_channels[0].ssid, "dcw-data-1");
+  strcpy(samples[4].sta_ack.bonded_data_channels[1].ssid, "dcw-data-2");
+
+  samples[5].id = DCWMSG_AP_ACCEPT_STA;
+  samples[5].ap_accept_sta.data_ssid_count = 3;
+  strcpy(samples[5].ap_accept_sta.data_ssids[0], "a");
+  memset(samples[5].ap_accept_sta.data_ssids[2], 'z', sizeof(dcwmsg_ssid_t));
+
+  samples[6].id = DCWMSG_AP_ACK_DISCONNECT;
+  samples[7].id = DCWMSG_AP_QUIT;
+}
+
+/* fills in both addresses; returns their length */
+static socklen_t
+make_addrs(const int unix_dgram, struct sockaddr_storage * const rx, struct sockaddr_storage * const tx) {
+  struct sockaddr_in *sin;
+  struct sockaddr_un *sun;
+  socklen_t len;
+
+  memset(rx, 0, sizeof(*rx));
+  memset(tx, 0, sizeof(*tx));
+  if (!unix_dgram) {
+    sin = (struct sockaddr_in *)rx;
+    sin->sin_family      = AF_INET;
+    sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    memcpy(tx, rx, sizeof(*sin));
+    return sizeof(*sin);
+  }
+
+  sun = (struct sockaddr_un *)rx;
+  sun->sun_family = AF_UNIX;
+  len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + snprintf(&sun->sun_path[1], sizeof(sun->sun_path) - 1, "dcwloop-%d-rx", (int)getpid()));
+  sun = (struct sockaddr_un *)tx;
+  sun->sun_family = AF_UNIX;
+  snprintf(&sun->sun_path[1], sizeof(sun->sun_path) - 1, "dcwloop-%d-tx", (int)getpid());
+  return len;
+}
+
+static int
+check(const int ok, const char * const name, const char * const what) {
+  if (!ok) printf("FAIL %s: %s\n", name, what);
+  return ok;
+}
+
+static int
+run_case(const int unix_dgram, const unsigned flags) {
+  static const unsigned char garbage[] = { 0xEE, 0x01, 0x02 };
+  struct sockaddr_storage rx_addr, tx_addr, tx_bound;
+  struct dcwmsg samples[SAMPLE_COUNT];
+  struct dcwendpoint *rx, *tx;
+  struct loopback_log *log;
+  unsigned char expected[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned expected_len;
+  socklen_t addr_len;
+  socklen_t tx_len;
+  char name[32];
+  unsigned want;
+  unsigned i;
+  int ok;
+
+  snprintf(name, sizeof(name), "%s", unix_dgram ? "unix" : "udp");
+  make_samples(samples);
+  log = calloc(1, sizeof(*log));
+  addr_len = make_addrs(unix_dgram, &rx_addr, &tx_addr);
+  rx = dcwendpoint_open((struct sockaddr *)&rx_addr, addr_len, 0, flags);
+  tx = dcwendpoint_open((struct sockaddr *)&tx_addr, addr_len, 0, flags);
+  if ((log == NULL) || (rx == NULL) || (tx == NULL)) {
+    printf("FAIL %s: dcwendpoint_open\n", name);
+    return 0;
+  }
+  /* io_uring falls back to epoll on kernels without it */
+  snprintf(name, sizeof(name), "%s/%s", unix_dgram ? "unix" : "udp", (dcwendpoint_backend(rx) == DCWENDPOINT_IO_URING) ? "io_uring" : "epoll");
+  if (!unix_dgram) {
+    /* UDP was bound to an ephemeral port */
+    getsockname(dcwendpoint_fd(rx), (struct sockaddr *)&rx_addr, &addr_len);
+  }
+  tx_len = sizeof(tx_bound);
+  getsockname(dcwendpoint_fd(tx), (struct sockaddr *)&tx_bound, &tx_len);
+
+  for (i = 0; i < SAMPLE_COUNT; i++) dcwendpoint_set_handler(rx, samples[i].id, on_msg, log);
+  dcwendpoint_set_handler(rx, DCWMSG_AP_QUIT, NULL, NULL); /* AP_QUIT is discarded, not dropped */
+
+  ok = 1;
+  for (i = 0; i < SAMPLE_COUNT; i++) ok &= check(dcwendpoint_send(tx, &samples[i], (struct sockaddr *)&rx_addr, addr_len) == 0, name, "dcwendpoint_send");
+  ok &= check(dcwendpoint_send_packed(tx, samples, PACKED_COUNT, (struct sockaddr *)&rx_addr, addr_len, 0) == PACKED_COUNT, name, "dcwendpoint_send_packed");
+  ok &= check(dcwendpoint_flush(tx) == (SAMPLE_COUNT + 1), name, "dcwendpoint_flush");
+  ok &= check(sendto(dcwendpoint_fd(tx), garbage, sizeof(garbage), 0, (struct sockaddr *)&rx_addr, addr_len) == sizeof(garbage), name, "sendto");
+
+  /* every datagram but AP_QUIT's lands in the log; the container holds PACKED_COUNT */
+  want = (SAMPLE_COUNT - 1) + PACKED_COUNT;
+  while (dcwendpoint_dropped(rx) == 0) {
+    if (dcwendpoint_poll(rx, 1000) <= 0) break;
+  }
+
+  ok &= check(log->count == want, name, "received message count");
+  ok &= check(dcwendpoint_dropped(rx) == 1, name, "dropped count");
+  for (i = 0; (i < want) && (i < log->count); i++) {
+    const struct dcwmsg * const sample = &samples[(i < (SAMPLE_COUNT - 1)) ? i : (i - (SAMPLE_COUNT - 1))];
+    expected_len = dcwmsg_serialize(expected, sample, sizeof(expected));
+    ok &= check((log->lens[i] == expected_len) && (memcmp(log->bytes[i], expected, expected_len) == 0), name, "message contents or order");
+  }
+  ok &= check((log->from_len == tx_len) && (memcmp(&log->from, &tx_bound, tx_len) == 0), name, "sender address");
+
+  if (ok) printf("ok   %s\n", name);
+  dcwendpoint_close(rx);
+  dcwendpoint_close(tx);
+  free(log);
+  return ok;
+}
+
+int
+main(void) {
+  static const unsigned backends[] = { 0, DCWENDPOINT_IO_URING_RECV };
+  int unix_dgram;
+  unsigned i;
+  int ok;
+
+  ok = 1;
+  for (unix_dgram = 0; unix_dgram < 2; unix_dgram++) {
+    for (i = 0; i < ELEMENT_COUNT(backends); i++) ok &= run_case(unix_dgram, backends[i]);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,1211 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwfuzz -- differential fuzzer for the codec.
+  Generates valid, mutated and random inputs from a seeded PRNG and feeds the
+  same bytes to the reference dcwmsg_marshal() and to every other decode path
+  (marshal_ex, views, peek, batch, validated, compact, extended, codec
+  context, interned SSIDs and, built with -DDCWFUZZ_HPP, dcwproto.hpp), and
+  the same structs to dcwmsg_serialize() and every other encode path. All of them must agree with the reference on success/failure and on
+  the canonical (re-serialized) result. Reference round trips must be
+  stable, and the extended, interned and container encodings must survive a
+  round trip too. Each path's throughput is then measured over the valid
+  inputs and reported relative to the reference.
+
+  Usage: dcwfuzz [-c] [-n <cases>] [-s <seed>] [-t <milliseconds per path>]
+    -c  emit CSV instead of the human readable table
+    -t  0 skips the throughput runs
+
+  Exits non-zero if any path disagrees, after printing the offending input.
+  Built with -DDCWFUZZ_LIBFUZZER it instead provides LLVMFuzzerTestOneInput()
+  running the same checks on each input, for coverage guided fuzzing.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwproto.h>
+#include <dcwssid.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ELEMENT_COUNT(ARR) (sizeof(ARR) / sizeof(ARR[0]))
+
+#define FUZZ_CHUNK        256 /* inputs handed to each path per call */
+#define FUZZ_CASE_MAX     (DCWMSG_MAX_SERIALIZED_SIZE + 64)
+#define FUZZ_GUARD        16  /* bytes past buf_len that encoders must leave alone */
+#define FUZZ_OUT_SIZE     (DCWMSG_MAX_SERIALIZED_SIZE + FUZZ_GUARD)
+#define FUZZ_MAX_REPORTS  16
+
+enum fuzz_compare {
+  COMPARE_MSG,      /* canonical re-serialization of the decoded struct */
+  COMPARE_HEADER,   /* id and entry count only */
+  COMPARE_BYTES,    /* encoded bytes */
+  COMPARE_LENGTH,   /* encoded length only */
+};
+
+typedef void (*fuzz_decode_fn)(struct dcwmsg * const /* outputs */, const unsigned char * const * const /* bufs */, const unsigned * const /* buf_lens */, int * const /* results */, const unsigned /* count */);
+typedef void (*fuzz_encode_fn)(unsigned char * const * const /* bufs */, const struct dcwmsg * const /* inputs */, const unsigned * const /* buf_lens */, unsigned * const /* results */, const unsigned /* count */);
+typedef int (*fuzz_applies_fn)(const unsigned char * const /* buf */, const unsigned /* buf_len */);
+
+struct fuzz_path {
+  const char         *name;
+  enum fuzz_compare   compare;
+  fuzz_decode_fn      decode;   /* one of decode/encode is set */
+  fuzz_encode_fn      encode;
+  fuzz_applies_fn     applies;  /* NULL for every input */
+  unsigned long       cases;
+  unsigned long       mismatches;
+  double              ns_per_msg;
+  double              ref_ns_per_msg;
+};
+
+struct fuzz_check {
+  const char     *name;
+  unsigned long   cases;
+  unsigned long   mismatches;
+};
+
+/* scratch shared by the paths; the harness is single threaded */
+static struct dcwssid_pool  *fuzz_ssid_pool;
+static struct dcwmsg_ext     fuzz_ext;
+static struct dcwproto_ctx  *fuzz_ctx;
+static unsigned long long    fuzz_compact_mem[(DCWMSG_COMPACT_MAX_SIZE + 7) / 8];
+
+static unsigned long long  fuzz_rng;
+static unsigned long       fuzz_mismatches;
+
+/* keeps the compiler from discarding benchmarked work */
+static volatile unsigned fuzz_sink;
+
+
+
+
+/*
+
+  Helper functions begin here...
+
+*/
+/* xorshift64* */
+static unsigned
+rnd(void) {
+  fuzz_rng ^= fuzz_rng >> 12;
+  fuzz_rng ^= fuzz_rng << 25;
+  fuzz_rng ^= fuzz_rng >> 27;
+  return (unsigned)((fuzz_rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static unsigned
+rnd_below(const unsigned n) {
+  return rnd() % n;
+}
+
+static unsigned
+msg_count(const struct dcwmsg * const msg) {
+  switch (msg->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    return msg->sta_join.data_macaddr_count;
+  case DCWMSG_STA_ACK:
+    return msg->sta_ack.bonded_data_channel_count;
+  case DCWMSG_AP_ACCEPT_STA:
+    return msg->ap_accept_sta.data_ssid_count;
+  default:
+    return 0;
+  }
+}
+
+/* SSIDs with an embedded NUL don't survive a struct round trip, by design */
+static int
+has_nul_ssid(const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+
+  if (!dcwmsg_view_init(&view, buf, buf_len)) return 0;
+  dcwmsg_view_iter_init(&iter, &view);
+  while (dcwmsg_view_iter_next(&iter, &entry)) {
+    if ((entry.ssid != NULL) && (memchr(entry.ssid, '\0', entry.ssid_len) != NULL)) return 1;
+  }
+  return 0;
+}
+
+static void
+mismatch(const char * const path, const char * const what, const unsigned char * const buf, const unsigned buf_len) {
+  unsigned i;
+
+  fuzz_mismatches++;
+  if (fuzz_mismatches <= FUZZ_MAX_REPORTS) {
+    fprintf(stderr, "dcwfuzz: %s: %s; input (%u bytes):", path, what, buf_len);
+    for (i = 0; (i < buf_len) && (i < 64); i++) fprintf(stderr, " %02x", buf[i]);
+    fprintf(stderr, "%s\n", (buf_len > 64) ? " ..." : "");
+  }
+  else if (fuzz_mismatches == (FUZZ_MAX_REPORTS + 1)) {
+    fprintf(stderr, "dcwfuzz: further mismatches not shown\n");
+  }
+#ifdef DCWFUZZ_LIBFUZZER
+  abort();
+#endif
+}
+
+/* reports an encode mismatch by the message's own wire form, or its count if it has none */
+static void
+mismatch_msg(const char * const path, const char * const what, const struct dcwmsg * const msg) {
+  unsigned char buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char hdr[2];
+  unsigned len;
+
+  len = dcwmsg_serialize(buf, msg, sizeof(buf));
+  if (len > 0) {
+    mismatch(path, what, buf, len);
+    return;
+  }
+  hdr[0] = (unsigned char)msg->id;
+  hdr[1] = (unsigned char)msg_count(msg);
+  mismatch(path, what, hdr, sizeof(hdr));
+}
+
+
+
+
+#ifndef DCWFUZZ_LIBFUZZER
+/*
+
+  Input generation functions begin here...
+
+*/
+static const enum dcwmsg_id fuzz_ids[] = {
+  DCWMSG_STA_JOIN,
+  DCWMSG_STA_UNJOIN,
+  DCWMSG_STA_ACK,
+  DCWMSG_STA_NACK,
+  DCWMSG_AP_ACCEPT_STA,
+  DCWMSG_AP_REJECT_STA,
+  DCWMSG_AP_ACK_DISCONNECT,
+  DCWMSG_AP_QUIT,
+};
+
+static void
+random_ssid(char * const ssid) {
+  unsigned len;
+  unsigned i;
+
+  memset(ssid, 0, sizeof(dcwmsg_ssid_t));
+  len = rnd_below(sizeof(dcwmsg_ssid_t) + 1);
+  for (i = 0; i < len; i++) ssid[i] = (char)(' ' + rnd_below(95));
+  if ((len > 1) && (rnd_below(32) == 0)) ssid[rnd_below(len)] = '\0';
+}
+
+/* "allow_invalid" lets the entry count exceed DCWMSG_MAX_ENTRIES now and then */
+static void
+random_msg(struct dcwmsg * const msg, const int allow_invalid) {
+  unsigned count;
+  unsigned fill;
+  unsigned i, j;
+
+  memset(msg, 0, sizeof(*msg));
+  msg->id = fuzz_ids[rnd_below(ELEMENT_COUNT(fuzz_ids))];
+
+  count = (rnd_below(4) == 0) ? rnd_below(DCWMSG_MAX_ENTRIES + 1) : rnd_below(4);
+  if (allow_invalid && (rnd_below(16) == 0)) count = DCWMSG_MAX_ENTRIES + 1 + rnd_below(200);
+  fill = (count > DCWMSG_MAX_ENTRIES) ? DCWMSG_MAX_ENTRIES : count;
+
+  switch (msg->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    msg->sta_join.data_macaddr_count = count;
+    for (i = 0; i < fill; i++) {
+      for (j = 0; j < sizeof(dcwmsg_macaddr_t); j++) msg->sta_join.data_macaddrs[i][j] = (unsigned char)rnd();
+    }
+    break;
+
+  case DCWMSG_STA_ACK:
+    msg->sta_ack.bonded_data_channel_count = count;
+    for (i = 0; i < fill; i++) {
+      for (j = 0; j < sizeof(dcwmsg_macaddr_t); j++) msg->sta_ack.bonded_data_channels[i].macaddr[j] = (unsigned char)rnd();
+      random_ssid(msg->sta_ack.bonded_data_channels[i].ssid);
+    }
+    break;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    msg->ap_accept_sta.data_ssid_count = count;
+    for (i = 0; i < fill; i++) random_ssid(msg->ap_accept_sta.data_ssids[i]);
+    break;
+
+  default:
+    break;
+  }
+}
+
+/* fills buf (FUZZ_CASE_MAX bytes) with one decoder input; returns its length */
+static unsigned
+random_input(unsigned char * const buf) {
+  struct dcwmsg msg;
+  unsigned kind;
+  unsigned len;
+  unsigned extra;
+  unsigned i;
+
+  kind = rnd_below(10);
+
+  if (kind < 7) {
+    /* a valid message, possibly mutated */
+    random_msg(&msg, 0);
+    len = dcwmsg_serialize(buf, &msg, FUZZ_CASE_MAX);
+
+    if (kind >= 3) {
+      switch (rnd_below(5)) {
+      case 0: /* bit flip */
+        buf[rnd_below(len)] ^= (unsigned char)(1 << rnd_below(8));
+        break;
+      case 1: /* truncation, most often by a byte or two */
+        extra = (rnd_below(2) == 0) ? (1 + rnd_below(2)) : rnd_below(len + 1);
+        len = (extra < len) ? (len - extra) : 0;
+        break;
+      case 2: /* entry count off by a little or a lot */
+        if (len > 1) buf[1] = (unsigned char)((rnd_below(2) == 0) ? (buf[1] + 1 - (2 * rnd_below(2))) : rnd_below(256));
+        break;
+      case 3: /* a stray length byte */
+        buf[rnd_below(len)] = (unsigned char)rnd_below(40);
+        break;
+      default: /* trailing bytes */
+        break;
+      }
+    }
+
+    if ((kind == 2) || (kind == 6)) {
+      extra = rnd_below(32);
+      if (extra > (FUZZ_CASE_MAX - len)) extra = FUZZ_CASE_MAX - len;
+      for (i = 0; i < extra; i++) buf[len + i] = (unsigned char)rnd();
+      len += extra;
+    }
+    return len;
+  }
+
+  if (kind < 9) {
+    /* a known id with short, small-valued noise after it */
+    len = rnd_below(64);
+    for (i = 0; i < len; i++) buf[i] = (unsigned char)rnd_below(40);
+    if (len > 0) buf[0] = (unsigned char)fuzz_ids[rnd_below(ELEMENT_COUNT(fuzz_ids))];
+    return len;
+  }
+
+  /* anything at all */
+  len = rnd_below(FUZZ_CASE_MAX + 1);
+  for (i = 0; i < len; i++) buf[i] = (unsigned char)rnd();
+  return len;
+}
+#endif
+
+
+
+
+/*
+
+  Decode paths begin here...
+  The first one is the reference the others are compared with.
+
+*/
+static void
+decode_reference(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwmsg_marshal(&outputs[i], bufs[i], buf_lens[i]);
+}
+
+static void
+decode_marshal_ex(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned offset;
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = (dcwmsg_marshal_ex(&outputs[i], bufs[i], buf_lens[i], &offset) == DCWMSG_OK);
+}
+
+static void
+decode_view(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  struct dcwmsg_view view;
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwmsg_view_init(&view, bufs[i], buf_lens[i]) && dcwmsg_view_marshal(&outputs[i], &view);
+}
+
+static void
+decode_peek(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  enum dcwmsg_id id;
+  unsigned entries;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = dcwmsg_peek(bufs[i], buf_lens[i], &id, &entries, NULL);
+    if (!results[i]) continue;
+    /* every entry count sits at the front of the union, so msg_count() reads it back */
+    outputs[i].id = id;
+    outputs[i].sta_join.data_macaddr_count = entries;
+  }
+}
+
+static void
+decode_batch(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  dcwmsg_marshal_batch(outputs, bufs, buf_lens, results, count);
+}
+
+static void
+decode_validated(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwmsg_marshal_validated(&outputs[i], bufs[i], buf_lens[i], 0);
+}
+
+static void
+decode_compact(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  struct dcwmsg_compact * const compact = (struct dcwmsg_compact *)fuzz_compact_mem;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = (dcwmsg_compact_marshal(compact, sizeof(fuzz_compact_mem), bufs[i], buf_lens[i]) != 0) && dcwmsg_compact_unpack(&outputs[i], compact);
+  }
+}
+
+/* legacy input only; an extended frame is a different grammar the reference rightly rejects */
+static void
+decode_ext(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = (buf_lens[i] > 0) && (bufs[i][0] != DCWMSG_EXT_V1) && dcwmsg_ext_marshal(&fuzz_ext, bufs[i], buf_lens[i]);
+    if (results[i]) dcwmsg_ext_split(&outputs[i], &fuzz_ext, 0);
+  }
+}
+
+static void
+unintern_ssid(char * const ssid, const dcwssid_handle_t handle) {
+  const char *str;
+  unsigned len;
+
+  str = dcwssid_get(fuzz_ssid_pool, handle, &len);
+  memcpy(ssid, str, len);
+  if (len < sizeof(dcwmsg_ssid_t)) ssid[len] = '\0';
+}
+
+#ifdef DCWFUZZ_HPP
+/* dcw::decode<T>() from dcwproto.hpp, in dcwfuzz_hpp.cpp */
+void dcwfuzz_decode_hpp(struct dcwmsg * const /* outputs */, const unsigned char * const * const /* bufs */, const unsigned * const /* buf_lens */, int * const /* results */, const unsigned /* count */);
+#endif
+
+static void
+decode_ctx(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwproto_ctx_marshal(fuzz_ctx, &outputs[i], bufs[i], buf_lens[i]);
+}
+
+static void
+decode_ctx_peek(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  enum dcwmsg_id id;
+  unsigned entries;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = dcwproto_ctx_peek(fuzz_ctx, bufs[i], buf_lens[i], &id, &entries, NULL);
+    if (!results[i]) continue;
+    outputs[i].id = id;
+    outputs[i].sta_join.data_macaddr_count = entries;
+  }
+}
+
+static void
+decode_ctx_compact(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  struct dcwmsg_compact * const compact = (struct dcwmsg_compact *)fuzz_compact_mem;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = (dcwproto_ctx_compact_marshal(fuzz_ctx, compact, sizeof(fuzz_compact_mem), bufs[i], buf_lens[i]) != 0) && dcwmsg_compact_unpack(&outputs[i], compact);
+  }
+}
+
+/* legacy input only, as for decode_ext() */
+static void
+decode_ctx_ext(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = (buf_lens[i] > 0) && (bufs[i][0] != DCWMSG_EXT_V1) && dcwproto_ctx_ext_marshal(fuzz_ctx, &fuzz_ext, bufs[i], buf_lens[i]);
+    if (results[i]) dcwmsg_ext_split(&outputs[i], &fuzz_ext, 0);
+  }
+}
+
+/* converting back to struct dcwmsg for the comparison is part of the timed work */
+static void
+decode_interned(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  struct dcwmsg_sta_ack_interned ack;
+  struct dcwmsg_ap_accept_sta_interned accept;
+  unsigned i, j;
+
+  dcwssid_pool_reset(fuzz_ssid_pool);
+  for (i = 0; i < count; i++) {
+    results[i] = 0;
+    if (buf_lens[i] < 1) continue;
+
+    if ((bufs[i][0] == DCWMSG_STA_ACK) && dcwssid_marshal_sta_ack(fuzz_ssid_pool, &ack, bufs[i], buf_lens[i])) {
+      outputs[i].id = DCWMSG_STA_ACK;
+      outputs[i].sta_ack.bonded_data_channel_count = ack.bonded_data_channel_count;
+      for (j = 0; j < ack.bonded_data_channel_count; j++) {
+        memcpy(outputs[i].sta_ack.bonded_data_channels[j].macaddr, ack.bonded_data_channels[j].macaddr, sizeof(dcwmsg_macaddr_t));
+        unintern_ssid(outputs[i].sta_ack.bonded_data_channels[j].ssid, ack.bonded_data_channels[j].ssid);
+      }
+      results[i] = 1;
+    }
+    else if ((bufs[i][0] == DCWMSG_AP_ACCEPT_STA) && dcwssid_marshal_ap_accept_sta(fuzz_ssid_pool, &accept, bufs[i], buf_lens[i])) {
+      outputs[i].id = DCWMSG_AP_ACCEPT_STA;
+      outputs[i].ap_accept_sta.data_ssid_count = accept.data_ssid_count;
+      for (j = 0; j < accept.data_ssid_count; j++) unintern_ssid(outputs[i].ap_accept_sta.data_ssids[j], accept.data_ssids[j]);
+      results[i] = 1;
+    }
+  }
+}
+
+static int
+applies_interned(const unsigned char * const buf, const unsigned buf_len) {
+  return (buf_len > 0) && ((buf[0] == DCWMSG_STA_ACK) || (buf[0] == DCWMSG_AP_ACCEPT_STA));
+}
+
+
+
+
+/*
+
+  Encode paths begin here...
+  The first one is the reference the others are compared with.
+
+*/
+static void
+encode_reference(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwmsg_serialize(bufs[i], &inputs[i], buf_lens[i]);
+}
+
+static void
+encode_exact(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwmsg_serialize_exact(bufs[i], &inputs[i], buf_lens[i]);
+}
+
+static void
+encode_size(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  unsigned i;
+
+  (void)bufs;
+  for (i = 0; i < count; i++) {
+    results[i] = dcwmsg_serialized_size(&inputs[i]);
+    if (results[i] > buf_lens[i]) results[i] = 0;
+  }
+}
+
+static void
+encode_batch(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  dcwmsg_serialize_batch(bufs, inputs, buf_lens, results, count);
+}
+
+/* flattens the iovecs so the bytes can be compared; a short buffer counts as a failure */
+static void
+encode_iov(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  unsigned char scratch[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct iovec iov[DCWMSG_SERIALIZE_IOV_MAX];
+  unsigned iov_count;
+  unsigned size;
+  unsigned i, j;
+
+  for (i = 0; i < count; i++) {
+    results[i] = 0;
+    iov_count = dcwmsg_serialize_iov(iov, DCWMSG_SERIALIZE_IOV_MAX, scratch, sizeof(scratch), &inputs[i]);
+    if (iov_count == 0) continue;
+
+    for (size = 0, j = 0; j < iov_count; j++) size += (unsigned)iov[j].iov_len;
+    if (size > buf_lens[i]) continue;
+
+    for (size = 0, j = 0; j < iov_count; j++) {
+      memcpy(bufs[i] + size, iov[j].iov_base, iov[j].iov_len);
+      size += (unsigned)iov[j].iov_len;
+    }
+    results[i] = size;
+  }
+}
+
+static void
+encode_ctx(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  unsigned i;
+  for (i = 0; i < count; i++) results[i] = dcwproto_ctx_serialize(fuzz_ctx, bufs[i], &inputs[i], buf_lens[i]);
+}
+
+static void
+encode_ctx_compact(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  struct dcwmsg_compact * const compact = (struct dcwmsg_compact *)fuzz_compact_mem;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = 0;
+    if (dcwproto_ctx_compact_pack(fuzz_ctx, compact, sizeof(fuzz_compact_mem), &inputs[i]) == 0) continue;
+    results[i] = dcwmsg_compact_serialize(bufs[i], compact, buf_lens[i]);
+  }
+}
+
+static void
+encode_compact(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  struct dcwmsg_compact * const compact = (struct dcwmsg_compact *)fuzz_compact_mem;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    results[i] = 0;
+    if (dcwmsg_compact_pack(compact, sizeof(fuzz_compact_mem), &inputs[i]) == 0) continue;
+    results[i] = dcwmsg_compact_serialize(bufs[i], compact, buf_lens[i]);
+  }
+}
+
+#ifdef DCWFUZZ_HPP
+/* dcw::encode<T>() from dcwproto.hpp, in dcwfuzz_hpp.cpp */
+void dcwfuzz_encode_hpp(unsigned char * const * const /* bufs */, const struct dcwmsg * const /* inputs */, const unsigned * const /* buf_lens */, unsigned * const /* results */, const unsigned /* count */);
+#endif
+
+static struct fuzz_path fuzz_decode_paths[] = {
+  { "marshal",            COMPARE_MSG,    decode_reference,   NULL, NULL,             0, 0, 0, 0 },
+  { "marshal_ex",         COMPARE_MSG,    decode_marshal_ex,  NULL, NULL,             0, 0, 0, 0 },
+  { "view",               COMPARE_MSG,    decode_view,        NULL, NULL,             0, 0, 0, 0 },
+  { "peek",               COMPARE_HEADER, decode_peek,        NULL, NULL,             0, 0, 0, 0 },
+  { "marshal_batch",      COMPARE_MSG,    decode_batch,       NULL, NULL,             0, 0, 0, 0 },
+  { "marshal_validated",  COMPARE_MSG,    decode_validated,   NULL, NULL,             0, 0, 0, 0 },
+  { "compact",            COMPARE_MSG,    decode_compact,     NULL, NULL,             0, 0, 0, 0 },
+  { "ext",                COMPARE_MSG,    decode_ext,         NULL, NULL,             0, 0, 0, 0 },
+  { "ctx",                COMPARE_MSG,    decode_ctx,         NULL, NULL,             0, 0, 0, 0 },
+  { "ctx_peek",           COMPARE_HEADER, decode_ctx_peek,    NULL, NULL,             0, 0, 0, 0 },
+  { "ctx_compact",        COMPARE_MSG,    decode_ctx_compact, NULL, NULL,             0, 0, 0, 0 },
+  { "ctx_ext",            COMPARE_MSG,    decode_ctx_ext,     NULL, NULL,             0, 0, 0, 0 },
+  { "ssid_interned",      COMPARE_MSG,    decode_interned,    NULL, applies_interned, 0, 0, 0, 0 },
+#ifdef DCWFUZZ_HPP
+  { "hpp",                COMPARE_MSG,    dcwfuzz_decode_hpp, NULL, NULL,             0, 0, 0, 0 },
+#endif
+};
+
+static struct fuzz_path fuzz_encode_paths[] = {
+  { "serialize",          COMPARE_BYTES,  NULL, encode_reference, NULL,  0, 0, 0, 0 },
+  { "serialize_exact",    COMPARE_BYTES,  NULL, encode_exact,     NULL,  0, 0, 0, 0 },
+  { "serialized_size",    COMPARE_LENGTH, NULL, encode_size,      NULL,  0, 0, 0, 0 },
+  { "serialize_batch",    COMPARE_BYTES,  NULL, encode_batch,     NULL,  0, 0, 0, 0 },
+  { "serialize_iov",      COMPARE_BYTES,  NULL, encode_iov,       NULL,  0, 0, 0, 0 },
+  { "compact",            COMPARE_BYTES,  NULL, encode_compact,   NULL,  0, 0, 0, 0 },
+  { "ctx",                COMPARE_BYTES,  NULL, encode_ctx,       NULL,  0, 0, 0, 0 },
+  { "ctx_compact",        COMPARE_BYTES,  NULL, encode_ctx_compact, NULL, 0, 0, 0, 0 },
+#ifdef DCWFUZZ_HPP
+  { "hpp",                COMPARE_BYTES,  NULL, dcwfuzz_encode_hpp, NULL, 0, 0, 0, 0 },
+#endif
+};
+
+enum {
+  CHECK_ROUNDTRIP,
+  CHECK_IDEMPOTENT,
+  CHECK_EXT_ROUNDTRIP,
+  CHECK_SSID_ROUNDTRIP,
+  CHECK_CONTAINER,
+  CHECK_REGRESSION,
+};
+
+static struct fuzz_check fuzz_checks[] = {
+  { "roundtrip",          0, 0 },
+  { "idempotent",         0, 0 },
+  { "ext_roundtrip",      0, 0 },
+  { "ssid_roundtrip",     0, 0 },
+  { "container",          0, 0 },
+  { "regression",         0, 0 },
+};
+
+
+
+
+/*
+
+  Differential check functions begin here...
+
+*/
+static struct dcwmsg  fuzz_ref_outputs[FUZZ_CHUNK];
+static struct dcwmsg  fuzz_outputs[FUZZ_CHUNK];
+static int            fuzz_ref_results[FUZZ_CHUNK];
+static int            fuzz_results[FUZZ_CHUNK];
+
+static int
+same_msg(const struct dcwmsg * const a, const struct dcwmsg * const b) {
+  unsigned char abuf[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char bbuf[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned alen;
+  unsigned blen;
+
+  alen = dcwmsg_serialize(abuf, a, sizeof(abuf));
+  blen = dcwmsg_serialize(bbuf, b, sizeof(bbuf));
+  return (alen == blen) && (alen > 0) && (memcmp(abuf, bbuf, alen) == 0);
+}
+
+static void
+check_decode_path(struct fuzz_path * const path, const unsigned char * const * const bufs, const unsigned * const buf_lens, const unsigned count) {
+  char what[96];
+  unsigned i;
+
+  path->decode(fuzz_outputs, bufs, buf_lens, fuzz_results, count);
+
+  for (i = 0; i < count; i++) {
+    if ((path->applies != NULL) && !path->applies(bufs[i], buf_lens[i])) continue;
+    path->cases++;
+
+    if (!fuzz_results[i] != !fuzz_ref_results[i]) {
+      snprintf(what, sizeof(what), "returned %s, reference %s", fuzz_results[i] ? "success" : "failure", fuzz_ref_results[i] ? "success" : "failure");
+    }
+    else if (!fuzz_results[i]) {
+      continue; /* both rejected it */
+    }
+    else if (path->compare == COMPARE_HEADER) {
+      if ((fuzz_outputs[i].id == fuzz_ref_outputs[i].id) && (msg_count(&fuzz_outputs[i]) == msg_count(&fuzz_ref_outputs[i]))) continue;
+      snprintf(what, sizeof(what), "id %d count %u, reference id %d count %u", (int)fuzz_outputs[i].id, msg_count(&fuzz_outputs[i]), (int)fuzz_ref_outputs[i].id, msg_count(&fuzz_ref_outputs[i]));
+    }
+    else {
+      if (same_msg(&fuzz_outputs[i], &fuzz_ref_outputs[i])) continue;
+      snprintf(what, sizeof(what), "decoded message differs from the reference");
+    }
+
+    path->mismatches++;
+    mismatch(path->name, what, bufs[i], buf_lens[i]);
+  }
+}
+
+static void
+check_roundtrips(const unsigned char * const * const bufs, const unsigned * const buf_lens, const unsigned count) {
+  static struct dcwmsg valid[FUZZ_CHUNK];
+  static unsigned char frame[DCWMSG_CONTAINER_MAX_COUNT * (2 + DCWMSG_MAX_SERIALIZED_SIZE) + 2];
+  static unsigned char ctx_frame[sizeof(frame)];
+  unsigned char s1[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char s2[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char ext_buf[DCWMSG_MAX_SERIALIZED_SIZE + 8];
+  struct dcwmsg_sta_ack_interned ack;
+  struct dcwmsg_ap_accept_sta_interned accept;
+  struct dcwmsg_container_iter iter;
+  struct dcwmsg_view view;
+  struct dcwmsg msg;
+  const unsigned char *inner;
+  unsigned inner_len;
+  unsigned valid_count;
+  unsigned frame_size;
+  unsigned frame_len;
+  unsigned packed;
+  unsigned ctx_packed;
+  unsigned offset;
+  unsigned len1;
+  unsigned len2;
+  unsigned i, j;
+  int ok;
+
+  dcwssid_pool_reset(fuzz_ssid_pool);
+  valid_count = 0;
+
+  for (i = 0; i < count; i++) {
+    if (!fuzz_ref_results[i]) continue;
+    memcpy(&valid[valid_count++], &fuzz_ref_outputs[i], sizeof(valid[0]));
+
+    /* serialize(marshal(x)) gives back the bytes marshal consumed */
+    fuzz_checks[CHECK_ROUNDTRIP].cases++;
+    len1 = dcwmsg_serialize(s1, &fuzz_ref_outputs[i], sizeof(s1));
+    ok = (len1 > 0) && (dcwmsg_marshal_ex(&msg, bufs[i], buf_lens[i], &offset) == DCWMSG_OK);
+    if (ok && ((offset != len1) || (memcmp(s1, bufs[i], len1) != 0))) ok = has_nul_ssid(bufs[i], buf_lens[i]);
+    if (!ok) {
+      fuzz_checks[CHECK_ROUNDTRIP].mismatches++;
+      mismatch(fuzz_checks[CHECK_ROUNDTRIP].name, "re-serialization differs from the consumed input", bufs[i], buf_lens[i]);
+      continue;
+    }
+
+    /* and a second trip changes nothing */
+    fuzz_checks[CHECK_IDEMPOTENT].cases++;
+    len2 = dcwmsg_marshal(&msg, s1, len1) ? dcwmsg_serialize(s2, &msg, sizeof(s2)) : 0;
+    if ((len2 != len1) || (memcmp(s1, s2, len1) != 0)) {
+      fuzz_checks[CHECK_IDEMPOTENT].mismatches++;
+      mismatch(fuzz_checks[CHECK_IDEMPOTENT].name, "second round trip differs from the first", bufs[i], buf_lens[i]);
+    }
+
+    /* legacy -> extended -> legacy */
+    fuzz_checks[CHECK_EXT_ROUNDTRIP].cases++;
+    ok = dcwmsg_ext_marshal(&fuzz_ext, s1, len1);
+    if (ok) {
+      len2 = dcwmsg_ext_serialize(ext_buf, &fuzz_ext, sizeof(ext_buf));
+      ok = (len2 > 0) && (len2 == dcwmsg_ext_serialized_size(&fuzz_ext)) && dcwmsg_ext_marshal(&fuzz_ext, ext_buf, len2);
+    }
+    if (ok) {
+      ok = (dcwmsg_ext_split(&msg, &fuzz_ext, 0) == msg_count(&fuzz_ref_outputs[i]));
+      len2 = dcwmsg_serialize(s2, &msg, sizeof(s2));
+      ok = ok && (len2 == len1) && (memcmp(s1, s2, len1) == 0);
+    }
+    if (!ok) {
+      fuzz_checks[CHECK_EXT_ROUNDTRIP].mismatches++;
+      mismatch(fuzz_checks[CHECK_EXT_ROUNDTRIP].name, "extended encoding round trip differs", s1, len1);
+    }
+
+    /* interned SSIDs serialize back to the same bytes */
+    if ((s1[0] == DCWMSG_STA_ACK) || (s1[0] == DCWMSG_AP_ACCEPT_STA)) {
+      fuzz_checks[CHECK_SSID_ROUNDTRIP].cases++;
+      if (s1[0] == DCWMSG_STA_ACK) {
+        len2 = dcwssid_marshal_sta_ack(fuzz_ssid_pool, &ack, s1, len1) ? dcwssid_serialize_sta_ack(fuzz_ssid_pool, s2, &ack, sizeof(s2)) : 0;
+      }
+      else {
+        len2 = dcwssid_marshal_ap_accept_sta(fuzz_ssid_pool, &accept, s1, len1) ? dcwssid_serialize_ap_accept_sta(fuzz_ssid_pool, s2, &accept, sizeof(s2)) : 0;
+      }
+      if ((len2 != len1) || (memcmp(s1, s2, len1) != 0)) {
+        fuzz_checks[CHECK_SSID_ROUNDTRIP].mismatches++;
+        mismatch(fuzz_checks[CHECK_SSID_ROUNDTRIP].name, "interned SSID round trip differs", s1, len1);
+      }
+    }
+  }
+
+  /* the valid messages packed into container frames of assorted sizes come back in order */
+  for (i = 0; i < valid_count; i += packed) {
+    fuzz_checks[CHECK_CONTAINER].cases++;
+    frame_size = DCWMSG_MAX_SERIALIZED_SIZE + rnd_below(sizeof(frame) - DCWMSG_MAX_SERIALIZED_SIZE);
+    frame_len  = dcwmsg_container_pack(frame, frame_size, &valid[i], valid_count - i, &packed);
+    ok = (frame_len > 0) && (packed > 0) && dcwmsg_container_iter_init(&iter, frame, frame_len);
+    for (j = 0; ok && (j < packed); j++) {
+      len1 = dcwmsg_serialize(s1, &valid[i + j], sizeof(s1));
+      ok = dcwmsg_container_iter_next(&iter, &inner, &inner_len) && (inner_len == len1) && (memcmp(inner, s1, len1) == 0);
+    }
+    if (ok) ok = !dcwmsg_container_iter_next(&iter, &inner, &inner_len);
+
+    /* the context variants pack the same frame and walk it the same way */
+    if (ok) {
+      ok = (dcwproto_ctx_container_pack(fuzz_ctx, ctx_frame, frame_size, &valid[i], valid_count - i, &ctx_packed) == frame_len) &&
+           (ctx_packed == packed) && (memcmp(ctx_frame, frame, frame_len) == 0) && dcwmsg_container_iter_init(&iter, frame, frame_len);
+    }
+    for (j = 0; ok && (j < packed); j++) {
+      ok = (dcwproto_ctx_container_next(fuzz_ctx, &iter, &view) == 1) && (view.length == dcwmsg_serialized_size(&valid[i + j]));
+    }
+    if (ok) ok = (dcwproto_ctx_container_next(fuzz_ctx, &iter, &view) == 0);
+    if (!ok) {
+      fuzz_checks[CHECK_CONTAINER].mismatches++;
+      mismatch(fuzz_checks[CHECK_CONTAINER].name, "container frame does not give back what was packed", frame, frame_len);
+      if (packed == 0) break;
+    }
+  }
+}
+
+static void
+check_decode_chunk(const unsigned char * const * const bufs, const unsigned * const buf_lens, const unsigned count) {
+  unsigned p;
+
+  fuzz_decode_paths[0].decode(fuzz_ref_outputs, bufs, buf_lens, fuzz_ref_results, count);
+  fuzz_decode_paths[0].cases += count;
+
+  for (p = 1; p < ELEMENT_COUNT(fuzz_decode_paths); p++) check_decode_path(&fuzz_decode_paths[p], bufs, buf_lens, count);
+  check_roundtrips(bufs, buf_lens, count);
+}
+
+static void
+check_encode_chunk(const struct dcwmsg * const inputs, const unsigned * const buf_lens, const unsigned count) {
+  static unsigned char ref_mem[FUZZ_CHUNK][FUZZ_OUT_SIZE];
+  static unsigned char out_mem[FUZZ_CHUNK][FUZZ_OUT_SIZE];
+  unsigned char *ref_bufs[FUZZ_CHUNK];
+  unsigned char *out_bufs[FUZZ_CHUNK];
+  unsigned ref_results[FUZZ_CHUNK];
+  unsigned results[FUZZ_CHUNK];
+  struct fuzz_path *path;
+  char what[96];
+  unsigned p;
+  unsigned i, j;
+
+  for (i = 0; i < count; i++) {
+    ref_bufs[i] = ref_mem[i];
+    out_bufs[i] = out_mem[i];
+  }
+  fuzz_encode_paths[0].encode(ref_bufs, inputs, buf_lens, ref_results, count);
+  fuzz_encode_paths[0].cases += count;
+
+  for (p = 1; p < ELEMENT_COUNT(fuzz_encode_paths); p++) {
+    path = &fuzz_encode_paths[p];
+    memset(out_mem, 0xA5, sizeof(out_mem[0]) * count);
+    path->encode(out_bufs, inputs, buf_lens, results, count);
+
+    for (i = 0; i < count; i++) {
+      path->cases++;
+      for (j = buf_lens[i]; (j < FUZZ_OUT_SIZE) && (out_mem[i][j] == 0xA5); j++) ;
+
+      if (j < FUZZ_OUT_SIZE) {
+        snprintf(what, sizeof(what), "wrote past buf_len %u", buf_lens[i]);
+      }
+      else if (results[i] != ref_results[i]) {
+        snprintf(what, sizeof(what), "returned %u, reference %u (buf_len %u)", results[i], ref_results[i], buf_lens[i]);
+      }
+      else if ((path->compare == COMPARE_BYTES) && (results[i] > 0) && (memcmp(out_mem[i], ref_mem[i], results[i]) != 0)) {
+        snprintf(what, sizeof(what), "encoded bytes differ from the reference");
+      }
+      else {
+        continue;
+      }
+
+      path->mismatches++;
+      mismatch_msg(path->name, what, &inputs[i]);
+    }
+  }
+}
+
+/* fixed cases for bugs found by this harness, so they stay fixed */
+static void
+check_regressions(void) {
+  static const enum dcwmsg_id list_ids[] = { DCWMSG_STA_JOIN, DCWMSG_STA_UNJOIN, DCWMSG_STA_NACK, DCWMSG_AP_REJECT_STA };
+  unsigned char buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg msg;
+  struct dcwmsg out;
+  unsigned len;
+  unsigned m, c;
+
+  for (m = 0; m < ELEMENT_COUNT(list_ids); m++) {
+    for (c = 1; c <= DCWMSG_MAX_ENTRIES; c++) {
+      memset(&msg, 0x5A, sizeof(msg));
+      msg.id = list_ids[m];
+      msg.sta_join.data_macaddr_count = c;
+
+      /* a MAC list one byte short of its count was accepted (count byte counted as data) */
+      fuzz_checks[CHECK_REGRESSION].cases++;
+      len = dcwmsg_serialize(buf, &msg, sizeof(buf));
+      if ((len != (2 + (c * sizeof(dcwmsg_macaddr_t)))) || dcwmsg_marshal(&out, buf, len - 1) || !dcwmsg_marshal(&out, buf, len)) {
+        fuzz_checks[CHECK_REGRESSION].mismatches++;
+        mismatch(fuzz_checks[CHECK_REGRESSION].name, "MAC list length check", buf, len);
+      }
+
+      /* it fits a buffer of exactly its size and not one a byte smaller */
+      fuzz_checks[CHECK_REGRESSION].cases++;
+      if ((dcwmsg_serialize(buf, &msg, len) != len) || (dcwmsg_serialize(buf, &msg, len - 1) != 0)) {
+        fuzz_checks[CHECK_REGRESSION].mismatches++;
+        mismatch(fuzz_checks[CHECK_REGRESSION].name, "exact-size serialize", buf, len);
+      }
+    }
+  }
+}
+
+static int
+fuzz_init(void) {
+  fuzz_ssid_pool = dcwssid_pool_create(FUZZ_CHUNK * DCWMSG_MAX_ENTRIES);
+  fuzz_ctx       = dcwproto_ctx_create(NULL);
+  if ((fuzz_ssid_pool == NULL) || (fuzz_ctx == NULL)) return 0;
+  dcwmsg_ext_init(&fuzz_ext);
+  return 1;
+}
+
+
+
+
+#ifdef DCWFUZZ_LIBFUZZER
+/*
+
+  libFuzzer entry point...
+
+*/
+int
+LLVMFuzzerTestOneInput(const unsigned char * const data, const size_t size) {
+  static int initialized;
+  const unsigned char *bufs[1];
+  unsigned buf_lens[2];
+
+  if (!initialized) {
+    fuzz_rng = 1;
+    if (!fuzz_init()) abort();
+    check_regressions();
+    initialized = 1;
+  }
+  if (size > FUZZ_CASE_MAX) return 0;
+
+  bufs[0]     = data;
+  buf_lens[0] = (unsigned)size;
+  check_decode_chunk(bufs, buf_lens, 1);
+
+  /* whatever decoded also goes through the encoders, with a roomy and a tight buffer */
+  if (fuzz_ref_results[0]) {
+    memcpy(&fuzz_ref_outputs[1], &fuzz_ref_outputs[0], sizeof(fuzz_ref_outputs[0]));
+    buf_lens[0] = DCWMSG_MAX_SERIALIZED_SIZE;
+    buf_lens[1] = dcwmsg_serialized_size(&fuzz_ref_outputs[0]) - (unsigned)(size & 1);
+    check_encode_chunk(fuzz_ref_outputs, buf_lens, 2);
+  }
+  return 0;
+}
+#else
+
+
+
+
+/*
+
+  Throughput measurement functions begin here...
+
+*/
+static double
+now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec;
+}
+
+static void
+run_decode(const fuzz_decode_fn decode, const unsigned char * const * const bufs, const unsigned * const buf_lens, const unsigned count) {
+  unsigned acc;
+  unsigned n;
+  unsigned i, j;
+
+  acc = 0;
+  for (i = 0; i < count; i += n) {
+    n = ((count - i) < FUZZ_CHUNK) ? (count - i) : FUZZ_CHUNK;
+    decode(fuzz_outputs, bufs + i, buf_lens + i, fuzz_results, n);
+    for (j = 0; j < n; j++) acc += (unsigned)fuzz_results[j];
+  }
+  fuzz_sink += acc;
+}
+
+static void
+run_encode(const fuzz_encode_fn encode, const struct dcwmsg * const inputs, const unsigned * const buf_lens, const unsigned count) {
+  static unsigned char out_mem[FUZZ_CHUNK][DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char *bufs[FUZZ_CHUNK];
+  unsigned results[FUZZ_CHUNK];
+  unsigned acc;
+  unsigned n;
+  unsigned i, j;
+
+  for (j = 0; j < FUZZ_CHUNK; j++) bufs[j] = out_mem[j];
+
+  acc = 0;
+  for (i = 0; i < count; i += n) {
+    n = ((count - i) < FUZZ_CHUNK) ? (count - i) : FUZZ_CHUNK;
+    encode(bufs, inputs + i, buf_lens + i, results, n);
+    for (j = 0; j < n; j++) acc += results[j] + out_mem[j][0];
+  }
+  fuzz_sink += acc;
+}
+
+/* grows the pass count until a run lasts at least "target_ns"; returns ns per message */
+static double
+measure(const struct fuzz_path * const path, const unsigned char * const * const bufs, const unsigned * const buf_lens, const struct dcwmsg * const inputs, const unsigned count, const double target_ns) {
+  unsigned long passes;
+  unsigned long i;
+  double start;
+  double elapsed;
+
+  if (count == 0) return 0;
+
+  for (passes = 1; ; passes *= 2) {
+    start = now_ns();
+    for (i = 0; i < passes; i++) {
+      if (path->decode != NULL) run_decode(path->decode, bufs, buf_lens, count);
+      else                      run_encode(path->encode, inputs, buf_lens, count);
+    }
+    elapsed = now_ns() - start;
+    if ((elapsed >= target_ns) || (passes > (1UL << 30))) break;
+  }
+
+  return elapsed / ((double)passes * (double)count);
+}
+
+/*
+  Times each path and the reference on the same valid inputs (the ones the
+  path applies to), so the ratio is like for like.
+*/
+static int
+measure_paths(const unsigned char * const * const bufs, const unsigned * const buf_lens, const unsigned case_count, const struct dcwmsg * const inputs, const unsigned input_count, const double target_ns) {
+  const unsigned char **sel_bufs;
+  unsigned *sel_lens;
+  struct dcwmsg *sel_inputs;
+  struct dcwmsg msg;
+  unsigned sel;
+  unsigned p;
+  unsigned i;
+
+  sel_bufs   = malloc(sizeof(*sel_bufs) * (case_count + 1));
+  sel_lens   = malloc(sizeof(*sel_lens) * (case_count + input_count + 1));
+  sel_inputs = malloc(sizeof(*sel_inputs) * (input_count + 1));
+  if ((sel_bufs == NULL) || (sel_lens == NULL) || (sel_inputs == NULL)) {
+    free(sel_bufs);
+    free(sel_lens);
+    free(sel_inputs);
+    return 0;
+  }
+
+  for (p = 0; p < ELEMENT_COUNT(fuzz_decode_paths); p++) {
+    for (sel = 0, i = 0; i < case_count; i++) {
+      if (!dcwmsg_marshal(&msg, bufs[i], buf_lens[i])) continue;
+      if ((fuzz_decode_paths[p].applies != NULL) && !fuzz_decode_paths[p].applies(bufs[i], buf_lens[i])) continue;
+      sel_bufs[sel]   = bufs[i];
+      sel_lens[sel++] = buf_lens[i];
+    }
+    fuzz_decode_paths[p].ref_ns_per_msg = measure(&fuzz_decode_paths[0], sel_bufs, sel_lens, NULL, sel, target_ns);
+    fuzz_decode_paths[p].ns_per_msg     = (p == 0) ? fuzz_decode_paths[p].ref_ns_per_msg : measure(&fuzz_decode_paths[p], sel_bufs, sel_lens, NULL, sel, target_ns);
+  }
+
+  for (sel = 0, i = 0; i < input_count; i++) {
+    if (dcwmsg_serialized_size(&inputs[i]) == 0) continue;
+    memcpy(&sel_inputs[sel], &inputs[i], sizeof(sel_inputs[0]));
+    sel_lens[sel++] = DCWMSG_MAX_SERIALIZED_SIZE;
+  }
+  for (p = 0; p < ELEMENT_COUNT(fuzz_encode_paths); p++) {
+    fuzz_encode_paths[p].ref_ns_per_msg = measure(&fuzz_encode_paths[0], NULL, sel_lens, sel_inputs, sel, target_ns);
+    fuzz_encode_paths[p].ns_per_msg     = (p == 0) ? fuzz_encode_paths[p].ref_ns_per_msg : measure(&fuzz_encode_paths[p], NULL, sel_lens, sel_inputs, sel, target_ns);
+  }
+
+  free(sel_bufs);
+  free(sel_lens);
+  free(sel_inputs);
+  return 1;
+}
+
+
+
+
+/*
+
+  Main...
+
+*/
+static void
+print_path(const char * const kind, const struct fuzz_path * const path, const int csv, const int timed) {
+  if (!timed || (path->ns_per_msg <= 0)) {
+    printf(csv ? "%s,%s,%lu,%lu,,,\n" : "%-7s %-18s %10lu %10lu %10s %14s %8s\n", kind, path->name, path->cases, path->mismatches, "-", "-", "-");
+    return;
+  }
+  printf(csv ? "%s,%s,%lu,%lu,%.2f,%.0f,%.2f\n" : "%-7s %-18s %10lu %10lu %10.2f %14.0f %7.2fx\n",
+    kind,
+    path->name,
+    path->cases,
+    path->mismatches,
+    path->ns_per_msg,
+    1e9 / path->ns_per_msg,
+    path->ref_ns_per_msg / path->ns_per_msg);
+}
+
+static void
+usage(const char * const argv0) {
+  fprintf(stderr, "Usage: %s [-c] [-n <cases>] [-s <seed>] [-t <milliseconds per path>]\n", argv0);
+}
+
+int
+main(int argc, char *argv[]) {
+  unsigned char case_buf[FUZZ_CASE_MAX];
+  const unsigned char **bufs;
+  unsigned *buf_lens;
+  struct dcwmsg *inputs;
+  unsigned *input_buf_lens;
+  unsigned long long seed;
+  unsigned case_count;
+  unsigned size;
+  unsigned n;
+  unsigned i;
+  double target_ns;
+  int csv;
+  int opt;
+
+  csv        = 0;
+  case_count = 20000;
+  seed       = 1;
+  target_ns  = 100e6;
+  while ((opt = getopt(argc, argv, "cn:s:t:")) != -1) {
+    switch (opt) {
+    case 'c': csv = 1; break;
+    case 'n': case_count = (unsigned)strtoul(optarg, NULL, 0); break;
+    case 's': seed = strtoull(optarg, NULL, 0); break;
+    case 't': target_ns = atof(optarg) * 1e6; break;
+    default:  usage(argv[0]); return 1;
+    }
+  }
+  fuzz_rng = seed ? seed : 1;
+
+  bufs           = calloc(case_count + 1, sizeof(*bufs));
+  buf_lens       = calloc(case_count + 1, sizeof(*buf_lens));
+  inputs         = calloc(case_count + 1, sizeof(*inputs));
+  input_buf_lens = calloc(case_count + 1, sizeof(*input_buf_lens));
+  if ((bufs == NULL) || (buf_lens == NULL) || (inputs == NULL) || (input_buf_lens == NULL) || !fuzz_init()) {
+    fprintf(stderr, "dcwfuzz: out of memory\n");
+    return 1;
+  }
+
+  /* each input gets an allocation of its exact size so sanitizers catch over-reads */
+  for (i = 0; i < case_count; i++) {
+    buf_lens[i] = random_input(case_buf);
+    bufs[i]     = malloc(buf_lens[i] ? buf_lens[i] : 1);
+    if (bufs[i] == NULL) {
+      fprintf(stderr, "dcwfuzz: out of memory\n");
+      return 1;
+    }
+    memcpy((unsigned char *)bufs[i], case_buf, buf_lens[i]);
+  }
+
+  /* encoder inputs get a roomy buffer, one of exactly the right size, or one a byte short */
+  for (i = 0; i < case_count; i++) {
+    random_msg(&inputs[i], 1);
+    size = dcwmsg_serialized_size(&inputs[i]);
+    switch ((size > 0) ? rnd_below(4) : 0) {
+    case 0:
+    case 1:  input_buf_lens[i] = DCWMSG_MAX_SERIALIZED_SIZE; break;
+    case 2:  input_buf_lens[i] = size; break;
+    default: input_buf_lens[i] = size - 1; break;
+    }
+  }
+
+  check_regressions();
+  for (i = 0; i < case_count; i += n) {
+    n = ((case_count - i) < FUZZ_CHUNK) ? (case_count - i) : FUZZ_CHUNK;
+    check_decode_chunk(bufs + i, buf_lens + i, n);
+    check_encode_chunk(inputs + i, input_buf_lens + i, n);
+  }
+
+  if ((target_ns > 0) && (fuzz_mismatches == 0)) {
+    if (!measure_paths(bufs, buf_lens, case_count, inputs, case_count, target_ns)) {
+      fprintf(stderr, "dcwfuzz: out of memory\n");
+      return 1;
+    }
+  }
+
+  if (csv) {
+    printf("kind,path,cases,mismatches,ns_per_msg,msgs_per_sec,vs_reference\n");
+  }
+  else {
+    printf("seed %llu, %u cases\n", seed, case_count);
+    printf("%-7s %-18s %10s %10s %10s %14s %8s\n", "kind", "path", "cases", "mismatches", "ns/msg", "msgs/sec", "vs_ref");
+  }
+  for (i = 0; i < ELEMENT_COUNT(fuzz_decode_paths); i++) print_path("decode", &fuzz_decode_paths[i], csv, target_ns > 0);
+  for (i = 0; i < ELEMENT_COUNT(fuzz_encode_paths); i++) print_path("encode", &fuzz_encode_paths[i], csv, target_ns > 0);
+  for (i = 0; i < ELEMENT_COUNT(fuzz_checks); i++) {
+    printf(csv ? "%s,%s,%lu,%lu,,,\n" : "%-7s %-18s %10lu %10lu %10s %14s %8s\n", "check", fuzz_checks[i].name, fuzz_checks[i].cases, fuzz_checks[i].mismatches, "-", "-", "-");
+  }
+
+  for (i = 0; i < case_count; i++) free((void *)bufs[i]);
+  free(bufs);
+  free(buf_lens);
+  free(inputs);
+  free(input_buf_lens);
+  dcwmsg_ext_free(&fuzz_ext);
+  dcwssid_pool_destroy(fuzz_ssid_pool);
+  dcwproto_ctx_destroy(fuzz_ctx);
+
+  if (fuzz_mismatches > 0) {
+    fprintf(stderr, "dcwfuzz: %lu mismatches (seed %llu)\n", fuzz_mismatches, seed);
+    return 1;
+  }
+  return 0;
+}
+#endif /* #ifdef DCWFUZZ_LIBFUZZER */
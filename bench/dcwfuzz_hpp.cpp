@@ -0,0 +1,55 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwfuzz's dcwproto.hpp paths, built in when configure finds a C++17
+  compiler (see dcwfuzz.c). dcw::decode<T>() and dcw::encode<T>() are picked
+  by the id byte / struct id and compared with the C reference like every
+  other path; converting to and from struct dcwmsg is part of the timed work.
+*/
+
+#include <config.h>
+#include "dcwproto_hpp_ref.hpp"
+
+extern "C" void
+dcwfuzz_decode_hpp(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  for (unsigned i = 0; i < count; i++) {
+    results[i] = 0;
+    if (buf_lens[i] < 1) continue;
+    dcwref::with_type(static_cast<dcwmsg_id>(bufs[i][0]), [&](auto tag) {
+      static typename decltype(tag)::type msg; /* one per type; decode<T>() sets everything it reports */
+      if (dcw::decode(msg, dcw::const_bytes(bufs[i], buf_lens[i])) == 0) return;
+      dcwref::to_c(outputs[i], msg);
+      results[i] = 1;
+    });
+  }
+}
+
+extern "C" void
+dcwfuzz_encode_hpp(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  for (unsigned i = 0; i < count; i++) {
+    results[i] = 0;
+    dcwref::with_type(inputs[i].id, [&](auto tag) {
+      static typename decltype(tag)::type msg;
+      dcwref::from_c(msg, inputs[i]);
+      results[i] = static_cast<unsigned>(dcw::encode(msg, dcw::mutable_bytes(bufs[i], buf_lens[i])));
+    });
+  }
+}
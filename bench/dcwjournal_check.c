@@ -0,0 +1,370 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwjournal_check -- functional test of dcwjournal ("make check").
+  Appends a run of join/ack/unjoin messages for a few stations across
+  several small segments, keeping a dcwsta_table in step and checkpointing
+  it part way. Then, after reopening:
+    . scans by time range and by station / data channel MAC return exactly
+      the records appended there, oldest first
+    . recovery loads the checkpoint, replays only the later records and
+      rebuilds the same table
+    . a corrupted last record is discarded and the next append takes its
+      place
+    . pruning deletes just the segments before the checkpoint, and recovery
+      still rebuilds the same table
+  The journal lives in a temporary directory under the current one, which
+  is removed afterwards.
+
+  Usage: dcwjournal_check
+  Exits non-zero if any case fails.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwjournal.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SEGMENT_SIZE      4096 /* a few dozen records each */
+#define STATION_COUNT     16
+#define DATA_PER_STATION  4
+#define RECORD_COUNT      1000
+#define CHECKPOINT_AT     600
+#define MAX_BINDINGS      (STATION_COUNT * DATA_PER_STATION)
+
+#define TS(K)             (1000000ULL + ((unsigned long long)(K) * 10))
+
+struct scan_log {
+  unsigned long         count;
+  unsigned long long    first_ts;
+  unsigned long long    last_ts;
+  unsigned long long    last_seq;
+  unsigned long long    last_offset;
+  int                   ordered;
+};
+
+struct compare_ctx {
+  const struct dcwsta_table  *other;
+  unsigned                    mismatches;
+};
+
+static int
+check(const int ok, const char * const name, const char * const what) {
+  if (!ok) printf("FAIL %s: %s\n", name, what);
+  return ok;
+}
+
+static void
+make_macaddr(unsigned char * const macaddr, const unsigned kind, const unsigned station, const unsigned index) {
+  macaddr[0] = 0x02;
+  macaddr[1] = 0x00;
+  macaddr[2] = 0x5E;
+  macaddr[3] = (unsigned char)kind;
+  macaddr[4] = (unsigned char)station;
+  macaddr[5] = (unsigned char)index;
+}
+
+/*
+  record k is about station k % STATION_COUNT and one of its data channels;
+  each data channel is joined, then acked, then unjoined, round after round
+*/
+static void
+make_record(const unsigned k, unsigned char * const primary_macaddr, struct dcwmsg * const msg) {
+  const unsigned station = k % STATION_COUNT;
+  const unsigned round   = k / STATION_COUNT;
+  const unsigned data    = round % DATA_PER_STATION;
+
+  make_macaddr(primary_macaddr, 1, station, 0);
+  memset(msg, 0, sizeof(*msg));
+  switch ((round / DATA_PER_STATION) % 3) {
+  case 0:
+    msg->id = DCWMSG_STA_JOIN;
+    msg->sta_join.data_macaddr_count = 1;
+    make_macaddr(msg->sta_join.data_macaddrs[0], 2, station, data);
+    break;
+  case 1:
+    msg->id = DCWMSG_STA_ACK;
+    msg->sta_ack.bonded_data_channel_count = 1;
+    make_macaddr(msg->sta_ack.bonded_data_channels[0].macaddr, 2, station, data);
+    snprintf(msg->sta_ack.bonded_data_channels[0].ssid, sizeof(dcwmsg_ssid_t), "dcw-%u-%u", station, data);
+    break;
+  default:
+    msg->id = DCWMSG_STA_UNJOIN;
+    msg->sta_unjoin.data_macaddr_count = 1;
+    make_macaddr(msg->sta_unjoin.data_macaddrs[0], 2, station, data);
+    break;
+  }
+}
+
+/* records from .. to - 1 are applied to "table" and, unless it is NULL, appended to "journal" */
+static int
+append_records(struct dcwjournal * const journal, struct dcwsta_table * const table, const unsigned from, const unsigned to) {
+  unsigned char primary_macaddr[6];
+  struct dcwmsg msg;
+  unsigned k;
+
+  for (k = from; k < to; k++) {
+    make_record(k, primary_macaddr, &msg);
+    if ((journal != NULL) && !dcwjournal_append(journal, TS(k), primary_macaddr, &msg)) return 0;
+    if (!dcwsta_table_apply(table, primary_macaddr, &msg)) return 0;
+  }
+  return 1;
+}
+
+static int
+on_record(const struct dcwjournal_record * const record, void * const ctx) {
+  struct scan_log * const log = ctx;
+
+  if (log->count == 0) log->first_ts = record->ts_ns;
+  else if (record->ts_ns <= log->last_ts) log->ordered = 0;
+  log->last_ts     = record->ts_ns;
+  log->last_seq    = record->seq;
+  log->last_offset = record->offset;
+  log->count++;
+  return 1;
+}
+
+static struct scan_log
+scan(struct dcwjournal * const journal, const unsigned char * const macaddr, const unsigned long long from_ts, const unsigned long long to_ts) {
+  struct scan_log log;
+
+  memset(&log, 0, sizeof(log));
+  log.ordered = 1;
+  if (dcwjournal_scan(journal, macaddr, from_ts, to_ts, on_record, &log) != log.count) log.ordered = 0;
+  return log;
+}
+
+static void
+compare_binding(const struct dcwsta_binding * const binding, void * const ctx) {
+  struct compare_ctx * const compare = ctx;
+  struct dcwsta_binding other;
+
+  if (!dcwsta_table_lookup(compare->other, binding->data_macaddr, &other) ||
+      (memcmp(other.primary_macaddr, binding->primary_macaddr, sizeof(dcwmsg_macaddr_t)) != 0) ||
+      (other.state != binding->state) ||
+      (other.ssid_len != binding->ssid_len) ||
+      (memcmp(other.ssid, binding->ssid, binding->ssid_len) != 0)) {
+    compare->mismatches++;
+  }
+}
+
+static int
+same_table(const struct dcwsta_table * const a, const struct dcwsta_table * const b) {
+  struct compare_ctx compare;
+
+  compare.other      = b;
+  compare.mismatches = 0;
+  dcwsta_table_foreach(a, compare_binding, &compare);
+  return (compare.mismatches == 0) && (dcwsta_table_count(a) == dcwsta_table_count(b));
+}
+
+/* recovers into a fresh table and compares it with "expected" */
+static int
+check_recover(struct dcwjournal * const journal, const struct dcwsta_table * const expected, const long replayed, const char * const name) {
+  struct dcwsta_table *table;
+  long rv;
+  int ok;
+
+  table = dcwsta_table_create(MAX_BINDINGS);
+  if (table == NULL) return check(0, name, "dcwsta_table_create");
+  rv = dcwjournal_recover(journal, table);
+  ok  = check(rv == replayed, name, "replayed record count");
+  ok &= check(same_table(table, expected), name, "recovered table differs");
+  dcwsta_table_destroy(table);
+  return ok;
+}
+
+/* the number of segment files in "dir" */
+static unsigned
+count_segments(const char * const dir) {
+  struct dirent *ent;
+  unsigned count;
+  size_t len;
+  DIR *d;
+
+  count = 0;
+  d = opendir(dir);
+  if (d == NULL) return 0;
+  while ((ent = readdir(d)) != NULL) {
+    len = strlen(ent->d_name);
+    if ((len > 4) && (strcmp(ent->d_name + len - 4, ".seg") == 0)) count++;
+  }
+  closedir(d);
+  return count;
+}
+
+static void
+remove_dir(const char * const dir) {
+  char path[PATH_MAX];
+  struct dirent *ent;
+  DIR *d;
+
+  d = opendir(dir);
+  if (d != NULL) {
+    while ((ent = readdir(d)) != NULL) {
+      if ((strcmp(ent->d_name, ".") == 0) || (strcmp(ent->d_name, "..") == 0)) continue;
+      snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+      unlink(path);
+    }
+    closedir(d);
+  }
+  rmdir(dir);
+}
+
+/* flips a byte of the record's message so its checksum no longer matches */
+static int
+corrupt_record(const char * const dir, const unsigned long long seq, const unsigned long long offset) {
+  char path[PATH_MAX];
+  unsigned char byte;
+  int ok;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/%016llx.seg", dir, seq);
+  fd = open(path, O_RDWR);
+  if (fd < 0) return 0;
+  ok = (pread(fd, &byte, 1, (off_t)(offset + 24)) == 1);
+  byte ^= 0x40;
+  ok = ok && (pwrite(fd, &byte, 1, (off_t)(offset + 24)) == 1);
+  close(fd);
+  return ok;
+}
+
+static int
+run(const char * const dir) {
+  unsigned char macaddr[6];
+  struct dcwsta_table *expected;
+  struct dcwsta_table *torn;
+  struct dcwjournal *journal;
+  struct scan_log log;
+  unsigned long want;
+  unsigned segments;
+  unsigned pruned;
+  unsigned k;
+  int ok;
+
+  expected = dcwsta_table_create(MAX_BINDINGS);
+  torn     = dcwsta_table_create(MAX_BINDINGS);
+  journal  = dcwjournal_open(dir, SEGMENT_SIZE);
+  if ((expected == NULL) || (torn == NULL) || (journal == NULL)) return check(0, "open", "dcwjournal_open / dcwsta_table_create");
+
+  /* append, checkpointing part way */
+  ok  = check(append_records(journal, expected, 0, CHECKPOINT_AT), "append", "dcwjournal_append");
+  ok &= check(dcwjournal_checkpoint(journal, expected), "checkpoint", "dcwjournal_checkpoint");
+  ok &= check(append_records(journal, expected, CHECKPOINT_AT, RECORD_COUNT), "append", "dcwjournal_append");
+  dcwjournal_close(journal);
+  segments = count_segments(dir);
+  ok &= check(segments >= 4, "append", "records did not span several segments");
+  if (!ok) return 0;
+  printf("ok   append (%u records, %u segments)\n", RECORD_COUNT, segments);
+
+  journal = dcwjournal_open(dir, SEGMENT_SIZE);
+  if (journal == NULL) return check(0, "reopen", "dcwjournal_open");
+
+  /* scans */
+  log = scan(journal, NULL, 0, ~0ULL);
+  ok &= check((log.count == RECORD_COUNT) && log.ordered && (log.first_ts == TS(0)) && (log.last_ts == TS(RECORD_COUNT - 1)), "scan", "full scan");
+  log = scan(journal, NULL, TS(200), TS(299));
+  ok &= check((log.count == 100) && log.ordered && (log.first_ts == TS(200)) && (log.last_ts == TS(299)), "scan", "time range");
+  log = scan(journal, NULL, TS(200) + 1, TS(200) + 9);
+  ok &= check(log.count == 0, "scan", "time range between records");
+
+  make_macaddr(macaddr, 1, 3, 0); /* station 3: every 16th record */
+  want = (RECORD_COUNT - 3 + STATION_COUNT - 1) / STATION_COUNT;
+  log = scan(journal, macaddr, 0, ~0ULL);
+  ok &= check((log.count == want) && log.ordered && (log.first_ts == TS(3)), "scan", "station MAC");
+  make_macaddr(macaddr, 2, 3, 1); /* station 3's second data channel: every 4th of those */
+  for (want = 0, k = 3; k < RECORD_COUNT; k += STATION_COUNT) want += ((k / STATION_COUNT) % DATA_PER_STATION) == 1;
+  log = scan(journal, macaddr, 0, ~0ULL);
+  ok &= check((log.count == want) && log.ordered && (log.first_ts == TS(3 + STATION_COUNT)), "scan", "data channel MAC");
+  log = scan(journal, macaddr, TS(CHECKPOINT_AT), ~0ULL);
+  for (want = 0, k = 3; k < RECORD_COUNT; k += STATION_COUNT) want += (k >= CHECKPOINT_AT) && (((k / STATION_COUNT) % DATA_PER_STATION) == 1);
+  ok &= check(log.count == want, "scan", "data channel MAC and time range");
+  make_macaddr(macaddr, 3, 0, 0); /* never used */
+  log = scan(journal, macaddr, 0, ~0ULL);
+  ok &= check(log.count == 0, "scan", "unknown MAC");
+  if (ok) printf("ok   scan\n");
+
+  /* checkpoint + replay */
+  ok &= check_recover(journal, expected, RECORD_COUNT - CHECKPOINT_AT, "recover");
+  if (ok) printf("ok   recover\n");
+
+  /* a corrupted last record is gone after a reopen, and its space reused */
+  log = scan(journal, NULL, 0, ~0ULL);
+  dcwjournal_close(journal);
+  ok &= check(corrupt_record(dir, log.last_seq, log.last_offset), "torn tail", "could not corrupt the last record");
+  journal = dcwjournal_open(dir, SEGMENT_SIZE);
+  if (journal == NULL) return check(0, "torn tail", "dcwjournal_open");
+  log = scan(journal, NULL, 0, ~0ULL);
+  ok &= check((log.count == (RECORD_COUNT - 1)) && (log.last_ts == TS(RECORD_COUNT - 2)), "torn tail", "corrupted record was not discarded");
+
+  /* recovery stops short of it too; appending it again restores the full state */
+  ok &= check(append_records(NULL, torn, 0, RECORD_COUNT - 1), "torn tail", "dcwsta_table_apply");
+  ok &= check_recover(journal, torn, RECORD_COUNT - 1 - CHECKPOINT_AT, "torn tail");
+  ok &= check(append_records(journal, torn, RECORD_COUNT - 1, RECORD_COUNT), "torn tail", "dcwjournal_append");
+  log = scan(journal, NULL, 0, ~0ULL);
+  ok &= check((log.count == RECORD_COUNT) && log.ordered && (log.last_ts == TS(RECORD_COUNT - 1)), "torn tail", "append after the discarded record");
+  ok &= check_recover(journal, expected, RECORD_COUNT - CHECKPOINT_AT, "torn tail");
+  if (ok) printf("ok   torn tail\n");
+
+  /* prune: only whole segments before the checkpoint go */
+  pruned = dcwjournal_prune(journal);
+  ok &= check((pruned > 0) && (count_segments(dir) == (segments - pruned)), "prune", "segment files removed");
+  log = scan(journal, NULL, 0, ~0ULL);
+  ok &= check((log.count < RECORD_COUNT) && (log.count >= (RECORD_COUNT - CHECKPOINT_AT)) && (log.first_ts <= TS(CHECKPOINT_AT)) && (log.last_ts == TS(RECORD_COUNT - 1)), "prune", "records kept");
+  ok &= check(dcwjournal_prune(journal) == 0, "prune", "second prune");
+  ok &= check_recover(journal, expected, RECORD_COUNT - CHECKPOINT_AT, "prune");
+  dcwjournal_close(journal);
+
+  /* and the same after a reopen */
+  journal = dcwjournal_open(dir, SEGMENT_SIZE);
+  if (journal == NULL) return check(0, "prune", "dcwjournal_open");
+  ok &= check(scan(journal, NULL, 0, ~0ULL).count == log.count, "prune", "records kept after reopen");
+  ok &= check_recover(journal, expected, RECORD_COUNT - CHECKPOINT_AT, "prune");
+  if (ok) printf("ok   prune (%u segments)\n", pruned);
+
+  dcwjournal_close(journal);
+  dcwsta_table_destroy(expected);
+  dcwsta_table_destroy(torn);
+  return ok;
+}
+
+int
+main(void) {
+  char dir[] = "dcwjournal_check.XXXXXX";
+  int ok;
+
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  ok = run(dir);
+  remove_dir(dir);
+  return ok ? 0 : 1;
+}
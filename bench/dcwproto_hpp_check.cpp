@@ -0,0 +1,248 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwproto_hpp_check -- checks dcwproto.hpp against the C codec ("make check").
+  For every message type, dcw::encode<T>() must write the same bytes as
+  dcwmsg_serialize() does for the equivalent struct dcwmsg, and refuse a
+  buffer one byte short without touching it; dcw::decode<T>() must accept
+  exactly what dcwmsg_marshal() accepts, consume the same bytes and encode
+  back to them. The samples include empty, full and 32 byte entries and
+  SSIDs with an embedded NUL, which both encoders end at the NUL while both
+  decoders keep every byte the wire carried.
+
+  Usage: dcwproto_hpp_check
+  Exits non-zero if any case fails.
+*/
+
+#include <config.h>
+#include "dcwproto_hpp_ref.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#define GUARD_SIZE  16 /* bytes past the buffer the encoder must leave alone */
+#define GUARD_BYTE  0xA5
+
+static int
+check(const int ok, const char * const name, const char * const what) {
+  if (!ok) std::printf("FAIL %s: %s\n", name, what);
+  return ok;
+}
+
+static dcw::ssid
+make_ssid(const char * const chars, const std::size_t len) {
+  dcw::ssid ssid;
+  ssid.len = len;
+  std::memcpy(ssid.chars.data(), chars, len);
+  return ssid;
+}
+
+static dcw::macaddr
+make_macaddr(const unsigned n) {
+  return dcw::macaddr{ 0x02, 0x00, 0x5E, static_cast<unsigned char>(n >> 16), static_cast<unsigned char>(n >> 8), static_cast<unsigned char>(n) };
+}
+
+/* every other message type must reject bytes encoded as T */
+template <typename T>
+static int
+check_other_types(const char * const name, const unsigned char * const buf, const unsigned len) {
+  static const dcwmsg_id ids[] = {
+    DCWMSG_STA_JOIN, DCWMSG_STA_UNJOIN, DCWMSG_STA_ACK, DCWMSG_STA_NACK,
+    DCWMSG_AP_ACCEPT_STA, DCWMSG_AP_REJECT_STA, DCWMSG_AP_ACK_DISCONNECT, DCWMSG_AP_QUIT,
+  };
+  int ok = 1;
+
+  for (const dcwmsg_id id : ids) {
+    if (id == T::id) continue;
+    dcwref::with_type(id, [&](auto tag) {
+      typename decltype(tag)::type other{};
+      ok &= check(dcw::decode(other, dcw::const_bytes(buf, len)) == 0, name, "decode<T>() accepted another message type");
+    });
+  }
+  return ok;
+}
+
+template <typename T>
+static int
+run_case(const char * const name, const T &msg) {
+  unsigned char hpp_buf[DCWMSG_MAX_SERIALIZED_SIZE + GUARD_SIZE];
+  unsigned char c_buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char again[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg c_msg;
+  struct dcwmsg c_back;
+  std::size_t hpp_len;
+  std::size_t again_len;
+  unsigned c_len;
+  unsigned len;
+  int ok = 1;
+
+  /* encode<T>() vs dcwmsg_serialize() */
+  dcwref::to_c(c_msg, msg);
+  std::memset(hpp_buf, GUARD_BYTE, sizeof(hpp_buf));
+  hpp_len = dcw::encode(msg, dcw::mutable_bytes(hpp_buf, DCWMSG_MAX_SERIALIZED_SIZE));
+  c_len = dcwmsg_serialize(c_buf, &c_msg, sizeof(c_buf));
+  ok &= check((hpp_len > 0) && (hpp_len == c_len) && (std::memcmp(hpp_buf, c_buf, c_len) == 0), name, "encode<T>() differs from dcwmsg_serialize()");
+  ok &= check(dcw::encoded_size(msg) == hpp_len, name, "encoded_size() differs from encode<T>()");
+  ok &= check(hpp_buf[DCWMSG_MAX_SERIALIZED_SIZE] == GUARD_BYTE, name, "encode<T>() wrote past the buffer");
+  if (!ok) return 0;
+
+  /* one byte short is refused without a write */
+  std::memset(hpp_buf, GUARD_BYTE, sizeof(hpp_buf));
+  ok &= check(dcw::encode(msg, dcw::mutable_bytes(hpp_buf, hpp_len - 1)) == 0, name, "encode<T>() accepted a short buffer");
+  ok &= check(hpp_buf[0] == GUARD_BYTE, name, "encode<T>() wrote to a short buffer");
+
+  /* decode<T>() vs dcwmsg_marshal(), whole and with trailing bytes */
+  for (const unsigned trailing : { 0u, 3u }) {
+    T back{};
+    std::memset(c_buf + c_len, 0x11, sizeof(c_buf) - c_len);
+    len = ((c_len + trailing) <= sizeof(c_buf)) ? (c_len + trailing) : c_len;
+    ok &= check(dcwmsg_marshal(&c_back, c_buf, len) != 0, name, "dcwmsg_marshal() rejected its own output");
+    ok &= check(dcw::decode(back, dcw::const_bytes(c_buf, len)) == c_len, name, "decode<T>() consumed a different length");
+    again_len = dcw::encode(back, dcw::mutable_bytes(again, sizeof(again)));
+    ok &= check((again_len == c_len) && (std::memcmp(again, c_buf, c_len) == 0), name, "decode<T>() did not encode back to the same bytes");
+  }
+
+  /* every truncation: both decoders agree */
+  for (len = 0; len < c_len; len++) {
+    T back{};
+    ok &= check((dcw::decode(back, dcw::const_bytes(c_buf, len)) != 0) == (dcwmsg_marshal(&c_back, c_buf, len) != 0), name, "decode<T>() and dcwmsg_marshal() disagree on a truncated message");
+  }
+
+  ok &= check_other_types<T>(name, c_buf, c_len);
+  if (ok) std::printf("ok   %s\n", name);
+  return ok;
+}
+
+/* wire bytes holding an SSID with a NUL in it: decoded whole, encoded up to the NUL */
+template <typename T>
+static int
+run_nul_case(const char * const name, const unsigned char * const wire, const unsigned wire_len, const unsigned char * const canonical, const unsigned canonical_len) {
+  unsigned char hpp_buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char c_buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg c_msg;
+  std::size_t hpp_len;
+  unsigned c_len;
+  T msg{};
+  int ok = 1;
+
+  ok &= check(dcw::decode(msg, dcw::const_bytes(wire, wire_len)) == wire_len, name, "decode<T>() rejected an SSID with a NUL");
+  ok &= check(dcwmsg_marshal(&c_msg, wire, wire_len) != 0, name, "dcwmsg_marshal() rejected an SSID with a NUL");
+  if (!ok) return 0;
+
+  if constexpr (std::is_same_v<T, dcw::sta_ack>) {
+    ok &= check((msg.bonded_data_channels[0].ssid.len == wire[8]) && (std::memcmp(msg.bonded_data_channels[0].ssid.chars.data(), &wire[9], wire[8]) == 0), name, "decode<T>() did not keep the whole SSID");
+  }
+  else {
+    ok &= check((msg.data_ssids[0].len == wire[2]) && (std::memcmp(msg.data_ssids[0].chars.data(), &wire[3], wire[2]) == 0), name, "decode<T>() did not keep the whole SSID");
+  }
+
+  hpp_len = dcw::encode(msg, dcw::mutable_bytes(hpp_buf, sizeof(hpp_buf)));
+  c_len = dcwmsg_serialize(c_buf, &c_msg, sizeof(c_buf));
+  ok &= check((c_len == canonical_len) && (std::memcmp(c_buf, canonical, canonical_len) == 0), name, "dcwmsg_serialize() did not end the SSID at the NUL");
+  ok &= check((hpp_len == canonical_len) && (std::memcmp(hpp_buf, canonical, canonical_len) == 0), name, "encode<T>() did not end the SSID at the NUL");
+  if (ok) std::printf("ok   %s\n", name);
+  return ok;
+}
+
+template <typename T>
+static int
+run_macaddr_cases(const char * const name) {
+  char what[64];
+  int ok = 1;
+
+  for (const unsigned count : { 0u, 1u, 5u, static_cast<unsigned>(DCWMSG_MAX_ENTRIES) }) {
+    T msg{};
+    msg.count = count;
+    for (unsigned i = 0; i < count; i++) msg.macaddrs[i] = make_macaddr((T::id << 8) | i);
+    std::snprintf(what, sizeof(what), "%s/%u", name, count);
+    ok &= run_case(what, msg);
+  }
+  return ok;
+}
+
+/* a count past DCWMSG_MAX_ENTRIES is refused by both encoders */
+template <typename T>
+static int
+run_over_limit_case(const char * const name) {
+  unsigned char buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg c_msg;
+  T msg{};
+  int ok = 1;
+
+  msg.count = DCWMSG_MAX_ENTRIES + 1;
+  dcwref::to_c(c_msg, msg);
+  ok &= check(dcw::encode(msg, dcw::mutable_bytes(buf, sizeof(buf))) == 0, name, "encode<T>() accepted too many entries");
+  ok &= check(dcwmsg_serialize(buf, &c_msg, sizeof(buf)) == 0, name, "dcwmsg_serialize() accepted too many entries");
+  if (ok) std::printf("ok   %s\n", name);
+  return ok;
+}
+
+int
+main() {
+  static const char full[32] = { 'd', 'c', 'w', '-', 'f', 'u', 'l', 'l', '-', 's', 's', 'i', 'd', '-', 'o', 'f',
+                                  '-', '3', '2', '-', 'b', 'y', 't', 'e', 's', '-', '.', '.', '.', '.', '.', '!' };
+  static const unsigned char ack_nul_wire[]       = { DCWMSG_STA_ACK, 1, 2, 0, 0x5E, 1, 2, 3, 5, 'a', 'b', 0, 'c', 'd' };
+  static const unsigned char ack_nul_canonical[]  = { DCWMSG_STA_ACK, 1, 2, 0, 0x5E, 1, 2, 3, 2, 'a', 'b' };
+  static const unsigned char acc_nul_wire[]       = { DCWMSG_AP_ACCEPT_STA, 1, 4, 0, 'x', 'y', 'z' };
+  static const unsigned char acc_nul_canonical[]  = { DCWMSG_AP_ACCEPT_STA, 1, 0 };
+  dcw::sta_ack ack;
+  dcw::ap_accept_sta accept;
+  int ok = 1;
+
+  ok &= run_macaddr_cases<dcw::sta_join>("sta_join");
+  ok &= run_macaddr_cases<dcw::sta_unjoin>("sta_unjoin");
+  ok &= run_macaddr_cases<dcw::sta_nack>("sta_nack");
+  ok &= run_macaddr_cases<dcw::ap_reject_sta>("ap_reject_sta");
+
+  ok &= run_case("sta_ack/0", ack);
+  ack.count = 4;
+  ack.bonded_data_channels[0] = { make_macaddr(1), make_ssid("dcw-data-1", 10) };
+  ack.bonded_data_channels[1] = { make_macaddr(2), make_ssid("", 0) };
+  ack.bonded_data_channels[2] = { make_macaddr(3), make_ssid(full, sizeof(full)) };
+  ack.bonded_data_channels[3] = { make_macaddr(4), make_ssid("ab\0cd", 5) };
+  ok &= run_case("sta_ack/4", ack);
+  ack.count = DCWMSG_MAX_ENTRIES;
+  for (unsigned i = 4; i < ack.count; i++) ack.bonded_data_channels[i] = { make_macaddr(i), make_ssid(full, sizeof(full)) };
+  ok &= run_case("sta_ack/max", ack);
+
+  ok &= run_case("ap_accept_sta/0", accept);
+  accept.count = 4;
+  accept.data_ssids[0] = make_ssid("a", 1);
+  accept.data_ssids[1] = make_ssid("", 0);
+  accept.data_ssids[2] = make_ssid(full, sizeof(full));
+  accept.data_ssids[3] = make_ssid("\0xyz", 4);
+  ok &= run_case("ap_accept_sta/4", accept);
+  accept.count = DCWMSG_MAX_ENTRIES;
+  for (unsigned i = 4; i < accept.count; i++) accept.data_ssids[i] = make_ssid(full, 1 + i);
+  ok &= run_case("ap_accept_sta/max", accept);
+
+  ok &= run_case("ap_ack_disconnect", dcw::ap_ack_disconnect{});
+  ok &= run_case("ap_quit", dcw::ap_quit{});
+
+  ok &= run_nul_case<dcw::sta_ack>("sta_ack/nul", ack_nul_wire, sizeof(ack_nul_wire), ack_nul_canonical, sizeof(ack_nul_canonical));
+  ok &= run_nul_case<dcw::ap_accept_sta>("ap_accept_sta/nul", acc_nul_wire, sizeof(acc_nul_wire), acc_nul_canonical, sizeof(acc_nul_canonical));
+
+  ok &= run_over_limit_case<dcw::sta_join>("sta_join/over");
+  ok &= run_over_limit_case<dcw::sta_ack>("sta_ack/over");
+  ok &= run_over_limit_case<dcw::ap_accept_sta>("ap_accept_sta/over");
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  Conversions between the dcwproto.hpp message types and struct dcwmsg,
+  shared by dcwproto_hpp_check and dcwfuzz so both compare dcw::encode<T>() /
+  dcw::decode<T>() with the C reference on the same terms.
+*/
+
+#ifndef DCWPROTO_HPP_REF_HPP_INCLUDED
+#define DCWPROTO_HPP_REF_HPP_INCLUDED
+
+#include <dcwproto.h>
+#include <dcwproto.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace dcwref {
+
+template <typename T>
+struct type_tag { using type = T; };
+
+/* calls f(type_tag<T>{}) for the dcwproto.hpp type of "id"; false for an unknown id */
+template <typename F>
+inline bool
+with_type(const dcwmsg_id id, F &&f) {
+  switch (id) {
+  case DCWMSG_STA_JOIN:           f(type_tag<dcw::sta_join>{});          return true;
+  case DCWMSG_STA_UNJOIN:         f(type_tag<dcw::sta_unjoin>{});        return true;
+  case DCWMSG_STA_ACK:            f(type_tag<dcw::sta_ack>{});           return true;
+  case DCWMSG_STA_NACK:           f(type_tag<dcw::sta_nack>{});          return true;
+  case DCWMSG_AP_ACCEPT_STA:      f(type_tag<dcw::ap_accept_sta>{});     return true;
+  case DCWMSG_AP_REJECT_STA:      f(type_tag<dcw::ap_reject_sta>{});     return true;
+  case DCWMSG_AP_ACK_DISCONNECT:  f(type_tag<dcw::ap_ack_disconnect>{}); return true;
+  case DCWMSG_AP_QUIT:            f(type_tag<dcw::ap_quit>{});           return true;
+  default:                        return false;
+  }
+}
+
+/* the C struct holds all 32 bytes of an SSID, NULs included */
+inline void
+ssid_to_c(char * const out, const dcw::ssid &in) {
+  std::memset(out, 0, sizeof(dcwmsg_ssid_t));
+  std::memcpy(out, in.chars.data(), std::min(in.len, sizeof(dcwmsg_ssid_t)));
+}
+
+inline void
+ssid_from_c(dcw::ssid &out, const char * const in) {
+  out.len = sizeof(dcwmsg_ssid_t);
+  std::memcpy(out.chars.data(), in, sizeof(dcwmsg_ssid_t));
+}
+
+/* entries past DCWMSG_MAX_ENTRIES are not copied; the count is, so both sides reject it */
+template <typename T>
+inline void
+to_c(struct dcwmsg &out, const T &in) {
+  std::memset(&out, 0, sizeof(out));
+  out.id = T::id;
+  if constexpr (std::is_base_of_v<dcw::macaddr_list<T::id>, T>) {
+    /* all four MAC list structs share the same layout */
+    out.sta_join.data_macaddr_count = static_cast<unsigned>(in.count);
+    for (std::size_t i = 0; i < std::min<std::size_t>(in.count, DCWMSG_MAX_ENTRIES); i++) {
+      std::memcpy(out.sta_join.data_macaddrs[i], in.macaddrs[i].data(), sizeof(dcwmsg_macaddr_t));
+    }
+  }
+  else if constexpr (std::is_same_v<T, dcw::sta_ack>) {
+    out.sta_ack.bonded_data_channel_count = static_cast<unsigned>(in.count);
+    for (std::size_t i = 0; i < std::min<std::size_t>(in.count, DCWMSG_MAX_ENTRIES); i++) {
+      std::memcpy(out.sta_ack.bonded_data_channels[i].macaddr, in.bonded_data_channels[i].macaddr.data(), sizeof(dcwmsg_macaddr_t));
+      ssid_to_c(out.sta_ack.bonded_data_channels[i].ssid, in.bonded_data_channels[i].ssid);
+    }
+  }
+  else if constexpr (std::is_same_v<T, dcw::ap_accept_sta>) {
+    out.ap_accept_sta.data_ssid_count = static_cast<unsigned>(in.count);
+    for (std::size_t i = 0; i < std::min<std::size_t>(in.count, DCWMSG_MAX_ENTRIES); i++) {
+      ssid_to_c(out.ap_accept_sta.data_ssids[i], in.data_ssids[i]);
+    }
+  }
+  else {
+    (void)in; /* id only */
+  }
+}
+
+template <typename T>
+inline void
+from_c(T &out, const struct dcwmsg &in) {
+  if constexpr (std::is_base_of_v<dcw::macaddr_list<T::id>, T>) {
+    out.count = in.sta_join.data_macaddr_count;
+    for (std::size_t i = 0; i < std::min<std::size_t>(out.count, DCWMSG_MAX_ENTRIES); i++) {
+      std::memcpy(out.macaddrs[i].data(), in.sta_join.data_macaddrs[i], sizeof(dcwmsg_macaddr_t));
+    }
+  }
+  else if constexpr (std::is_same_v<T, dcw::sta_ack>) {
+    out.count = in.sta_ack.bonded_data_channel_count;
+    for (std::size_t i = 0; i < std::min<std::size_t>(out.count, DCWMSG_MAX_ENTRIES); i++) {
+      std::memcpy(out.bonded_data_channels[i].macaddr.data(), in.sta_ack.bonded_data_channels[i].macaddr, sizeof(dcwmsg_macaddr_t));
+      ssid_from_c(out.bonded_data_channels[i].ssid, in.sta_ack.bonded_data_channels[i].ssid);
+    }
+  }
+  else if constexpr (std::is_same_v<T, dcw::ap_accept_sta>) {
+    out.count = in.ap_accept_sta.data_ssid_count;
+    for (std::size_t i = 0; i < std::min<std::size_t>(out.count, DCWMSG_MAX_ENTRIES); i++) {
+      ssid_from_c(out.data_ssids[i], in.ap_accept_sta.data_ssids[i]);
+    }
+  }
+  else {
+    (void)out; /* id only */
+    (void)in;
+  }
+}
+
+} // namespace dcwref
+
+
+#endif /* #ifndef DCWPROTO_HPP_REF_HPP_INCLUDED */
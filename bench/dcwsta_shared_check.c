@@ -0,0 +1,245 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwsta_shared_check -- functional test of the shared station table
+  ("make check"). The writer rebonds a set of data channel MACs to a new
+  generation (carried in both the primary MAC and the SSID) in each batch
+  and publishes it, while reader threads look them up without pause. Checks
+  that readers never see an unpublished batch, a generation going backwards
+  or a binding mixing two generations; that a MAC unjoined in every other
+  batch is only ever seen from a batch that joined it; that after each
+  publish both instances agree; and that dcwsta_shared_publish() returns 0
+  for a batch with an update that failed to apply, then 1 again.
+
+  Usage: dcwsta_shared_check
+  Exits non-zero if any case fails.
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwsta.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READER_COUNT  2
+#define MAC_COUNT     16  /* rebonded every batch; one more is joined / unjoined in turn */
+#define BATCH_COUNT   3000
+#define MAX_BINDINGS  64
+
+struct check_state {
+  struct dcwsta_shared   *shared;
+  atomic_uint             publishing;   /* generation of the batch being (or last) published */
+  atomic_int              done;
+  atomic_ulong            lookups;
+  atomic_ulong            unpublished;
+  atomic_ulong            backwards;
+  atomic_ulong            torn;
+  atomic_ulong            missing;
+};
+
+struct reader_arg {
+  struct check_state     *state;
+  unsigned                reader_id;
+};
+
+static int
+check(const int ok, const char * const name, const char * const what) {
+  if (!ok) printf("FAIL %s: %s\n", name, what);
+  return ok;
+}
+
+static void
+make_macaddr(unsigned char * const macaddr, const unsigned kind, const unsigned n) {
+  macaddr[0] = 0x02;
+  macaddr[1] = (unsigned char)kind;
+  macaddr[2] = (unsigned char)(n >> 24);
+  macaddr[3] = (unsigned char)(n >> 16);
+  macaddr[4] = (unsigned char)(n >> 8);
+  macaddr[5] = (unsigned char)n;
+}
+
+static unsigned
+macaddr_gen(const unsigned char * const macaddr) {
+  return ((unsigned)macaddr[2] << 24) | ((unsigned)macaddr[3] << 16) | ((unsigned)macaddr[4] << 8) | macaddr[5];
+}
+
+/* returns the binding's generation, or 0 if its primary MAC and SSID disagree */
+static unsigned
+binding_gen(const struct dcwsta_binding * const binding) {
+  char ssid[sizeof(dcwmsg_ssid_t) + 1];
+  unsigned gen;
+
+  memcpy(ssid, binding->ssid, binding->ssid_len);
+  ssid[binding->ssid_len] = '\0';
+  if ((binding->state != DCWSTA_BONDED) || (sscanf(ssid, "gen-%u", &gen) != 1)) return 0;
+  return (gen == macaddr_gen(binding->primary_macaddr)) ? gen : 0;
+}
+
+/* STA_ACK bonding "count" data MACs starting at "first" to generation "gen" */
+static void
+make_ack(struct dcwmsg * const msg, unsigned char * const primary_macaddr, const unsigned first, const unsigned count, const unsigned gen) {
+  unsigned i;
+
+  make_macaddr(primary_macaddr, 1, gen);
+  memset(msg, 0, sizeof(*msg));
+  msg->id = DCWMSG_STA_ACK;
+  msg->sta_ack.bonded_data_channel_count = count;
+  for (i = 0; i < count; i++) {
+    make_macaddr(msg->sta_ack.bonded_data_channels[i].macaddr, 2, first + i);
+    snprintf(msg->sta_ack.bonded_data_channels[i].ssid, sizeof(dcwmsg_ssid_t), "gen-%u", gen);
+  }
+}
+
+static void *
+reader_main(void * const arg) {
+  const struct reader_arg * const reader = arg;
+  struct check_state * const state = reader->state;
+  unsigned last[MAC_COUNT + 1];
+  unsigned char macaddr[6];
+  struct dcwsta_binding binding;
+  unsigned long lookups;
+  unsigned gen;
+  unsigned i;
+
+  memset(last, 0, sizeof(last));
+  lookups = 0;
+  while (!atomic_load(&state->done)) {
+    for (i = 0; i <= MAC_COUNT; i++) {
+      make_macaddr(macaddr, 2, i);
+      lookups++;
+      if (!dcwsta_shared_lookup(state->shared, reader->reader_id, macaddr, &binding)) {
+        if (i < MAC_COUNT) atomic_fetch_add(&state->missing, 1);
+        continue;
+      }
+
+      gen = binding_gen(&binding);
+      if (gen == 0) atomic_fetch_add(&state->torn, 1);
+      else if (gen > atomic_load(&state->publishing)) atomic_fetch_add(&state->unpublished, 1);
+      else if (gen < last[i]) atomic_fetch_add(&state->backwards, 1);
+      else if ((i == MAC_COUNT) && ((gen % 2) != 0)) atomic_fetch_add(&state->missing, 1); /* unjoined in odd batches */
+      if (gen > last[i]) last[i] = gen;
+    }
+  }
+  atomic_fetch_add(&state->lookups, lookups);
+  return NULL;
+}
+
+/* each data MAC must be found at generation "gen" by both instances, one publish apart */
+static int
+check_published(struct check_state * const state, const unsigned gen) {
+  unsigned char macaddr[6];
+  struct dcwsta_binding binding;
+  unsigned i;
+
+  for (i = 0; i < MAC_COUNT; i++) {
+    make_macaddr(macaddr, 2, i);
+    if (!dcwsta_shared_lookup(state->shared, READER_COUNT, macaddr, &binding) || (binding_gen(&binding) != gen)) return 0;
+  }
+  return 1;
+}
+
+int
+main(void) {
+  static struct check_state state;
+  struct reader_arg readers[READER_COUNT];
+  pthread_t threads[READER_COUNT];
+  unsigned char primary_macaddr[6];
+  struct dcwmsg msg;
+  unsigned gen;
+  unsigned i;
+  int ok;
+
+  /* one extra reader slot for the writer's own checks */
+  state.shared = dcwsta_shared_create(MAX_BINDINGS, READER_COUNT + 1);
+  if (state.shared == NULL) return check(0, "create", "dcwsta_shared_create") ? 0 : 1;
+  atomic_init(&state.publishing, 1);
+  atomic_init(&state.done, 0);
+  atomic_init(&state.lookups, 0);
+  atomic_init(&state.unpublished, 0);
+  atomic_init(&state.backwards, 0);
+  atomic_init(&state.torn, 0);
+  atomic_init(&state.missing, 0);
+
+  /* generation 1 is in place before the readers start */
+  make_ack(&msg, primary_macaddr, 0, MAC_COUNT, 1);
+  ok  = check(dcwsta_shared_apply(state.shared, primary_macaddr, &msg), "publish", "dcwsta_shared_apply");
+  ok &= check(dcwsta_shared_publish(state.shared), "publish", "dcwsta_shared_publish");
+
+  for (i = 0; i < READER_COUNT; i++) {
+    readers[i].state     = &state;
+    readers[i].reader_id = i;
+    if (pthread_create(&threads[i], NULL, reader_main, &readers[i]) != 0) return check(0, "readers", "pthread_create") ? 0 : 1;
+  }
+
+  for (gen = 2; gen <= BATCH_COUNT; gen++) {
+    make_ack(&msg, primary_macaddr, 0, MAC_COUNT, gen);
+    ok &= check(dcwsta_shared_apply(state.shared, primary_macaddr, &msg), "publish", "dcwsta_shared_apply");
+    if ((gen % 2) == 0) {
+      make_ack(&msg, primary_macaddr, MAC_COUNT, 1, gen);
+    }
+    else {
+      msg.id = DCWMSG_STA_UNJOIN;
+      msg.sta_unjoin.data_macaddr_count = 1;
+      make_macaddr(msg.sta_unjoin.data_macaddrs[0], 2, MAC_COUNT);
+    }
+    ok &= check(dcwsta_shared_apply(state.shared, primary_macaddr, &msg), "publish", "dcwsta_shared_apply");
+
+    atomic_store(&state.publishing, gen);
+    ok &= check(dcwsta_shared_publish(state.shared), "publish", "dcwsta_shared_publish");
+    if ((gen % 500) == 0) {
+      /* the instance just published, then the one the batch was replayed onto */
+      ok &= check(check_published(&state, gen), "publish", "published batch not visible");
+      ok &= check(dcwsta_shared_publish(state.shared), "publish", "empty dcwsta_shared_publish");
+      ok &= check(check_published(&state, gen), "publish", "instances differ after the replay");
+    }
+  }
+
+  atomic_store(&state.done, 1);
+  for (i = 0; i < READER_COUNT; i++) pthread_join(threads[i], NULL);
+
+  ok &= check(atomic_load(&state.lookups) > 0, "readers", "no lookups");
+  ok &= check(atomic_load(&state.unpublished) == 0, "readers", "saw an unpublished batch");
+  ok &= check(atomic_load(&state.backwards) == 0, "readers", "a generation went backwards");
+  ok &= check(atomic_load(&state.torn) == 0, "readers", "saw a binding mixing two generations");
+  ok &= check(atomic_load(&state.missing) == 0, "readers", "a binding was missing or in the wrong state");
+  if (ok) printf("ok   readers (%u batches, %lu lookups by %u readers)\n", BATCH_COUNT, atomic_load(&state.lookups), READER_COUNT);
+
+  /* an update that cannot be applied fails its batch, and only that one */
+  memset(&msg, 0, sizeof(msg));
+  msg.id = DCWMSG_STA_JOIN;
+  msg.sta_join.data_macaddr_count = DCWMSG_MAX_ENTRIES + 1;
+  ok &= check(!dcwsta_shared_apply(state.shared, primary_macaddr, &msg), "failed update", "invalid message was applied");
+  ok &= check(!dcwsta_shared_publish(state.shared), "failed update", "publish did not report it");
+  make_ack(&msg, primary_macaddr, 0, MAC_COUNT, BATCH_COUNT + 1);
+  ok &= check(dcwsta_shared_apply(state.shared, primary_macaddr, &msg), "failed update", "dcwsta_shared_apply");
+  ok &= check(dcwsta_shared_publish(state.shared), "failed update", "next publish still failed");
+  ok &= check(check_published(&state, BATCH_COUNT + 1), "failed update", "next batch not visible");
+  if (ok) printf("ok   failed update\n");
+
+  dcwsta_shared_destroy(state.shared);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1 @@
+../src/dcwdispatch.h
\ No newline at end of file
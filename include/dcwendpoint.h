@@ -0,0 +1 @@
+../src/dcwendpoint.h
\ No newline at end of file
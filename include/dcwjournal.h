@@ -0,0 +1 @@
+../src/dcwjournal.h
\ No newline at end of file
@@ -0,0 +1 @@
+../src/dcwproto.hpp
\ No newline at end of file
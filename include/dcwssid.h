@@ -0,0 +1 @@
+../src/dcwssid.h
\ No newline at end of file
@@ -0,0 +1 @@
+../src/dcwsta.h
\ No newline at end of file
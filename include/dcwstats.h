@@ -0,0 +1 @@
+../src/dcwstats.h
\ No newline at end of file
@@ -0,0 +1 @@
+../src/dcwstream.h
\ No newline at end of file
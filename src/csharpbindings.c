@@ -28,13 +28,25 @@
 
 int WIN32_EXPORT
 dcwprotocs_read_msgtype(const unsigned char * const buf, const unsigned buflen) {
-	struct dcwmsg msg;
+	enum dcwmsg_id id;
 
-	if (!dcwmsg_marshal(&msg, buf, buflen)) {
-		return -1; /* marshal failed */
+	/* validate only; no need to decode the whole message for its id */
+	if (!dcwmsg_peek(buf, buflen, &id, NULL, NULL)) {
+		return -1; /* peek failed */
+	}
+
+	return (int)id;
+}
+
+int WIN32_EXPORT
+dcwprotocs_peek(const unsigned char * const buf, const unsigned buflen, unsigned * const count, unsigned * const length) {
+	enum dcwmsg_id id;
+
+	if (!dcwmsg_peek(buf, buflen, &id, count, length)) {
+		return -1; /* peek failed */
 	}
 
-	return (int)msg.id;
+	return (int)id;
 }
 
 unsigned WIN32_EXPORT
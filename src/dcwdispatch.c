@@ -0,0 +1,418 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef WIN32
+
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwdispatch.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_SHARDS_PER_WORKER  4
+#define DEFAULT_SHARD_DEPTH        64
+#define RUN_BATCH                  16 /* messages handled per turn on a shard */
+
+
+
+/*
+
+  Dispatch structures...
+  Each shard is a bounded FIFO of raw messages with its own lock. A shard is
+  IDLE (empty, in no ready queue), READY (non-empty, in exactly one worker's
+  ready queue) or RUNNING (owned by one worker). Only the IDLE -> READY
+  transition and ready queue operations take the dispatch-wide lock, so a
+  busy shard can be fed without touching it.
+
+*/
+enum shard_state {
+  SHARD_IDLE,
+  SHARD_READY,
+  SHARD_RUNNING,
+};
+
+struct dispatch_entry {
+  unsigned short  len;
+  unsigned short  sender_len;
+  unsigned char   buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned char   sender[DCWDISPATCH_MAX_SENDER];
+};
+
+struct dispatch_shard {
+  pthread_mutex_t         lock;
+  enum shard_state        state;
+  unsigned                head;
+  unsigned                count;
+  unsigned                home;     /* worker whose ready queue it is put on */
+  struct dispatch_entry  *entries;
+};
+
+/* ring of shard indexes; every shard is in at most one, so shard_count slots suffice */
+struct ready_queue {
+  unsigned   *slots;
+  unsigned    head;
+  unsigned    count;
+};
+
+struct dispatch_worker {
+  struct dcwdispatch     *dispatch;
+  pthread_t               thread;
+  int                     started;
+  struct ready_queue      ready;
+  struct dcwmsg           msgs[RUN_BATCH];
+};
+
+struct dcwdispatch {
+  pthread_mutex_t          lock;        /* ready queues and "stopping" */
+  pthread_cond_t           work_cond;
+  pthread_cond_t           drain_cond;
+  int                      stopping;
+  atomic_ulong             pending;     /* submitted but not yet handled */
+  atomic_ulong             dropped;
+
+  dcwdispatch_handler      handler;
+  void                    *ctx;
+  unsigned                 flags;
+
+  unsigned                 shard_count;
+  unsigned                 shard_depth;
+  struct dispatch_shard   *shards;
+
+  unsigned                 worker_count;
+  struct dispatch_worker  *workers;
+};
+
+
+
+/*
+
+  Ready queue functions begin here...
+  Callers hold dispatch->lock. Owners take from the head; thieves take from
+  the tail, so a steal grabs the shard its owner would reach last.
+
+*/
+static void
+ready_push(struct dcwdispatch * const dispatch, struct ready_queue * const ready, const unsigned shard) {
+  ready->slots[(ready->head + ready->count) % dispatch->shard_count] = shard;
+  ready->count++;
+}
+
+static int
+ready_pop_head(struct dcwdispatch * const dispatch, struct ready_queue * const ready, unsigned * const shard) {
+  if (ready->count == 0) return 0;
+  (*shard) = ready->slots[ready->head];
+  ready->head = (ready->head + 1) % dispatch->shard_count;
+  ready->count--;
+  return 1;
+}
+
+static int
+ready_pop_tail(struct dcwdispatch * const dispatch, struct ready_queue * const ready, unsigned * const shard) {
+  if (ready->count == 0) return 0;
+  ready->count--;
+  (*shard) = ready->slots[(ready->head + ready->count) % dispatch->shard_count];
+  return 1;
+}
+
+/* own queue first, then steal; caller holds dispatch->lock */
+static int
+next_shard(struct dcwdispatch * const dispatch, const unsigned worker_id, unsigned * const shard) {
+  unsigned i;
+
+  if (ready_pop_head(dispatch, &dispatch->workers[worker_id].ready, shard)) return 1;
+  for (i = 1; i < dispatch->worker_count; i++) {
+    if (ready_pop_tail(dispatch, &dispatch->workers[(worker_id + i) % dispatch->worker_count].ready, shard)) return 1;
+  }
+  return 0;
+}
+
+static void
+schedule_shard(struct dcwdispatch * const dispatch, const unsigned worker_id, const unsigned shard) {
+  pthread_mutex_lock(&dispatch->lock);
+  ready_push(dispatch, &dispatch->workers[worker_id].ready, shard);
+  pthread_cond_signal(&dispatch->work_cond);
+  pthread_mutex_unlock(&dispatch->lock);
+}
+
+
+
+/*
+
+  Worker functions begin here...
+
+*/
+static void
+run_shard(struct dispatch_worker * const worker, const unsigned worker_id, const unsigned shard_index) {
+  struct dcwdispatch * const dispatch = worker->dispatch;
+  struct dispatch_shard * const shard = &dispatch->shards[shard_index];
+  const unsigned char *bufs[RUN_BATCH];
+  unsigned buf_lens[RUN_BATCH];
+  int results[RUN_BATCH];
+  const struct dispatch_entry *entry;
+  unsigned first;
+  unsigned count;
+  unsigned i;
+  int requeue;
+
+  pthread_mutex_lock(&shard->lock);
+  shard->state = SHARD_RUNNING;
+  first = shard->head;
+  count = (shard->count < RUN_BATCH) ? shard->count : RUN_BATCH;
+  pthread_mutex_unlock(&shard->lock);
+
+  /* the submitter only writes past head + count, so these entries are ours until released */
+  for (i = 0; i < count; i++) {
+    entry       = &shard->entries[(first + i) % dispatch->shard_depth];
+    bufs[i]     = entry->buf;
+    buf_lens[i] = entry->len;
+  }
+  dcwmsg_marshal_batch(worker->msgs, bufs, buf_lens, results, count);
+
+  for (i = 0; i < count; i++) {
+    if (!results[i]) {
+      atomic_fetch_add(&dispatch->dropped, 1);
+      continue;
+    }
+    entry = &shard->entries[(first + i) % dispatch->shard_depth];
+    dispatch->handler(&worker->msgs[i], entry->sender, entry->sender_len, dispatch->ctx);
+  }
+
+  pthread_mutex_lock(&shard->lock);
+  shard->head   = (shard->head + count) % dispatch->shard_depth;
+  shard->count -= count;
+  requeue       = (shard->count > 0);
+  shard->state  = requeue ? SHARD_READY : SHARD_IDLE;
+  pthread_mutex_unlock(&shard->lock);
+
+  /* back of our own queue, so other shards get a turn */
+  if (requeue) schedule_shard(dispatch, worker_id, shard_index);
+
+  if (atomic_fetch_sub(&dispatch->pending, count) == count) {
+    pthread_mutex_lock(&dispatch->lock);
+    pthread_cond_broadcast(&dispatch->drain_cond);
+    pthread_mutex_unlock(&dispatch->lock);
+  }
+}
+
+static void *
+worker_main(void *arg) {
+  struct dispatch_worker * const worker = arg;
+  struct dcwdispatch * const dispatch = worker->dispatch;
+  const unsigned worker_id = (unsigned)(worker - dispatch->workers);
+  unsigned shard;
+
+  for (;;) {
+    pthread_mutex_lock(&dispatch->lock);
+    while (!next_shard(dispatch, worker_id, &shard)) {
+      if (dispatch->stopping) {
+        pthread_mutex_unlock(&dispatch->lock);
+        return NULL;
+      }
+      pthread_cond_wait(&dispatch->work_cond, &dispatch->lock);
+    }
+    pthread_mutex_unlock(&dispatch->lock);
+
+    run_shard(worker, worker_id, shard);
+  }
+}
+
+
+
+/*
+
+  Dispatch functions begin here...
+
+*/
+struct dcwdispatch *
+dcwdispatch_create(const unsigned worker_count, const unsigned shard_count, const unsigned shard_depth, const unsigned flags, dcwdispatch_handler handler, void * const ctx) {
+  struct dcwdispatch *dispatch;
+  unsigned i;
+
+  if ((worker_count == 0) || (handler == NULL)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  dispatch = calloc(1, sizeof(*dispatch));
+  if (dispatch == NULL) return NULL;
+
+  dispatch->handler      = handler;
+  dispatch->ctx          = ctx;
+  dispatch->flags        = flags;
+  dispatch->worker_count = worker_count;
+  dispatch->shard_count  = (shard_count == 0) ? (worker_count * DEFAULT_SHARDS_PER_WORKER) : shard_count;
+  dispatch->shard_depth  = (shard_depth == 0) ? DEFAULT_SHARD_DEPTH : shard_depth;
+  atomic_init(&dispatch->pending, 0);
+  atomic_init(&dispatch->dropped, 0);
+  pthread_mutex_init(&dispatch->lock, NULL);
+  pthread_cond_init(&dispatch->work_cond, NULL);
+  pthread_cond_init(&dispatch->drain_cond, NULL);
+
+  dispatch->shards  = calloc(dispatch->shard_count, sizeof(*dispatch->shards));
+  dispatch->workers = calloc(dispatch->worker_count, sizeof(*dispatch->workers));
+  if ((dispatch->shards == NULL) || (dispatch->workers == NULL)) goto fail;
+
+  for (i = 0; i < dispatch->shard_count; i++) {
+    pthread_mutex_init(&dispatch->shards[i].lock, NULL);
+    dispatch->shards[i].state   = SHARD_IDLE;
+    dispatch->shards[i].home    = i % dispatch->worker_count;
+    dispatch->shards[i].entries = malloc(sizeof(struct dispatch_entry) * dispatch->shard_depth);
+    if (dispatch->shards[i].entries == NULL) goto fail;
+  }
+  for (i = 0; i < dispatch->worker_count; i++) {
+    dispatch->workers[i].dispatch    = dispatch;
+    dispatch->workers[i].ready.slots = malloc(sizeof(unsigned) * dispatch->shard_count);
+    if (dispatch->workers[i].ready.slots == NULL) goto fail;
+  }
+  for (i = 0; i < dispatch->worker_count; i++) {
+    if (pthread_create(&dispatch->workers[i].thread, NULL, worker_main, &dispatch->workers[i]) != 0) goto fail;
+    dispatch->workers[i].started = 1;
+  }
+
+  return dispatch;
+
+fail:
+  dcwdispatch_destroy(dispatch);
+  errno = ENOMEM;
+  return NULL;
+}
+
+void
+dcwdispatch_destroy(struct dcwdispatch * const dispatch) {
+  unsigned i;
+
+  if (dispatch == NULL) return;
+
+  if (dispatch->workers != NULL) {
+    dcwdispatch_drain(dispatch);
+
+    pthread_mutex_lock(&dispatch->lock);
+    dispatch->stopping = 1;
+    pthread_cond_broadcast(&dispatch->work_cond);
+    pthread_mutex_unlock(&dispatch->lock);
+
+    for (i = 0; i < dispatch->worker_count; i++) {
+      if (dispatch->workers[i].started) pthread_join(dispatch->workers[i].thread, NULL);
+      free(dispatch->workers[i].ready.slots);
+    }
+    free(dispatch->workers);
+  }
+
+  if (dispatch->shards != NULL) {
+    for (i = 0; i < dispatch->shard_count; i++) {
+      pthread_mutex_destroy(&dispatch->shards[i].lock);
+      free(dispatch->shards[i].entries);
+    }
+    free(dispatch->shards);
+  }
+
+  pthread_cond_destroy(&dispatch->drain_cond);
+  pthread_cond_destroy(&dispatch->work_cond);
+  pthread_mutex_destroy(&dispatch->lock);
+  free(dispatch);
+}
+
+static unsigned
+key_hash(const unsigned char * const key, const unsigned key_len) {
+  unsigned h;
+  unsigned i;
+
+  /* FNV-1a */
+  h = 2166136261u;
+  for (i = 0; i < key_len; i++) {
+    h ^= key[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+int
+dcwdispatch_submit(struct dcwdispatch * const dispatch, const unsigned char * const buf, const unsigned buf_len, const void * const sender, const unsigned sender_len) {
+  struct dcwmsg_view view;
+  struct dispatch_shard *shard;
+  struct dispatch_entry *entry;
+  const unsigned char *key;
+  unsigned key_len;
+  unsigned shard_index;
+  int schedule;
+
+  if (sender_len > DCWDISPATCH_MAX_SENDER) {
+    errno = EINVAL;
+    return 0;
+  }
+  if (!dcwmsg_view_init(&view, buf, buf_len)) {
+    atomic_fetch_add(&dispatch->dropped, 1);
+    errno = EINVAL;
+    return 0;
+  }
+
+  /* STA_ACK entries also start with the data MAC */
+  key     = sender;
+  key_len = sender_len;
+  if ((dispatch->flags & DCWDISPATCH_KEY_MACADDR) && (view.count > 0) && (view.id != DCWMSG_AP_ACCEPT_STA)) {
+    key     = view.entries;
+    key_len = sizeof(dcwmsg_macaddr_t);
+  }
+  shard_index = key_hash(key, key_len) % dispatch->shard_count;
+  shard       = &dispatch->shards[shard_index];
+
+  pthread_mutex_lock(&shard->lock);
+  if (shard->count == dispatch->shard_depth) {
+    pthread_mutex_unlock(&shard->lock);
+    errno = EAGAIN;
+    return 0;
+  }
+  entry = &shard->entries[(shard->head + shard->count) % dispatch->shard_depth];
+  entry->len        = (unsigned short)view.length; /* trailing bytes are not needed */
+  entry->sender_len = (unsigned short)sender_len;
+  memcpy(entry->buf, buf, view.length);
+  if (sender_len > 0) memcpy(entry->sender, sender, sender_len);
+  shard->count++;
+  atomic_fetch_add(&dispatch->pending, 1);
+  schedule = (shard->state == SHARD_IDLE);
+  if (schedule) shard->state = SHARD_READY;
+  pthread_mutex_unlock(&shard->lock);
+
+  if (schedule) schedule_shard(dispatch, shard->home, shard_index);
+  return 1;
+}
+
+void
+dcwdispatch_drain(struct dcwdispatch * const dispatch) {
+  pthread_mutex_lock(&dispatch->lock);
+  while (atomic_load(&dispatch->pending) > 0) pthread_cond_wait(&dispatch->drain_cond, &dispatch->lock);
+  pthread_mutex_unlock(&dispatch->lock);
+}
+
+unsigned long
+dcwdispatch_dropped(struct dcwdispatch * const dispatch) {
+  return atomic_load(&dispatch->dropped);
+}
+
+
+#endif /* #ifndef WIN32 */
+
@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWDISPATCH_H_INCLUDED
+#define DCWDISPATCH_H_INCLUDED
+
+#include <dcwproto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef WIN32
+/*
+  Sharded multi-core dispatch...
+  Raw messages are submitted from one thread, hashed to a shard by a key and
+  marshaled + handled on a pool of worker threads. A shard is only ever run
+  by one worker at a time, so messages with the same key are handled in
+  submission order; different shards run in parallel. Each worker owns a
+  queue of ready shards, and idle workers steal ready shards from the others.
+  Part of libdcwproto-mt.
+
+  By default the key is the sender address: everything from one peer (and so
+  every message about the stations behind it) is handled in submission order.
+  With DCWDISPATCH_KEY_MACADDR the key is the first data MAC address of the
+  message instead, which spreads one busy peer over several workers. Then
+  only messages with the same first MAC address stay in order. Messages that
+  carry no MAC (AP_ACCEPT_STA, AP_ACK_DISCONNECT, AP_QUIT, empty lists) still
+  use the sender key. They can therefore overtake, or be overtaken by,
+  earlier messages for the same station.
+*/
+#define DCWDISPATCH_MAX_SENDER  128 /* bytes; fits a struct sockaddr_storage */
+
+/* dcwdispatch_create() flags */
+#define DCWDISPATCH_KEY_SENDER   0x00 /* the default */
+#define DCWDISPATCH_KEY_MACADDR  0x02
+
+struct dcwdispatch;
+
+/* called on a worker thread; "msg" and "sender" are only valid for the call */
+typedef void (*dcwdispatch_handler)(const struct dcwmsg * /* msg */, const void * /* sender */, unsigned /* sender_len */, void * /* ctx */);
+
+/*
+  Starts "worker_count" threads. shard_count and shard_depth (messages queued
+  per shard) may be 0 for defaults of 4 shards per worker and 64 messages.
+*/
+struct dcwdispatch * dcwdispatch_create(const unsigned /* worker_count */, const unsigned /* shard_count */, const unsigned /* shard_depth */, const unsigned /* flags */, dcwdispatch_handler /* handler */, void * const /* ctx */);
+
+/* handles everything already submitted, then stops the workers */
+void dcwdispatch_destroy(struct dcwdispatch * const /* dispatch */);
+
+/*
+  Queues one message. Returns 1 on success; 0 with errno EINVAL if the
+  message is malformed (it is counted as dropped) or the sender is too long,
+  or EAGAIN if the station's shard is full.
+*/
+int dcwdispatch_submit(struct dcwdispatch * const /* dispatch */, const unsigned char * const /* buf */, const unsigned /* buf_len */, const void * const /* sender */, const unsigned /* sender_len */);
+
+/* blocks until every submitted message has been handled */
+void dcwdispatch_drain(struct dcwdispatch * const /* dispatch */);
+
+unsigned long dcwdispatch_dropped(struct dcwdispatch * const /* dispatch */);
+#endif
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWDISPATCH_H_INCLUDED */
@@ -0,0 +1,630 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* recvmmsg() / sendmmsg() */
+#endif
+#include <config.h>
+#include <dcwendpoint.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+/* timed waits need IORING_ENTER_EXT_ARG (5.11+); older headers get epoll only */
+#if defined(IORING_FEAT_EXT_ARG) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define USE_IO_URING
+#endif
+#endif
+
+#define DGRAM_BUF_SIZE 2048 /* room for a container frame filling a 1500 byte MTU */
+
+
+
+#ifdef USE_IO_URING
+/*
+
+  Minimal io_uring functions begin here...
+  Raw syscalls and the mmap'd rings; nothing beyond what the receive loop
+  needs, so there is no liburing dependency.
+
+*/
+struct uring {
+  int                   fd;
+  void                 *sq_ring;
+  size_t                sq_ring_len;
+  void                 *cq_ring;
+  size_t                cq_ring_len;
+  struct io_uring_sqe  *sqes;
+  size_t                sqes_len;
+  unsigned             *sq_head;
+  unsigned             *sq_tail;
+  unsigned             *sq_mask;
+  unsigned             *sq_array;
+  unsigned             *cq_head;
+  unsigned             *cq_tail;
+  unsigned             *cq_mask;
+  struct io_uring_cqe  *cqes;
+  unsigned              to_submit;
+};
+
+static void
+uring_destroy(struct uring * const ring) {
+  if (ring->sqes != NULL) munmap(ring->sqes, ring->sqes_len);
+  if ((ring->cq_ring != NULL) && (ring->cq_ring != ring->sq_ring)) munmap(ring->cq_ring, ring->cq_ring_len);
+  if (ring->sq_ring != NULL) munmap(ring->sq_ring, ring->sq_ring_len);
+  if (ring->fd != -1) close(ring->fd);
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+static int
+uring_init(struct uring * const ring, const unsigned entries) {
+  struct io_uring_params params;
+  void *ptr;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd == -1) return 0;
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    uring_destroy(ring);
+    return 0;
+  }
+
+  ring->sq_ring_len = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+  ring->cq_ring_len = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_len > ring->sq_ring_len) ring->sq_ring_len = ring->cq_ring_len;
+    ring->cq_ring_len = ring->sq_ring_len;
+  }
+
+  ptr = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ptr == MAP_FAILED) goto fail;
+  ring->sq_ring = ptr;
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ptr = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ptr == MAP_FAILED) goto fail;
+    ring->cq_ring = ptr;
+  }
+
+  ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  ptr = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ptr == MAP_FAILED) goto fail;
+  ring->sqes = ptr;
+
+  ring->sq_head  = (unsigned *)((char *)ring->sq_ring + params.sq_off.head);
+  ring->sq_tail  = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+  ring->sq_mask  = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+  ring->cq_head  = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+  ring->cq_tail  = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+  ring->cq_mask  = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+  ring->cqes     = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+  return 1;
+
+fail:
+  uring_destroy(ring);
+  return 0;
+}
+
+/* queues a recvmsg(); the ring always has room since entries == batch */
+static void
+uring_queue_recvmsg(struct uring * const ring, const int fd, struct msghdr * const hdr, const unsigned slot) {
+  struct io_uring_sqe *sqe;
+  unsigned tail;
+  unsigned index;
+
+  tail  = *ring->sq_tail;
+  index = tail & *ring->sq_mask;
+  sqe   = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode    = IORING_OP_RECVMSG;
+  sqe->fd        = fd;
+  sqe->addr      = (unsigned long)hdr;
+  sqe->len       = 1;
+  sqe->user_data = slot;
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->to_submit++;
+}
+
+/* submits anything queued and, if timeout_ms != 0, waits for a completion */
+static int
+uring_enter(struct uring * const ring, const int timeout_ms) {
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  unsigned flags;
+  unsigned wait_nr;
+  int rv;
+
+  flags   = IORING_ENTER_EXT_ARG;
+  wait_nr = 0;
+  memset(&arg, 0, sizeof(arg));
+  if (timeout_ms != 0) {
+    flags  |= IORING_ENTER_GETEVENTS;
+    wait_nr = 1;
+    if (timeout_ms > 0) {
+      ts.tv_sec  = timeout_ms / 1000;
+      ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+      arg.ts     = (unsigned long)&ts;
+    }
+  }
+
+  rv = (int)syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait_nr, flags, &arg, sizeof(arg));
+  if (rv == -1) {
+    if (errno == ETIME) return 0; /* timed out */
+    return -1;
+  }
+  ring->to_submit -= (unsigned)rv;
+  return 0;
+}
+#endif /* #ifdef USE_IO_URING */
+
+
+
+/*
+
+  Endpoint functions begin here...
+  Every receive and send slot has a DGRAM_BUF_SIZE buffer, all carved out
+  of one allocation at open time (a dcwmsg_pool buffer is too small for a
+  full container frame). Messages are parsed into structs from the
+  endpoint's dcwmsg_pool: one per receive slot plus one for the messages
+  unpacked from container frames, all taken at open time.
+
+*/
+struct handler_entry {
+  dcwendpoint_handler   handler;
+  void                 *ctx;
+};
+
+struct dcwendpoint {
+  int                       fd;
+  enum dcwendpoint_backend  backend;
+  unsigned                  batch;
+  unsigned long             dropped;
+  unsigned char            *buf_mem;  /* batch receive buffers, then batch send buffers */
+  struct dcwmsg_pool       *msg_pool;
+  struct handler_entry      handlers[256]; /* indexed by message id */
+  struct dcwmsg            *container_msg; /* one message out of a container frame */
+
+  /* receive side; one slot per in-flight datagram */
+  struct mmsghdr           *rx_hdrs;
+  struct iovec             *rx_iovs;
+  struct sockaddr_storage  *rx_addrs;
+  struct dcwmsg           **rx_msgs;
+  const unsigned char     **rx_bufs;
+  unsigned                 *rx_lens;
+  unsigned                 *rx_slots;
+
+  /* send queue */
+  struct mmsghdr           *tx_hdrs;
+  struct iovec             *tx_iovs;
+  struct sockaddr_storage  *tx_addrs;
+  unsigned                  tx_head;  /* first entry not yet sent */
+  unsigned                  tx_count;
+
+  int                       epoll_fd;
+#ifdef USE_IO_URING
+  struct uring              ring;
+#endif
+};
+
+static void
+rx_slot_reset(struct dcwendpoint * const ep, const unsigned slot) {
+  ep->rx_iovs[slot].iov_len             = DGRAM_BUF_SIZE;
+  ep->rx_hdrs[slot].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+  ep->rx_hdrs[slot].msg_hdr.msg_flags   = 0;
+}
+
+static int
+endpoint_alloc(struct dcwendpoint * const ep) {
+  unsigned i;
+
+  ep->buf_mem    = malloc((size_t)ep->batch * 2 * DGRAM_BUF_SIZE);
+  ep->msg_pool   = dcwmsg_pool_create(ep->batch + 1, 0);
+  ep->rx_hdrs    = calloc(ep->batch, sizeof(*ep->rx_hdrs));
+  ep->rx_iovs    = calloc(ep->batch, sizeof(*ep->rx_iovs));
+  ep->rx_addrs   = calloc(ep->batch, sizeof(*ep->rx_addrs));
+  ep->rx_msgs    = calloc(ep->batch, sizeof(*ep->rx_msgs));
+  ep->rx_bufs    = calloc(ep->batch, sizeof(*ep->rx_bufs));
+  ep->rx_lens    = calloc(ep->batch, sizeof(*ep->rx_lens));
+  ep->rx_slots   = calloc(ep->batch, sizeof(*ep->rx_slots));
+  ep->tx_hdrs    = calloc(ep->batch, sizeof(*ep->tx_hdrs));
+  ep->tx_iovs    = calloc(ep->batch, sizeof(*ep->tx_iovs));
+  ep->tx_addrs   = calloc(ep->batch, sizeof(*ep->tx_addrs));
+  if ((ep->buf_mem == NULL) || (ep->msg_pool == NULL) || (ep->rx_hdrs == NULL) || (ep->rx_iovs == NULL) || (ep->rx_addrs == NULL) ||
+      (ep->rx_msgs == NULL) || (ep->rx_bufs == NULL) || (ep->rx_lens == NULL) ||
+      (ep->rx_slots == NULL) || (ep->tx_hdrs == NULL) || (ep->tx_iovs == NULL) || (ep->tx_addrs == NULL)) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  ep->container_msg = dcwmsg_pool_get_msg(ep->msg_pool);
+  for (i = 0; i < ep->batch; i++) {
+    ep->rx_msgs[i]                    = dcwmsg_pool_get_msg(ep->msg_pool);
+    ep->rx_iovs[i].iov_base           = ep->buf_mem + ((size_t)i * DGRAM_BUF_SIZE);
+    ep->rx_hdrs[i].msg_hdr.msg_iov    = &ep->rx_iovs[i];
+    ep->rx_hdrs[i].msg_hdr.msg_iovlen = 1;
+    ep->rx_hdrs[i].msg_hdr.msg_name   = &ep->rx_addrs[i];
+    rx_slot_reset(ep, i);
+
+    ep->tx_iovs[i].iov_base           = ep->buf_mem + ((size_t)(ep->batch + i) * DGRAM_BUF_SIZE);
+    ep->tx_hdrs[i].msg_hdr.msg_iov    = &ep->tx_iovs[i];
+    ep->tx_hdrs[i].msg_hdr.msg_iovlen = 1;
+    ep->tx_hdrs[i].msg_hdr.msg_name   = &ep->tx_addrs[i];
+  }
+  return 1;
+}
+
+struct dcwendpoint *
+dcwendpoint_open(const struct sockaddr * const bind_addr, const socklen_t bind_addr_len, const unsigned batch, const unsigned flags) {
+  struct dcwendpoint *ep;
+  struct epoll_event ev;
+  unsigned i;
+
+  if ((bind_addr == NULL) || (bind_addr_len > sizeof(struct sockaddr_storage))) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ep = calloc(1, sizeof(*ep));
+  if (ep == NULL) return NULL;
+  ep->fd       = -1;
+  ep->epoll_fd = -1;
+  ep->batch    = (batch == 0) ? DCWENDPOINT_DEFAULT_BATCH : batch;
+#ifdef USE_IO_URING
+  ep->ring.fd  = -1;
+#endif
+
+  if (!endpoint_alloc(ep)) goto fail;
+
+  ep->fd = socket(bind_addr->sa_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (ep->fd == -1) goto fail;
+  if (bind(ep->fd, bind_addr, bind_addr_len) == -1) goto fail;
+
+#ifdef USE_IO_URING
+  if ((flags & DCWENDPOINT_IO_URING_RECV) && !(flags & DCWENDPOINT_NO_IO_URING) && uring_init(&ep->ring, ep->batch)) {
+    ep->backend = DCWENDPOINT_IO_URING;
+    for (i = 0; i < ep->batch; i++) uring_queue_recvmsg(&ep->ring, ep->fd, &ep->rx_hdrs[i].msg_hdr, i);
+    if (uring_enter(&ep->ring, 0) == -1) goto fail;
+    return ep;
+  }
+#else
+  (void)flags;
+  (void)i;
+#endif
+
+  ep->backend  = DCWENDPOINT_EPOLL;
+  ep->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (ep->epoll_fd == -1) goto fail;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  if (epoll_ctl(ep->epoll_fd, EPOLL_CTL_ADD, ep->fd, &ev) == -1) goto fail;
+  return ep;
+
+fail:
+  dcwendpoint_close(ep);
+  return NULL;
+}
+
+void
+dcwendpoint_close(struct dcwendpoint * const ep) {
+  int saved_errno;
+
+  if (ep == NULL) return;
+  saved_errno = errno;
+
+#ifdef USE_IO_URING
+  /* closing the ring first cancels any receives still pointing at our buffers */
+  if (ep->ring.fd != -1) uring_destroy(&ep->ring);
+#endif
+  if (ep->epoll_fd != -1) close(ep->epoll_fd);
+  if (ep->fd != -1) close(ep->fd);
+
+  free(ep->buf_mem);
+  dcwmsg_pool_destroy(ep->msg_pool);
+  free(ep->rx_hdrs);
+  free(ep->rx_iovs);
+  free(ep->rx_addrs);
+  free(ep->rx_msgs);
+  free(ep->rx_bufs);
+  free(ep->rx_lens);
+  free(ep->rx_slots);
+  free(ep->tx_hdrs);
+  free(ep->tx_iovs);
+  free(ep->tx_addrs);
+  free(ep);
+
+  errno = saved_errno;
+}
+
+int
+dcwendpoint_fd(const struct dcwendpoint * const ep) {
+  return ep->fd;
+}
+
+enum dcwendpoint_backend
+dcwendpoint_backend(const struct dcwendpoint * const ep) {
+  return ep->backend;
+}
+
+unsigned long
+dcwendpoint_dropped(const struct dcwendpoint * const ep) {
+  return ep->dropped;
+}
+
+void
+dcwendpoint_set_handler(struct dcwendpoint * const ep, const enum dcwmsg_id id, dcwendpoint_handler handler, void * const ctx) {
+  ep->handlers[(unsigned char)id].handler = handler;
+  ep->handlers[(unsigned char)id].ctx     = ctx;
+}
+
+
+
+/*
+
+  Receive path functions begin here...
+
+*/
+static void
+deliver(struct dcwendpoint * const ep, const struct dcwmsg * const msg, const struct msghdr * const hdr) {
+  const struct handler_entry * const entry = &ep->handlers[(unsigned char)msg->id];
+
+  if (entry->handler == NULL) return;
+  entry->handler(ep, msg, (const struct sockaddr *)hdr->msg_name, hdr->msg_namelen, entry->ctx);
+}
+
+/* a container frame counts as one dropped datagram if its framing is bad */
+static void
+dispatch_container(struct dcwendpoint * const ep, const unsigned char * const buf, const unsigned buf_len, const struct msghdr * const hdr) {
+  struct dcwmsg_container_iter iter;
+  const unsigned char *msg;
+  unsigned msg_len;
+
+  if ((hdr->msg_flags & MSG_TRUNC) || !dcwmsg_container_iter_init(&iter, buf, buf_len)) {
+    ep->dropped++;
+    return;
+  }
+  while (dcwmsg_container_iter_next(&iter, &msg, &msg_len)) {
+    if (!dcwmsg_marshal(ep->container_msg, msg, msg_len)) {
+      ep->dropped++;
+      continue;
+    }
+    deliver(ep, ep->container_msg, hdr);
+  }
+}
+
+static void
+dispatch(struct dcwendpoint * const ep, const unsigned count) {
+  const struct msghdr *hdr;
+  unsigned i;
+
+  for (i = 0; i < count; i++) {
+    hdr = &ep->rx_hdrs[ep->rx_slots[i]].msg_hdr;
+    if (dcwmsg_marshal(ep->rx_msgs[i], ep->rx_bufs[i], ep->rx_lens[i])) {
+      deliver(ep, ep->rx_msgs[i], hdr);
+      continue;
+    }
+    if ((ep->rx_lens[i] > 0) && (ep->rx_bufs[i][0] == DCWMSG_CONTAINER)) {
+      dispatch_container(ep, ep->rx_bufs[i], ep->rx_lens[i], hdr);
+      continue;
+    }
+    ep->dropped++;
+  }
+}
+
+static int
+poll_epoll(struct dcwendpoint * const ep, const int timeout_ms) {
+  struct epoll_event ev;
+  unsigned i;
+  int rv;
+
+  rv = epoll_wait(ep->epoll_fd, &ev, 1, timeout_ms);
+  if (rv <= 0) return rv;
+
+  for (i = 0; i < ep->batch; i++) rx_slot_reset(ep, i);
+  rv = recvmmsg(ep->fd, ep->rx_hdrs, ep->batch, MSG_DONTWAIT, NULL);
+  if (rv == -1) return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+
+  for (i = 0; i < (unsigned)rv; i++) {
+    ep->rx_bufs[i]  = ep->rx_iovs[i].iov_base;
+    ep->rx_lens[i]  = ep->rx_hdrs[i].msg_len;
+    ep->rx_slots[i] = i;
+  }
+  dispatch(ep, (unsigned)rv);
+  return rv;
+}
+
+#ifdef USE_IO_URING
+static int
+poll_uring(struct dcwendpoint * const ep, const int timeout_ms) {
+  struct uring * const ring = &ep->ring;
+  const struct io_uring_cqe *cqe;
+  unsigned head;
+  unsigned tail;
+  unsigned count;
+  unsigned slot;
+  unsigned i;
+
+  head = *ring->cq_head;
+  tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  if (head == tail) {
+    if (uring_enter(ring, timeout_ms) == -1) return -1;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+  }
+
+  count = 0;
+  for (; head != tail; head++) {
+    cqe  = &ring->cqes[head & *ring->cq_mask];
+    slot = (unsigned)cqe->user_data;
+    if (cqe->res < 0) {
+      /* receive error (e.g. ICMP unreachable); just re-arm the slot */
+      rx_slot_reset(ep, slot);
+      uring_queue_recvmsg(ring, ep->fd, &ep->rx_hdrs[slot].msg_hdr, slot);
+      continue;
+    }
+    ep->rx_bufs[count]  = ep->rx_iovs[slot].iov_base;
+    ep->rx_lens[count]  = (unsigned)cqe->res;
+    ep->rx_slots[count] = slot;
+    count++;
+  }
+  __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+  dispatch(ep, count);
+
+  /* the buffers are free again once the handlers have returned */
+  for (i = 0; i < count; i++) {
+    slot = ep->rx_slots[i];
+    rx_slot_reset(ep, slot);
+    uring_queue_recvmsg(ring, ep->fd, &ep->rx_hdrs[slot].msg_hdr, slot);
+  }
+  if ((ring->to_submit > 0) && (uring_enter(ring, 0) == -1)) return -1;
+
+  return (int)count;
+}
+#endif
+
+int
+dcwendpoint_poll(struct dcwendpoint * const ep, const int timeout_ms) {
+#ifdef USE_IO_URING
+  if (ep->backend == DCWENDPOINT_IO_URING) return poll_uring(ep, timeout_ms);
+#endif
+  return poll_epoll(ep, timeout_ms);
+}
+
+
+
+/*
+
+  Send queue functions begin here...
+
+*/
+/* makes room for one more datagram; returns 0 or -1 with errno set */
+static int
+tx_reserve(struct dcwendpoint * const ep) {
+  if (ep->tx_count == ep->batch) {
+    if (dcwendpoint_flush(ep) == -1) return -1;
+    if (ep->tx_count == ep->batch) {
+      errno = EAGAIN; /* the socket is still backed up */
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int
+dcwendpoint_send(struct dcwendpoint * const ep, const struct dcwmsg * const msg, const struct sockaddr * const to, const socklen_t to_len) {
+  struct msghdr *hdr;
+  unsigned size;
+
+  if (to_len > sizeof(struct sockaddr_storage)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (tx_reserve(ep) == -1) return -1;
+
+  hdr  = &ep->tx_hdrs[ep->tx_count].msg_hdr;
+  size = dcwmsg_serialize(hdr->msg_iov[0].iov_base, msg, DCWMSG_MAX_SERIALIZED_SIZE);
+  if (size == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  hdr->msg_iov[0].iov_len = size;
+  memcpy(hdr->msg_name, to, to_len);
+  hdr->msg_namelen = to_len;
+  ep->tx_count++;
+  return 0;
+}
+
+int
+dcwendpoint_send_packed(struct dcwendpoint * const ep, const struct dcwmsg * const msgs, const unsigned count, const struct sockaddr * const to, const socklen_t to_len, unsigned max_frame) {
+  struct msghdr *hdr;
+  unsigned packed;
+  unsigned queued;
+  unsigned size;
+
+  if (to_len > sizeof(struct sockaddr_storage)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (max_frame == 0) max_frame = DCWENDPOINT_DEFAULT_FRAME_SIZE;
+  if (max_frame > DGRAM_BUF_SIZE) max_frame = DGRAM_BUF_SIZE;
+
+  for (queued = 0; queued < count; queued += packed) {
+    if (tx_reserve(ep) == -1) {
+      /* a flush error dropped the queue, including what was queued here */
+      if ((queued == 0) || (errno != EAGAIN)) return -1;
+      return (int)queued;
+    }
+
+    hdr  = &ep->tx_hdrs[ep->tx_count].msg_hdr;
+    size = dcwmsg_container_pack(hdr->msg_iov[0].iov_base, max_frame, &msgs[queued], count - queued, &packed);
+    if (size == 0) {
+      errno = EINVAL; /* msgs[queued] is invalid */
+      if (queued == 0) return -1;
+      return (int)queued;
+    }
+    hdr->msg_iov[0].iov_len = size;
+    memcpy(hdr->msg_name, to, to_len);
+    hdr->msg_namelen = to_len;
+    ep->tx_count++;
+  }
+  return (int)queued;
+}
+
+int
+dcwendpoint_flush(struct dcwendpoint * const ep) {
+  unsigned sent;
+  int rv;
+
+  sent = 0;
+  while (ep->tx_head < ep->tx_count) {
+    rv = sendmmsg(ep->fd, &ep->tx_hdrs[ep->tx_head], ep->tx_count - ep->tx_head, MSG_DONTWAIT);
+    if (rv == -1) {
+      if (errno == EINTR) continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) return (int)sent; /* rest stays queued */
+      ep->tx_head  = 0;
+      ep->tx_count = 0; /* datagrams are best effort; drop the rest of the queue */
+      return -1;
+    }
+    ep->tx_head += (unsigned)rv;
+    sent        += (unsigned)rv;
+  }
+
+  ep->tx_head  = 0;
+  ep->tx_count = 0;
+  return (int)sent;
+}
+
@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWENDPOINT_H_INCLUDED
+#define DCWENDPOINT_H_INCLUDED
+
+/*
+  libdcwproto-endpoint...
+  A datagram socket (UDP or unix) with a receive -> parse -> dispatch loop and
+  a batched send queue. Linux only; built unless configured with
+  --disable-endpoint. Receives go through epoll + recvmmsg(); with
+  DCWENDPOINT_IO_URING_RECV they go through io_uring instead when the kernel
+  supports it. Received messages are parsed into structs from a dcwmsg_pool
+  the endpoint allocates at open time. An endpoint has no locking; drive
+  each one from a single thread.
+*/
+
+#include <dcwproto.h>
+
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DCWENDPOINT_DEFAULT_BATCH  64
+
+/*
+  dcwendpoint_open() flags. One recvmmsg() call per batch beats one io_uring
+  completion per datagram on loopback (see dcwbench_endpoint), so io_uring
+  is opt-in.
+*/
+#define DCWENDPOINT_NO_IO_URING    0x01 /* always use epoll + recvmmsg() (the default) */
+#define DCWENDPOINT_IO_URING_RECV  0x02 /* receive through io_uring when available */
+
+enum dcwendpoint_backend {
+  DCWENDPOINT_EPOLL    = 1,
+  DCWENDPOINT_IO_URING = 2,
+};
+
+struct dcwendpoint;
+
+/*
+  Called once per valid received message; container frames (see
+  dcwmsg_container_pack()) are unpacked and each message in them is passed
+  on by itself. "msg" and "from" are only valid for
+  the duration of the call. Handlers may queue replies with dcwendpoint_send()
+  but must not call dcwendpoint_poll().
+*/
+typedef void (*dcwendpoint_handler)(struct dcwendpoint * /* endpoint */, const struct dcwmsg * /* msg */, const struct sockaddr * /* from */, socklen_t /* from_len */, void * /* ctx */);
+
+/*
+  Creates a SOCK_DGRAM socket in bind_addr's family and binds it. "batch" is
+  the number of datagrams received per pass and queued per send (0 for the
+  default). Returns NULL with errno set on failure.
+*/
+struct dcwendpoint *dcwendpoint_open(const struct sockaddr * const /* bind_addr */, const socklen_t /* bind_addr_len */, const unsigned /* batch */, const unsigned /* flags */);
+void dcwendpoint_close(struct dcwendpoint * const /* endpoint */);
+
+int dcwendpoint_fd(const struct dcwendpoint * const /* endpoint */);
+enum dcwendpoint_backend dcwendpoint_backend(const struct dcwendpoint * const /* endpoint */);
+unsigned long dcwendpoint_dropped(const struct dcwendpoint * const /* endpoint */); /* datagrams (or messages in a container) that failed to marshal */
+
+/* a NULL handler unregisters; messages with no handler are discarded */
+void dcwendpoint_set_handler(struct dcwendpoint * const /* endpoint */, const enum dcwmsg_id /* id */, dcwendpoint_handler /* handler */, void * const /* ctx */);
+
+/*
+  Waits up to timeout_ms (-1 for no limit) for datagrams, then receives up to
+  one batch and dispatches them. Returns the number of datagrams received
+  (valid or not), 0 on timeout, or -1 with errno set.
+*/
+int dcwendpoint_poll(struct dcwendpoint * const /* endpoint */, const int /* timeout_ms */);
+
+/*
+  Serializes "msg" onto the send queue; a full queue is flushed first.
+  Returns 0 on success or -1 with errno set (EAGAIN if the queue is still
+  full because the socket is backed up).
+*/
+int dcwendpoint_send(struct dcwendpoint * const /* endpoint */, const struct dcwmsg * const /* msg */, const struct sockaddr * const /* to */, const socklen_t /* to_len */);
+
+/*
+  Queues "count" messages for one peer packed into as few container frames of
+  at most max_frame bytes as possible (0 for DCWENDPOINT_DEFAULT_FRAME_SIZE;
+  at most 2048). Only for peers that accept containers. Returns the number of
+  messages queued; fewer than "count" (or -1 if none) means the queue is
+  backed up (errno EAGAIN) or the next message is invalid (errno EINVAL).
+*/
+#define DCWENDPOINT_DEFAULT_FRAME_SIZE  1452 /* a 1500 byte MTU less IPv6 + UDP headers */
+int dcwendpoint_send_packed(struct dcwendpoint * const /* endpoint */, const struct dcwmsg * const /* msgs */, const unsigned /* count */, const struct sockaddr * const /* to */, const socklen_t /* to_len */, unsigned /* max_frame */);
+
+/*
+  Sends the queue with sendmmsg() without blocking. Whatever the socket will
+  not take stays queued for the next flush. Returns the number sent, or -1
+  on a send error (the queue is then dropped).
+*/
+int dcwendpoint_flush(struct dcwendpoint * const /* endpoint */);
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWENDPOINT_H_INCLUDED */
@@ -0,0 +1,1181 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef WIN32
+
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwjournal.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+/*
+
+  On-disk layout...
+  segment:    magic[8] seq:u64 (zero padded to SEGMENT_HEADER_SIZE), records
+  record:     size:u32 crc:u32 ts_ns:u64 primary_macaddr[6] msg_len:u16 msg,
+              zero padded to RECORD_ALIGN. "size" is written last and 0 marks
+              the end; crc covers everything after itself up to the padding.
+  index:      magic[8] seq:u64 first_ts:u64 last_ts:u64 end:u64
+              record_count:u64 entry_count:u32 crc:u32, bloom[BLOOM_BITS / 8],
+              entry_count * { ts_ns:u64 offset:u64 }. crc is over the whole
+              file with the crc field zeroed.
+  checkpoint: magic[8] seq:u64 offset:u64 binding_count:u32 crc:u32,
+              binding_count *
+              { data_macaddr[6] primary_macaddr[6] state:u8 ssid_len:u8
+              ssid[32] }. crc is over the bindings.
+
+*/
+#define SEGMENT_MAGIC           "DCWJSEG1"
+#define INDEX_MAGIC             "DCWJIDX1"
+#define CHECKPOINT_MAGIC        "DCWJCKP1"
+#define MAGIC_SIZE              8
+
+#define SEGMENT_HEADER_SIZE     64
+#define RECORD_HEADER_SIZE      24
+#define RECORD_ALIGN            8
+#define INDEX_HEADER_SIZE       56
+#define INDEX_ENTRY_SIZE        16
+#define CHECKPOINT_HEADER_SIZE  32
+#define CHECKPOINT_ENTRY_SIZE   (6 + 6 + 1 + 1 + sizeof(dcwmsg_ssid_t))
+
+#define BLOOM_BITS              4096
+#define MIN_SEGMENT_SIZE        (SEGMENT_HEADER_SIZE + RECORD_HEADER_SIZE + DCWMSG_MAX_SERIALIZED_SIZE + RECORD_ALIGN)
+
+#define RECORD_SIZE(MSG_LEN) \
+  ((RECORD_HEADER_SIZE + (MSG_LEN) + (RECORD_ALIGN - 1)) & ~(unsigned)(RECORD_ALIGN - 1))
+
+
+
+/*
+
+  Journal structures...
+  Every segment keeps its index in memory. Sealed segments are only mapped
+  for the duration of a scan or a recovery; the newest one stays mapped
+  read/write for appends.
+
+*/
+struct index_entry {
+  unsigned long long  ts_ns;
+  unsigned long long  offset;
+};
+
+struct segment {
+  unsigned long long    seq;
+  unsigned long long    first_ts;
+  unsigned long long    last_ts;
+  unsigned long long    end;            /* offset past the last record */
+  unsigned long long    record_count;
+  struct index_entry   *entries;        /* one per DCWJOURNAL_INDEX_INTERVAL records */
+  unsigned              entry_count;
+  unsigned              entry_capacity;
+  unsigned char         bloom[BLOOM_BITS / 8];
+};
+
+struct dcwjournal {
+  char                 *dir;
+  unsigned long         segment_size;
+  unsigned long         page_size;
+  struct segment       *segments;       /* oldest first; the last one is open */
+  unsigned              segment_count;
+  unsigned              segment_capacity;
+  int                   fd;             /* open segment */
+  unsigned char        *map;
+  unsigned long long    map_size;
+  unsigned long long    synced;         /* open segment bytes msync()ed so far */
+  int                   dir_dirty;      /* a file was created since the last sync */
+};
+
+
+
+/*
+
+  Encoding helpers...
+
+*/
+static void
+put_le16(unsigned char * const p, const unsigned v) {
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+}
+
+static void
+put_le32(unsigned char * const p, const unsigned v) {
+  put_le16(p, v & 0xFFFF);
+  put_le16(p + 2, v >> 16);
+}
+
+static void
+put_le64(unsigned char * const p, const unsigned long long v) {
+  put_le32(p, (unsigned)(v & 0xFFFFFFFF));
+  put_le32(p + 4, (unsigned)(v >> 32));
+}
+
+static unsigned
+get_le16(const unsigned char * const p) {
+  return (unsigned)p[0] | ((unsigned)p[1] << 8);
+}
+
+static unsigned
+get_le32(const unsigned char * const p) {
+  return get_le16(p) | (get_le16(p + 2) << 16);
+}
+
+static unsigned long long
+get_le64(const unsigned char * const p) {
+  return (unsigned long long)get_le32(p) | ((unsigned long long)get_le32(p + 4) << 32);
+}
+
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+static unsigned crc_table[256];
+
+static void
+crc_init(void) {
+  unsigned c;
+  unsigned i, k;
+
+  for (i = 0; i < 256; i++) {
+    c = i;
+    for (k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+    crc_table[i] = c;
+  }
+}
+
+/* CRC-32 (IEEE) */
+static unsigned
+crc32(const unsigned char *p, size_t len) {
+  unsigned c;
+
+  pthread_once(&crc_once, crc_init);
+  c = 0xFFFFFFFFU;
+  while (len--) c = crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFU;
+}
+
+
+
+/*
+
+  Station bloom filter...
+  Two bits per MAC address out of BLOOM_BITS; a few hundred stations per
+  segment still leaves the false positive rate in the low percent.
+
+*/
+static unsigned long long
+macaddr_hash(const unsigned char * const macaddr) {
+  unsigned long long k;
+  unsigned i;
+
+  k = 0;
+  for (i = 0; i < sizeof(dcwmsg_macaddr_t); i++) k = (k << 8) | macaddr[i];
+
+  /* murmur3 finalizer */
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDULL;
+  k ^= k >> 33;
+  k *= 0xC4CEB9FE1A85EC53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+static void
+bloom_add(unsigned char * const bloom, const unsigned char * const macaddr) {
+  const unsigned long long h = macaddr_hash(macaddr);
+  const unsigned a = (unsigned)(h & (BLOOM_BITS - 1));
+  const unsigned b = (unsigned)((h >> 32) & (BLOOM_BITS - 1));
+
+  bloom[a / 8] |= (unsigned char)(1 << (a % 8));
+  bloom[b / 8] |= (unsigned char)(1 << (b % 8));
+}
+
+static int
+bloom_test(const unsigned char * const bloom, const unsigned char * const macaddr) {
+  const unsigned long long h = macaddr_hash(macaddr);
+  const unsigned a = (unsigned)(h & (BLOOM_BITS - 1));
+  const unsigned b = (unsigned)((h >> 32) & (BLOOM_BITS - 1));
+
+  return (bloom[a / 8] & (1 << (a % 8))) && (bloom[b / 8] & (1 << (b % 8)));
+}
+
+
+
+/*
+
+  Record functions...
+
+*/
+
+/* returns the offset of the next record, or 0 at the end (or a torn record) */
+static unsigned long long
+record_parse(const unsigned char * const map, const unsigned long long map_size, const unsigned long long offset, struct dcwjournal_record * const output) {
+  const unsigned char *p;
+  unsigned size;
+  unsigned msg_len;
+
+  if ((offset > map_size) || ((map_size - offset) < RECORD_HEADER_SIZE)) return 0;
+  p = map + offset;
+
+  size = get_le32(p);
+  if (size == 0) return 0; /* end of the segment */
+  atomic_thread_fence(memory_order_acquire);
+
+  msg_len = get_le16(p + 22);
+  if ((msg_len == 0) || (msg_len > DCWMSG_MAX_SERIALIZED_SIZE)) return 0;
+  if (size != RECORD_SIZE(msg_len)) return 0;
+  if ((map_size - offset) < size) return 0;
+  if (crc32(p + 8, 16 + msg_len) != get_le32(p + 4)) return 0;
+
+  output->ts_ns   = get_le64(p + 8);
+  memcpy(output->primary_macaddr, p + 16, sizeof(dcwmsg_macaddr_t));
+  output->msg     = p + RECORD_HEADER_SIZE;
+  output->msg_len = msg_len;
+  output->offset  = offset;
+  return offset + size;
+}
+
+/* does the record involve "macaddr" as the station or one of its data channels? */
+static int
+record_mentions(const struct dcwjournal_record * const record, const unsigned char * const macaddr) {
+  struct dcwmsg_view view;
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+
+  if (memcmp(record->primary_macaddr, macaddr, sizeof(dcwmsg_macaddr_t)) == 0) return 1;
+  if (!dcwmsg_view_init(&view, record->msg, record->msg_len)) return 0;
+
+  dcwmsg_view_iter_init(&iter, &view);
+  while (dcwmsg_view_iter_next(&iter, &entry)) {
+    if ((entry.macaddr != NULL) && (memcmp(entry.macaddr, macaddr, sizeof(dcwmsg_macaddr_t)) == 0)) return 1;
+  }
+  return 0;
+}
+
+
+
+/*
+
+  Segment index functions...
+
+*/
+static int
+segment_reserve_entry(struct segment * const seg) {
+  struct index_entry *entries;
+  unsigned capacity;
+
+  if ((seg->record_count % DCWJOURNAL_INDEX_INTERVAL) != 0) return 1;
+  if (seg->entry_count < seg->entry_capacity) return 1;
+
+  capacity = seg->entry_capacity ? (seg->entry_capacity * 2) : 64;
+  entries = realloc(seg->entries, capacity * sizeof(*entries));
+  if (entries == NULL) return 0;
+  seg->entries        = entries;
+  seg->entry_capacity = capacity;
+  return 1;
+}
+
+/* the caller has already called segment_reserve_entry() */
+static void
+segment_index_record(struct segment * const seg, const struct dcwjournal_record * const record) {
+  struct dcwmsg_view view;
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+
+  if ((seg->record_count % DCWJOURNAL_INDEX_INTERVAL) == 0) {
+    seg->entries[seg->entry_count].ts_ns  = record->ts_ns;
+    seg->entries[seg->entry_count].offset = record->offset;
+    seg->entry_count++;
+  }
+
+  if ((seg->record_count == 0) || (record->ts_ns < seg->first_ts)) seg->first_ts = record->ts_ns;
+  if ((seg->record_count == 0) || (record->ts_ns > seg->last_ts)) seg->last_ts = record->ts_ns;
+  seg->record_count++;
+
+  bloom_add(seg->bloom, record->primary_macaddr);
+  if (!dcwmsg_view_init(&view, record->msg, record->msg_len)) return;
+  dcwmsg_view_iter_init(&iter, &view);
+  while (dcwmsg_view_iter_next(&iter, &entry)) {
+    if (entry.macaddr != NULL) bloom_add(seg->bloom, entry.macaddr);
+  }
+}
+
+static void
+segment_index_reset(struct segment * const seg) {
+  seg->first_ts     = 0;
+  seg->last_ts      = 0;
+  seg->end          = SEGMENT_HEADER_SIZE;
+  seg->record_count = 0;
+  seg->entry_count  = 0;
+  memset(seg->bloom, 0, sizeof(seg->bloom));
+}
+
+/* rebuilds the index by walking the records */
+static int
+segment_index_rebuild(struct segment * const seg, const unsigned char * const map, const unsigned long long map_size) {
+  struct dcwjournal_record record;
+  unsigned long long offset;
+  unsigned long long next;
+
+  segment_index_reset(seg);
+  offset = SEGMENT_HEADER_SIZE;
+  while ((next = record_parse(map, map_size, offset, &record)) != 0) {
+    if (!segment_reserve_entry(seg)) return 0;
+    segment_index_record(seg, &record);
+    offset = next;
+  }
+  seg->end = offset;
+  return 1;
+}
+
+/* offset of the first indexed record at or before from_ts */
+static unsigned long long
+segment_seek(const struct segment * const seg, const unsigned long long from_ts) {
+  unsigned lo, hi, mid;
+
+  if ((seg->entry_count == 0) || (seg->entries[0].ts_ns >= from_ts)) return SEGMENT_HEADER_SIZE;
+
+  /* last entry with ts_ns < from_ts */
+  lo = 0;
+  hi = seg->entry_count;
+  while ((hi - lo) > 1) {
+    mid = lo + ((hi - lo) / 2);
+    if (seg->entries[mid].ts_ns < from_ts) lo = mid;
+    else hi = mid;
+  }
+  return seg->entries[lo].offset;
+}
+
+
+
+/*
+
+  File helpers...
+
+*/
+static void
+journal_path(char * const path, const struct dcwjournal * const journal, const unsigned long long seq, const char * const ext) {
+  snprintf(path, PATH_MAX, "%s/%016llx.%s", journal->dir, seq, ext);
+}
+
+static int
+write_all(const int fd, const unsigned char *buf, size_t len) {
+  ssize_t rv;
+
+  while (len > 0) {
+    rv = write(fd, buf, len);
+    if (rv < 0) {
+      if (errno == EINTR) continue;
+      return 0;
+    }
+    buf += rv;
+    len -= (size_t)rv;
+  }
+  return 1;
+}
+
+/* writes, fsync()s and renames into place */
+static int
+write_file(const char * const path, const unsigned char * const buf, const size_t len) {
+  char tmp[PATH_MAX];
+  int fd;
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return 0;
+  if (!write_all(fd, buf, len) || (fsync(fd) != 0)) {
+    close(fd);
+    unlink(tmp);
+    return 0;
+  }
+  close(fd);
+  if (rename(tmp, path) != 0) {
+    unlink(tmp);
+    return 0;
+  }
+  return 1;
+}
+
+static unsigned char *
+read_file(const char * const path, size_t * const len) {
+  struct stat st;
+  unsigned char *buf;
+  ssize_t rv;
+  size_t got;
+  int fd;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  buf = malloc((size_t)st.st_size + 1);
+  if (buf == NULL) {
+    close(fd);
+    return NULL;
+  }
+  for (got = 0; got < (size_t)st.st_size; got += (size_t)rv) {
+    rv = read(fd, buf + got, (size_t)st.st_size - got);
+    if ((rv < 0) && (errno == EINTR)) {
+      rv = 0;
+      continue;
+    }
+    if (rv <= 0) break;
+  }
+  close(fd);
+
+  *len = got;
+  return buf;
+}
+
+static int
+sync_dir(const struct dcwjournal * const journal) {
+  int fd;
+  int rv;
+
+  fd = open(journal->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return 0;
+  rv = fsync(fd);
+  close(fd);
+  return rv == 0;
+}
+
+/* maps a sealed segment read-only; returns NULL on failure */
+static const unsigned char *
+segment_map(const struct dcwjournal * const journal, const unsigned long long seq, unsigned long long * const map_size) {
+  char path[PATH_MAX];
+  struct stat st;
+  void *map;
+  int fd;
+
+  journal_path(path, journal, seq, "seg");
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+  if ((fstat(fd, &st) != 0) || (st.st_size < SEGMENT_HEADER_SIZE)) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return NULL;
+
+  if ((memcmp(map, SEGMENT_MAGIC, MAGIC_SIZE) != 0) || (get_le64((const unsigned char *)map + 8) != seq)) {
+    munmap(map, (size_t)st.st_size);
+    errno = EINVAL;
+    return NULL;
+  }
+  *map_size = (unsigned long long)st.st_size;
+  return map;
+}
+
+/* the open segment is already mapped; everything else gets a temporary mapping */
+static const unsigned char *
+journal_segment_map(const struct dcwjournal * const journal, const unsigned i, unsigned long long * const map_size) {
+  if ((i == (journal->segment_count - 1)) && (journal->map != NULL)) {
+    *map_size = journal->map_size;
+    return journal->map;
+  }
+  return segment_map(journal, journal->segments[i].seq, map_size);
+}
+
+static void
+journal_segment_unmap(const struct dcwjournal * const journal, const unsigned char * const map, const unsigned long long map_size) {
+  if (map != journal->map) munmap((void *)map, (size_t)map_size);
+}
+
+
+
+/*
+
+  Index sidecar functions...
+
+*/
+static int
+index_write(const struct dcwjournal * const journal, const struct segment * const seg) {
+  char path[PATH_MAX];
+  unsigned char *buf;
+  unsigned char *p;
+  size_t len;
+  unsigned i;
+  int rv;
+
+  len = INDEX_HEADER_SIZE + sizeof(seg->bloom) + ((size_t)seg->entry_count * INDEX_ENTRY_SIZE);
+  buf = calloc(1, len);
+  if (buf == NULL) return 0;
+
+  memcpy(buf, INDEX_MAGIC, MAGIC_SIZE);
+  put_le64(buf + 8, seg->seq);
+  put_le64(buf + 16, seg->first_ts);
+  put_le64(buf + 24, seg->last_ts);
+  put_le64(buf + 32, seg->end);
+  put_le64(buf + 40, seg->record_count);
+  put_le32(buf + 48, seg->entry_count);
+  memcpy(buf + INDEX_HEADER_SIZE, seg->bloom, sizeof(seg->bloom));
+  p = buf + INDEX_HEADER_SIZE + sizeof(seg->bloom);
+  for (i = 0; i < seg->entry_count; i++, p += INDEX_ENTRY_SIZE) {
+    put_le64(p, seg->entries[i].ts_ns);
+    put_le64(p + 8, seg->entries[i].offset);
+  }
+  put_le32(buf + 52, crc32(buf, len));
+
+  journal_path(path, journal, seg->seq, "idx");
+  rv = write_file(path, buf, len);
+  free(buf);
+  return rv;
+}
+
+/* returns 0 if the sidecar is missing or does not match the segment */
+static int
+index_load(const struct dcwjournal * const journal, struct segment * const seg) {
+  char path[PATH_MAX];
+  struct stat st;
+  unsigned char *buf;
+  const unsigned char *p;
+  unsigned entry_count;
+  unsigned crc;
+  size_t len;
+  unsigned i;
+
+  journal_path(path, journal, seg->seq, "idx");
+  buf = read_file(path, &len);
+  if (buf == NULL) return 0;
+
+  if ((len < (INDEX_HEADER_SIZE + sizeof(seg->bloom))) ||
+      (memcmp(buf, INDEX_MAGIC, MAGIC_SIZE) != 0) ||
+      (get_le64(buf + 8) != seg->seq)) goto fail;
+  entry_count = get_le32(buf + 48);
+  if (len != (INDEX_HEADER_SIZE + sizeof(seg->bloom) + ((size_t)entry_count * INDEX_ENTRY_SIZE))) goto fail;
+  crc = get_le32(buf + 52);
+  put_le32(buf + 52, 0);
+  if (crc32(buf, len) != crc) goto fail;
+
+  /* the segment must still hold everything the index describes */
+  journal_path(path, journal, seg->seq, "seg");
+  if ((stat(path, &st) != 0) || ((unsigned long long)st.st_size < get_le64(buf + 32))) goto fail;
+
+  if (entry_count > seg->entry_capacity) {
+    struct index_entry *entries = realloc(seg->entries, entry_count * sizeof(*entries));
+    if (entries == NULL) goto fail;
+    seg->entries        = entries;
+    seg->entry_capacity = entry_count;
+  }
+  seg->first_ts     = get_le64(buf + 16);
+  seg->last_ts      = get_le64(buf + 24);
+  seg->end          = get_le64(buf + 32);
+  seg->record_count = get_le64(buf + 40);
+  seg->entry_count  = entry_count;
+  memcpy(seg->bloom, buf + INDEX_HEADER_SIZE, sizeof(seg->bloom));
+  p = buf + INDEX_HEADER_SIZE + sizeof(seg->bloom);
+  for (i = 0; i < entry_count; i++, p += INDEX_ENTRY_SIZE) {
+    seg->entries[i].ts_ns  = get_le64(p);
+    seg->entries[i].offset = get_le64(p + 8);
+  }
+  free(buf);
+  return 1;
+
+fail:
+  free(buf);
+  return 0;
+}
+
+
+
+/*
+
+  Segment lifecycle...
+
+*/
+static struct segment *
+segments_push(struct dcwjournal * const journal, const unsigned long long seq) {
+  struct segment *segments;
+  struct segment *seg;
+  unsigned capacity;
+
+  if (journal->segment_count == journal->segment_capacity) {
+    capacity = journal->segment_capacity ? (journal->segment_capacity * 2) : 16;
+    segments = realloc(journal->segments, capacity * sizeof(*segments));
+    if (segments == NULL) return NULL;
+    journal->segments         = segments;
+    journal->segment_capacity = capacity;
+  }
+
+  seg = &journal->segments[journal->segment_count++];
+  memset(seg, 0, sizeof(*seg));
+  seg->seq = seq;
+  seg->end = SEGMENT_HEADER_SIZE;
+  return seg;
+}
+
+static int
+segment_cmp(const void * const a, const void * const b) {
+  const unsigned long long x = ((const struct segment *)a)->seq;
+  const unsigned long long y = ((const struct segment *)b)->seq;
+  return (x > y) - (x < y);
+}
+
+/* creates a new, empty segment and makes it the open one */
+static int
+segment_create(struct dcwjournal * const journal, const unsigned long long seq) {
+  char path[PATH_MAX];
+  void *map;
+  int fd;
+
+  journal_path(path, journal, seq, "seg");
+  fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) return 0;
+  if (ftruncate(fd, (off_t)journal->segment_size) != 0) goto fail;
+  map = mmap(NULL, journal->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) goto fail;
+  if (segments_push(journal, seq) == NULL) {
+    munmap(map, journal->segment_size);
+    goto fail;
+  }
+
+  memcpy(map, SEGMENT_MAGIC, MAGIC_SIZE);
+  put_le64((unsigned char *)map + 8, seq);
+
+  journal->fd        = fd;
+  journal->map       = map;
+  journal->map_size  = journal->segment_size;
+  journal->synced    = 0;
+  journal->dir_dirty = 1;
+  return 1;
+
+fail:
+  close(fd);
+  unlink(path);
+  return 0;
+}
+
+/* maps the newest existing segment read/write and finds its end */
+static int
+segment_reopen(struct dcwjournal * const journal, struct segment * const seg) {
+  char path[PATH_MAX];
+  struct stat st;
+  unsigned char *map;
+  unsigned long long size;
+  int fd;
+
+  journal_path(path, journal, seg->seq, "seg");
+  fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) return 0;
+  if (fstat(fd, &st) != 0) goto fail;
+
+  /* a crash while creating it can leave a short or headerless file */
+  size = (unsigned long long)st.st_size;
+  if (size < SEGMENT_HEADER_SIZE) {
+    if (ftruncate(fd, (off_t)journal->segment_size) != 0) goto fail;
+    size = journal->segment_size;
+  }
+  map = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) goto fail;
+  if (memcmp(map, SEGMENT_MAGIC, MAGIC_SIZE) != 0) {
+    if ((size >= (SEGMENT_HEADER_SIZE + 4)) && (get_le32(map + SEGMENT_HEADER_SIZE) != 0)) {
+      munmap(map, (size_t)size);
+      errno = EINVAL;
+      goto fail;
+    }
+    memcpy(map, SEGMENT_MAGIC, MAGIC_SIZE);
+    put_le64(map + 8, seg->seq);
+  }
+  else if (get_le64(map + 8) != seg->seq) {
+    munmap(map, (size_t)size);
+    errno = EINVAL;
+    goto fail;
+  }
+
+  if (!segment_index_rebuild(seg, map, size)) {
+    munmap(map, (size_t)size);
+    goto fail;
+  }
+
+  /*
+    anything past the end is a torn record; clear it so that stale bytes
+    can't line up with a later append and parse as records again
+  */
+  if (((size - seg->end) >= 4) && (get_le32(map + seg->end) != 0)) {
+    memset(map + seg->end, 0, (size_t)(size - seg->end));
+  }
+
+  journal->fd       = fd;
+  journal->map      = map;
+  journal->map_size = size;
+  journal->synced   = 0;
+  return 1;
+
+fail:
+  close(fd);
+  return 0;
+}
+
+/*
+  writes the open segment's index, trims it and starts the next one; if
+  creating the next one fails, the next append retries just that part
+*/
+static int
+segment_rotate(struct dcwjournal * const journal) {
+  struct segment * const seg = &journal->segments[journal->segment_count - 1];
+
+  if (journal->map != NULL) {
+    if (!dcwjournal_sync(journal)) return 0;
+    munmap(journal->map, (size_t)journal->map_size);
+    journal->map      = NULL;
+    journal->map_size = 0;
+    if (ftruncate(journal->fd, (off_t)seg->end) != 0) { /* only reclaims space */ }
+    close(journal->fd);
+    journal->fd = -1;
+
+    /* not fatal; the index is rebuilt on open if it is missing */
+    index_write(journal, seg);
+  }
+
+  return segment_create(journal, seg->seq + 1);
+}
+
+
+
+/*
+
+  Journal functions begin here...
+
+*/
+struct dcwjournal *
+dcwjournal_open(const char * const dir, const unsigned long segment_size) {
+  struct dcwjournal *journal;
+  struct segment *seg;
+  struct dirent *ent;
+  unsigned long long map_size;
+  unsigned long long seq;
+  const unsigned char *map;
+  char *end;
+  DIR *d;
+  unsigned i;
+
+  if ((segment_size != 0) && (segment_size < MIN_SEGMENT_SIZE)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  journal = calloc(1, sizeof(*journal));
+  if (journal == NULL) return NULL;
+  journal->fd           = -1;
+  journal->segment_size = segment_size ? segment_size : DCWJOURNAL_DEFAULT_SEGMENT_SIZE;
+  journal->page_size    = (unsigned long)sysconf(_SC_PAGESIZE);
+  journal->dir          = strdup(dir);
+  if (journal->dir == NULL) goto fail;
+
+  /* find the existing segments ("%016llx.seg") */
+  d = opendir(dir);
+  if (d == NULL) goto fail;
+  while ((ent = readdir(d)) != NULL) {
+    if ((strlen(ent->d_name) != 20) || (strcmp(ent->d_name + 16, ".seg") != 0)) continue;
+    seq = strtoull(ent->d_name, &end, 16);
+    if (end != (ent->d_name + 16)) continue;
+    if (segments_push(journal, seq) == NULL) {
+      closedir(d);
+      goto fail;
+    }
+  }
+  closedir(d);
+
+  if (journal->segment_count == 0) {
+    if (!segment_create(journal, 1)) goto fail;
+    return journal;
+  }
+  qsort(journal->segments, journal->segment_count, sizeof(*journal->segments), segment_cmp);
+
+  /* sealed segments: load the sidecar index, or rebuild and rewrite it */
+  for (i = 0; i < (journal->segment_count - 1); i++) {
+    seg = &journal->segments[i];
+    if (index_load(journal, seg)) continue;
+    map = segment_map(journal, seg->seq, &map_size);
+    if (map == NULL) goto fail;
+    if (!segment_index_rebuild(seg, map, map_size)) {
+      munmap((void *)map, (size_t)map_size);
+      goto fail;
+    }
+    munmap((void *)map, (size_t)map_size);
+    index_write(journal, seg);
+  }
+
+  if (!segment_reopen(journal, &journal->segments[journal->segment_count - 1])) goto fail;
+  return journal;
+
+fail:
+  dcwjournal_close(journal);
+  return NULL;
+}
+
+void
+dcwjournal_close(struct dcwjournal * const journal) {
+  unsigned i;
+
+  if (journal == NULL) return;
+
+  if (journal->map != NULL) {
+    dcwjournal_sync(journal);
+    munmap(journal->map, (size_t)journal->map_size);
+  }
+  if (journal->fd >= 0) close(journal->fd);
+  for (i = 0; i < journal->segment_count; i++) free(journal->segments[i].entries);
+  free(journal->segments);
+  free(journal->dir);
+  free(journal);
+}
+
+int
+dcwjournal_append(struct dcwjournal * const journal, const unsigned long long ts_ns, const unsigned char * const primary_macaddr, const struct dcwmsg * const msg) {
+  struct dcwjournal_record record;
+  struct segment *seg;
+  unsigned char *p;
+  unsigned msg_len;
+  unsigned size;
+
+  msg_len = dcwmsg_serialized_size(msg);
+  if (msg_len == 0) {
+    errno = EINVAL;
+    return 0;
+  }
+  size = RECORD_SIZE(msg_len);
+
+  seg = &journal->segments[journal->segment_count - 1];
+  if ((journal->map == NULL) || ((journal->map_size - seg->end) < (size + 4))) {
+    /* keep room for the zero "size" that ends the segment */
+    if (!segment_rotate(journal)) return 0;
+    seg = &journal->segments[journal->segment_count - 1];
+  }
+  if (!segment_reserve_entry(seg)) return 0;
+
+  /* the space past the end is zero, so the padding already is */
+  p = journal->map + seg->end;
+  put_le64(p + 8, ts_ns);
+  memcpy(p + 16, primary_macaddr, sizeof(dcwmsg_macaddr_t));
+  put_le16(p + 22, msg_len);
+  dcwmsg_serialize_exact(p + RECORD_HEADER_SIZE, msg, msg_len);
+  put_le32(p + 4, crc32(p + 8, 16 + msg_len));
+
+  /* commit: the size goes in last */
+  atomic_thread_fence(memory_order_release);
+  put_le32(p, size);
+
+  record.ts_ns   = ts_ns;
+  memcpy(record.primary_macaddr, primary_macaddr, sizeof(dcwmsg_macaddr_t));
+  record.msg     = p + RECORD_HEADER_SIZE;
+  record.msg_len = msg_len;
+  record.offset  = seg->end;
+  segment_index_record(seg, &record);
+  seg->end += size;
+  return 1;
+}
+
+int
+dcwjournal_sync(struct dcwjournal * const journal) {
+  const struct segment * const seg = &journal->segments[journal->segment_count - 1];
+  unsigned long long start;
+
+  if ((journal->map != NULL) && (seg->end > journal->synced)) {
+    start = journal->synced & ~(unsigned long long)(journal->page_size - 1);
+    if (msync(journal->map + start, (size_t)(seg->end - start), MS_SYNC) != 0) return 0;
+    journal->synced = seg->end;
+  }
+  if (journal->dir_dirty) {
+    if (!sync_dir(journal)) return 0;
+    journal->dir_dirty = 0;
+  }
+  return 1;
+}
+
+unsigned long
+dcwjournal_scan(struct dcwjournal * const journal, const unsigned char * const macaddr, const unsigned long long from_ts, const unsigned long long to_ts, dcwjournal_record_cb cb, void * const ctx) {
+  struct dcwjournal_record record;
+  const struct segment *seg;
+  const unsigned char *map;
+  unsigned long long map_size;
+  unsigned long long limit;
+  unsigned long long offset;
+  unsigned long long next;
+  unsigned long passed;
+  int stop;
+  unsigned i;
+
+  passed = 0;
+  stop   = 0;
+  for (i = 0; (i < journal->segment_count) && !stop; i++) {
+    seg = &journal->segments[i];
+    if (seg->record_count == 0) continue;
+    if ((seg->last_ts < from_ts) || (seg->first_ts > to_ts)) continue;
+    if ((macaddr != NULL) && !bloom_test(seg->bloom, macaddr)) continue;
+
+    map = journal_segment_map(journal, i, &map_size);
+    if (map == NULL) continue;
+    limit = (map_size < seg->end) ? map_size : seg->end;
+
+    offset = segment_seek(seg, from_ts);
+    while ((next = record_parse(map, limit, offset, &record)) != 0) {
+      offset = next;
+      if (record.ts_ns < from_ts) continue;
+      if (record.ts_ns > to_ts) {
+        stop = 1;
+        break;
+      }
+      if ((macaddr != NULL) && !record_mentions(&record, macaddr)) continue;
+
+      record.seq = seg->seq;
+      passed++;
+      if (!cb(&record, ctx)) {
+        stop = 1;
+        break;
+      }
+    }
+    journal_segment_unmap(journal, map, map_size);
+  }
+  return passed;
+}
+
+
+
+/*
+
+  Checkpoint functions...
+
+*/
+struct checkpoint_writer {
+  unsigned char  *pos;
+  unsigned        count;
+  unsigned        max;
+};
+
+static void
+checkpoint_add(const struct dcwsta_binding * const binding, void * const ctx) {
+  struct checkpoint_writer * const writer = ctx;
+  unsigned char *p;
+
+  if (writer->count == writer->max) return;
+  p = writer->pos;
+  memcpy(p, binding->data_macaddr, sizeof(dcwmsg_macaddr_t));
+  memcpy(p + 6, binding->primary_macaddr, sizeof(dcwmsg_macaddr_t));
+  p[12] = (unsigned char)binding->state;
+  p[13] = (unsigned char)binding->ssid_len;
+  memset(p + 14, 0, sizeof(dcwmsg_ssid_t));
+  memcpy(p + 14, binding->ssid, binding->ssid_len);
+  writer->pos += CHECKPOINT_ENTRY_SIZE;
+  writer->count++;
+}
+
+int
+dcwjournal_checkpoint(struct dcwjournal * const journal, const struct dcwsta_table * const table) {
+  const struct segment * const seg = &journal->segments[journal->segment_count - 1];
+  struct checkpoint_writer writer;
+  char path[PATH_MAX];
+  unsigned char *buf;
+  size_t len;
+  int rv;
+
+  /* the checkpoint must never point past what is on disk */
+  if (!dcwjournal_sync(journal)) return 0;
+
+  writer.max = dcwsta_table_count(table);
+  len = CHECKPOINT_HEADER_SIZE + ((size_t)writer.max * CHECKPOINT_ENTRY_SIZE);
+  buf = calloc(1, len);
+  if (buf == NULL) return 0;
+
+  writer.pos   = buf + CHECKPOINT_HEADER_SIZE;
+  writer.count = 0;
+  dcwsta_table_foreach(table, checkpoint_add, &writer);
+
+  len = CHECKPOINT_HEADER_SIZE + ((size_t)writer.count * CHECKPOINT_ENTRY_SIZE);
+  memcpy(buf, CHECKPOINT_MAGIC, MAGIC_SIZE);
+  put_le64(buf + 8, seg->seq);
+  put_le64(buf + 16, seg->end);
+  put_le32(buf + 24, writer.count);
+  put_le32(buf + 28, crc32(buf + CHECKPOINT_HEADER_SIZE, len - CHECKPOINT_HEADER_SIZE));
+
+  snprintf(path, sizeof(path), "%s/checkpoint", journal->dir);
+  rv = write_file(path, buf, len) && sync_dir(journal);
+  free(buf);
+  return rv;
+}
+
+/* returns the checkpoint file, NULL with errno ENOENT if there is none */
+static unsigned char *
+checkpoint_read(const struct dcwjournal * const journal, size_t * const len) {
+  char path[PATH_MAX];
+  unsigned char *buf;
+
+  snprintf(path, sizeof(path), "%s/checkpoint", journal->dir);
+  buf = read_file(path, len);
+  if (buf == NULL) return NULL;
+
+  if (((*len) < CHECKPOINT_HEADER_SIZE) ||
+      (memcmp(buf, CHECKPOINT_MAGIC, MAGIC_SIZE) != 0) ||
+      ((*len) != (CHECKPOINT_HEADER_SIZE + ((size_t)get_le32(buf + 24) * CHECKPOINT_ENTRY_SIZE))) ||
+      (crc32(buf + CHECKPOINT_HEADER_SIZE, (*len) - CHECKPOINT_HEADER_SIZE) != get_le32(buf + 28))) {
+    free(buf);
+    errno = EINVAL;
+    return NULL;
+  }
+  return buf;
+}
+
+/* re-creates one checkpointed binding with the message that would have made it */
+static int
+checkpoint_apply(struct dcwsta_table * const table, const unsigned char * const p) {
+  struct dcwmsg msg;
+  const unsigned ssid_len = p[13];
+
+  memset(&msg, 0, sizeof(msg));
+  switch (p[12]) {
+  case DCWSTA_JOINING:
+    msg.id = DCWMSG_STA_JOIN;
+    msg.sta_join.data_macaddr_count = 1;
+    memcpy(msg.sta_join.data_macaddrs[0], p, sizeof(dcwmsg_macaddr_t));
+    break;
+  case DCWSTA_BONDED:
+    if (ssid_len > sizeof(dcwmsg_ssid_t)) return 0;
+    msg.id = DCWMSG_STA_ACK;
+    msg.sta_ack.bonded_data_channel_count = 1;
+    memcpy(msg.sta_ack.bonded_data_channels[0].macaddr, p, sizeof(dcwmsg_macaddr_t));
+    memcpy(msg.sta_ack.bonded_data_channels[0].ssid, p + 14, ssid_len);
+    break;
+  default:
+    return 0;
+  }
+  return dcwsta_table_apply(table, p + 6, &msg);
+}
+
+long
+dcwjournal_recover(struct dcwjournal * const journal, struct dcwsta_table * const table) {
+  struct dcwjournal_record record;
+  const struct segment *seg;
+  const unsigned char *map;
+  unsigned long long map_size;
+  unsigned long long limit;
+  unsigned long long start_seq;
+  unsigned long long offset;
+  unsigned long long next;
+  unsigned char *buf;
+  struct dcwmsg msg;
+  unsigned count;
+  size_t len;
+  long replayed;
+  unsigned i;
+
+  start_seq = journal->segments[0].seq;
+  offset    = SEGMENT_HEADER_SIZE;
+
+  buf = checkpoint_read(journal, &len);
+  if (buf != NULL) {
+    count = get_le32(buf + 24);
+    for (i = 0; i < count; i++) {
+      if (!checkpoint_apply(table, buf + CHECKPOINT_HEADER_SIZE + (i * CHECKPOINT_ENTRY_SIZE))) {
+        free(buf);
+        errno = EINVAL;
+        return -1;
+      }
+    }
+    start_seq = get_le64(buf + 8);
+    offset    = get_le64(buf + 16);
+    free(buf);
+  }
+  else if (errno != ENOENT) {
+    return -1;
+  }
+
+  /* replay the tail */
+  replayed = 0;
+  for (i = 0; i < journal->segment_count; i++) {
+    seg = &journal->segments[i];
+    if (seg->seq < start_seq) continue;
+    if (seg->seq > start_seq) offset = SEGMENT_HEADER_SIZE;
+    if (offset > seg->end) {
+      errno = EINVAL; /* the checkpoint is ahead of the journal */
+      return -1;
+    }
+    if (offset == seg->end) continue;
+
+    map = journal_segment_map(journal, i, &map_size);
+    if (map == NULL) return -1;
+    limit = (map_size < seg->end) ? map_size : seg->end;
+
+    while ((next = record_parse(map, limit, offset, &record)) != 0) {
+      offset = next;
+      if (!dcwmsg_marshal(&msg, record.msg, record.msg_len) ||
+          !dcwsta_table_apply(table, record.primary_macaddr, &msg)) {
+        journal_segment_unmap(journal, map, map_size);
+        errno = EINVAL;
+        return -1;
+      }
+      replayed++;
+    }
+    journal_segment_unmap(journal, map, map_size);
+  }
+  return replayed;
+}
+
+unsigned
+dcwjournal_prune(struct dcwjournal * const journal) {
+  char path[PATH_MAX];
+  unsigned long long seq;
+  unsigned char *buf;
+  size_t len;
+  unsigned pruned;
+
+  buf = checkpoint_read(journal, &len);
+  if (buf == NULL) return 0;
+  seq = get_le64(buf + 8);
+  free(buf);
+
+  /* the open segment is never before the checkpoint */
+  pruned = 0;
+  while (((pruned + 1) < journal->segment_count) && (journal->segments[pruned].seq < seq)) {
+    journal_path(path, journal, journal->segments[pruned].seq, "seg");
+    unlink(path);
+    journal_path(path, journal, journal->segments[pruned].seq, "idx");
+    unlink(path);
+    free(journal->segments[pruned].entries);
+    pruned++;
+  }
+  if (pruned > 0) {
+    journal->segment_count -= pruned;
+    memmove(journal->segments, journal->segments + pruned, journal->segment_count * sizeof(*journal->segments));
+    journal->dir_dirty = 1;
+  }
+  return pruned;
+}
+
+
+#endif /* #ifndef WIN32 */
@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWJOURNAL_H_INCLUDED
+#define DCWJOURNAL_H_INCLUDED
+
+#include <dcwproto.h>
+#include <dcwsta.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef WIN32
+/*
+  Append-only message journal...
+  A directory of fixed-size, mmap'd segment files ("<seq>.seg"). Each record
+  holds a timestamp, the sending station's primary MAC and the serialized
+  message, and is checksummed so a torn tail left by a crash is detected and
+  ignored. When a segment fills up it is sealed and a sidecar index
+  ("<seq>.idx") is written next to it: the segment's time range, a sparse
+  time index (every DCWJOURNAL_INDEX_INTERVAL records) and a bloom filter of
+  every station MAC in it. Scans use these to skip whole segments and seek
+  within them without re-marshaling anything. Part of libdcwproto-mt.
+
+  dcwjournal_checkpoint() saves a dcwsta_table together with the journal
+  position it reflects, and dcwjournal_recover() rebuilds a table from the
+  newest checkpoint plus only the records appended after it.
+
+  Timestamps are caller supplied (nanoseconds, any epoch) and are expected
+  not to go backwards; time seeks assume it. Multi-byte fields on disk are
+  little endian. A journal has no locking; use it from one thread, and have
+  only one process open a directory at a time.
+*/
+#define DCWJOURNAL_DEFAULT_SEGMENT_SIZE  (64UL << 20)
+#define DCWJOURNAL_INDEX_INTERVAL        64
+
+struct dcwjournal;
+
+struct dcwjournal_record {
+  unsigned long long      ts_ns;
+  dcwmsg_macaddr_t        primary_macaddr;
+  const unsigned char    *msg;        /* serialized; points into the mapping */
+  unsigned                msg_len;
+  unsigned long long      seq;        /* segment the record is in */
+  unsigned long long      offset;     /* within that segment */
+};
+
+/* return 0 to stop the scan */
+typedef int (*dcwjournal_record_cb)(const struct dcwjournal_record * const /* record */, void * const /* ctx */);
+
+/*
+  Opens (creating if needed) the journal in an existing directory. A torn
+  record at the end of the newest segment is discarded. segment_size may be
+  0 for DCWJOURNAL_DEFAULT_SEGMENT_SIZE and only applies to new segments.
+*/
+struct dcwjournal * dcwjournal_open(const char * const /* dir */, const unsigned long /* segment_size */);
+
+/* syncs and unmaps; the open segment's index is rebuilt by the next open */
+void dcwjournal_close(struct dcwjournal * const /* journal */);
+
+/*
+  Appends one message, serialized straight into the mapping. Returns 1 on
+  success, 0 on failure (errno EINVAL for an invalid message). The record
+  survives a process crash once this returns; call dcwjournal_sync() to make
+  it survive a power loss.
+*/
+int dcwjournal_append(struct dcwjournal * const /* journal */, const unsigned long long /* ts_ns */, const unsigned char * const /* primary_macaddr */, const struct dcwmsg * const /* msg */);
+
+/* msync()s everything appended since the last sync; returns 1 on success */
+int dcwjournal_sync(struct dcwjournal * const /* journal */);
+
+/*
+  Calls cb for each record with from_ts <= ts_ns <= to_ts, oldest first.
+  With a non-NULL macaddr only records where it is the primary MAC or one of
+  the message's data MACs are passed. Returns the number of records passed.
+*/
+unsigned long dcwjournal_scan(struct dcwjournal * const /* journal */, const unsigned char * const /* macaddr */, const unsigned long long /* from_ts */, const unsigned long long /* to_ts */, dcwjournal_record_cb /* cb */, void * const /* ctx */);
+
+/*
+  Saves "table" as the state after every record appended so far (the caller
+  keeps the table in step with its appends). The journal is synced first and
+  the checkpoint replaced atomically. Returns 1 on success.
+*/
+int dcwjournal_checkpoint(struct dcwjournal * const /* journal */, const struct dcwsta_table * const /* table */);
+
+/*
+  Loads the newest checkpoint into an empty "table", then applies each later
+  record with dcwsta_table_apply(). Without a checkpoint every record is
+  replayed. Returns the number of records replayed, or -1 on failure.
+*/
+long dcwjournal_recover(struct dcwjournal * const /* journal */, struct dcwsta_table * const /* table */);
+
+/* deletes segments wholly before the checkpoint; returns how many */
+unsigned dcwjournal_prune(struct dcwjournal * const /* journal */);
+#endif
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWJOURNAL_H_INCLUDED */
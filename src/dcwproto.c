@@ -23,6 +23,7 @@
 #include <config.h>
 #include <strings.h>
 #include <dcwproto.h>
+#include "dcwstats_hooks.h"
 
 #ifndef _POSIX_C_SOURCE
 #define _POSIX_C_SOURCE 200809L
@@ -32,6 +33,10 @@
 
 #define ELEMENT_COUNT(ARR) (sizeof(ARR) / sizeof(ARR[0]))
 
+#ifdef DCWPROTO_STATS
+static enum dcwmsg_error dcwmsg_marshal_ex_any(struct dcwmsg * const, const unsigned char * const, const unsigned, unsigned * const);
+#endif
+
 
 
 /*
@@ -51,8 +56,8 @@ dcwmsg_marshal_sta_join(struct dcwmsg_sta_join * const output, const unsigned ch
   }
 
   copy_size = output->data_macaddr_count * 6;
-  if (buf_len < copy_size) {
-    return 0; /* not enought input data... */
+  if ((buf_len - 1) < copy_size) {
+    return 0; /* not enought input data after the count byte... */
   }
   memcpy(output->data_macaddrs, &buf[1], copy_size);
   
@@ -165,8 +170,9 @@ dcwmsg_marshal_ap_reject_sta(struct dcwmsg_ap_reject_sta * const output, const u
   return 1; /* success */
 }
 
-int WIN32_EXPORT
-dcwmsg_marshal(struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len) {
+#ifndef DCWPROTO_STATS /* the stats build marshals through dcwmsg_marshal_ex_any() */
+static int
+dcwmsg_marshal_any(struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len) {
   if (buf_len < 1) return 0; /* marshal failed */
   switch( output->id = (enum dcwmsg_id)buf[0] ) {
   case DCWMSG_STA_JOIN:           return dcwmsg_marshal_sta_join(&output->sta_join, buf + 1, buf_len - 1);
@@ -182,6 +188,22 @@ dcwmsg_marshal(struct dcwmsg * const output, const unsigned char * const buf, co
   }
   return 0; /* shouldnt get here... */
 }
+#endif
+
+int WIN32_EXPORT
+dcwmsg_marshal(struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len) {
+#ifdef DCWPROTO_STATS
+  const unsigned long long start = dcwstats_hook_start();
+  unsigned offset;
+  /* one parse gives both the result and the failure reason */
+  const enum dcwmsg_error rv = dcwmsg_marshal_ex_any(output, buf, buf_len, &offset);
+
+  dcwstats_hook_marshal_error(buf, buf_len, rv, start);
+  return (rv == DCWMSG_OK);
+#else
+  return dcwmsg_marshal_any(output, buf, buf_len);
+#endif
+}
 
 
 
@@ -330,13 +352,13 @@ dcwmsg_serialize_ap_reject_sta(unsigned char *buf, const struct dcwmsg_ap_reject
   if (buf_remaining < copy_size) return 0;
   memcpy(buf, input->data_macaddrs, copy_size);
   buf_remaining -= copy_size;
-  buf++;
+  buf += copy_size;
 
   return buf_len - buf_remaining;
 }
 
-unsigned WIN32_EXPORT
-dcwmsg_serialize(unsigned char * const buf, const struct dcwmsg * const input, const unsigned buf_len) {
+static unsigned
+dcwmsg_serialize_any(unsigned char * const buf, const struct dcwmsg * const input, const unsigned buf_len) {
   unsigned rv;
 
   if (buf_len < 1) return 0; /* serialize failed */
@@ -373,6 +395,18 @@ dcwmsg_serialize(unsigned char * const buf, const struct dcwmsg * const input, c
   return (rv == 0) ? 0 : (rv + 1);
 }
 
+unsigned WIN32_EXPORT
+dcwmsg_serialize(unsigned char * const buf, const struct dcwmsg * const input, const unsigned buf_len) {
+#ifdef DCWPROTO_STATS
+  const unsigned long long start = dcwstats_hook_start();
+  const unsigned rv = dcwmsg_serialize_any(buf, input, buf_len);
+  dcwstats_hook_serialize(input, buf_len, rv, start);
+  return rv;
+#else
+  return dcwmsg_serialize_any(buf, input, buf_len);
+#endif
+}
+
 
 
 
@@ -381,137 +415,472 @@ dcwmsg_serialize(unsigned char * const buf, const struct dcwmsg * const input, c
 
 /*
 
-  Diagnostic functions begin here...
+  Extended marshal functions begin here...
+  "*offset" is the absolute position in the message; each helper advances it
+  past what it read, or leaves it on the field that failed.
 
 */
-#include <stdio.h>
-static void
-fprintf_macaddr(FILE * const f, const unsigned char * const macaddr) {
-  fprintf(f, "%02X-%02X-%02X-%02X-%02X-%02X",
-          (unsigned)macaddr[0],
-          (unsigned)macaddr[1],
-          (unsigned)macaddr[2],
-          (unsigned)macaddr[3],
-          (unsigned)macaddr[4],
-          (unsigned)macaddr[5]
-  );
+static enum dcwmsg_error
+dcwmsg_marshal_ex_count(unsigned * const count, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+  if (buf_len <= (*offset)) return DCWMSG_ERR_TRUNCATED;
+  (*count) = (unsigned)buf[*offset];
+  if ((*count) > DCWMSG_MAX_ENTRIES) return DCWMSG_ERR_COUNT_TOO_BIG;
+  (*offset)++;
+  return DCWMSG_OK;
 }
 
-void WIN32_EXPORT
-dcwmsg_dbgdump(const struct dcwmsg * const msg) {
+static enum dcwmsg_error
+dcwmsg_marshal_ex_macaddrs(unsigned * const count, dcwmsg_macaddr_t * const macaddrs, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+  enum dcwmsg_error rv;
+  unsigned copy_size;
+
+  rv = dcwmsg_marshal_ex_count(count, buf, buf_len, offset);
+  if (rv != DCWMSG_OK) return rv;
+
+  copy_size = (*count) * sizeof(dcwmsg_macaddr_t);
+  if ((buf_len - (*offset)) < copy_size) {
+    /* point at the first MAC address that is cut off */
+    (*offset) += ((buf_len - (*offset)) / sizeof(dcwmsg_macaddr_t)) * sizeof(dcwmsg_macaddr_t);
+    return DCWMSG_ERR_TRUNCATED;
+  }
+  memcpy(macaddrs, &buf[*offset], copy_size);
+  (*offset) += copy_size;
+  return DCWMSG_OK;
+}
 
-  FILE *f;
+static enum dcwmsg_error
+dcwmsg_marshal_ex_ssid(dcwmsg_ssid_t ssid, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+  unsigned copy_size;
+
+  if (buf_len <= (*offset)) return DCWMSG_ERR_TRUNCATED;
+  copy_size = (unsigned)buf[*offset];
+  if (copy_size > sizeof(dcwmsg_ssid_t)) return DCWMSG_ERR_SSID_TOO_LONG;
+  if ((buf_len - (*offset) - 1) < copy_size) return DCWMSG_ERR_TRUNCATED;
+
+  memset(ssid, 0, sizeof(dcwmsg_ssid_t));
+  memcpy(ssid, &buf[(*offset) + 1], copy_size);
+  (*offset) += 1 + copy_size;
+  return DCWMSG_OK;
+}
+
+static enum dcwmsg_error
+dcwmsg_marshal_ex_sta_ack(struct dcwmsg_sta_ack * const output, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+  enum dcwmsg_error rv;
   unsigned i;
 
-  f = stderr;
+  rv = dcwmsg_marshal_ex_count(&output->bonded_data_channel_count, buf, buf_len, offset);
+  if (rv != DCWMSG_OK) return rv;
+
+  for (i = 0; i < output->bonded_data_channel_count; i++) {
+    if ((buf_len - (*offset)) < sizeof(dcwmsg_macaddr_t)) return DCWMSG_ERR_TRUNCATED;
+    memcpy(output->bonded_data_channels[i].macaddr, &buf[*offset], sizeof(dcwmsg_macaddr_t));
+    (*offset) += sizeof(dcwmsg_macaddr_t);
+
+    rv = dcwmsg_marshal_ex_ssid(output->bonded_data_channels[i].ssid, buf, buf_len, offset);
+    if (rv != DCWMSG_OK) return rv;
+  }
+  return DCWMSG_OK;
+}
+
+static enum dcwmsg_error
+dcwmsg_marshal_ex_ap_accept_sta(struct dcwmsg_ap_accept_sta * const output, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+  enum dcwmsg_error rv;
+  unsigned i;
 
-  fprintf(f, "DCW Message Dump:\n");
+  rv = dcwmsg_marshal_ex_count(&output->data_ssid_count, buf, buf_len, offset);
+  if (rv != DCWMSG_OK) return rv;
 
-  if (msg == NULL) {
-    fprintf(f, "  (NULL)\n");
-    return;
+  for (i = 0; i < output->data_ssid_count; i++) {
+    rv = dcwmsg_marshal_ex_ssid(output->data_ssids[i], buf, buf_len, offset);
+    if (rv != DCWMSG_OK) return rv;
   }
+  return DCWMSG_OK;
+}
 
-  switch (msg->id) {
-  case DCWMSG_STA_JOIN:
-    fprintf(f, "  Type: Station Join\n");
-    fprintf(f, "  Data Channel MAC Address Count: %u\n", msg->sta_join.data_macaddr_count);
-    if (msg->sta_join.data_macaddr_count > ELEMENT_COUNT(msg->sta_join.data_macaddrs)) {
-      fprintf(f, "  (Count too high)\n");
-      return;
-    }
-    fprintf(f, "  Data Channel MAC Address:\n");
-    for (i = 0; i < msg->sta_join.data_macaddr_count; i++) {
-      fprintf(f, "    . ");
-      fprintf_macaddr(f, msg->sta_join.data_macaddrs[i]);
-      fprintf(f, "\n");
-    }
-    break;
+static enum dcwmsg_error
+dcwmsg_marshal_ex_any(struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+  (*offset) = 0;
+  if (buf_len < 1) return DCWMSG_ERR_TRUNCATED;
 
+  output->id = (enum dcwmsg_id)buf[0];
+  (*offset) = 1;
+
+  switch (output->id) {
+  case DCWMSG_STA_JOIN:
   case DCWMSG_STA_UNJOIN:
-    fprintf(f, "  Type: Station Unjoin\n");
-    fprintf(f, "  Data Channel MAC Address Count: %u\n", msg->sta_unjoin.data_macaddr_count);
-    if (msg->sta_unjoin.data_macaddr_count > ELEMENT_COUNT(msg->sta_unjoin.data_macaddrs)) {
-      fprintf(f, "  (Count too high)\n");
-      return;
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* all four MAC list structs share the same layout */
+    return dcwmsg_marshal_ex_macaddrs(&output->sta_join.data_macaddr_count, output->sta_join.data_macaddrs, buf, buf_len, offset);
+  case DCWMSG_STA_ACK:
+    return dcwmsg_marshal_ex_sta_ack(&output->sta_ack, buf, buf_len, offset);
+  case DCWMSG_AP_ACCEPT_STA:
+    return dcwmsg_marshal_ex_ap_accept_sta(&output->ap_accept_sta, buf, buf_len, offset);
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    return DCWMSG_OK; /* this message is ID only */
+  default:
+    (*offset) = 0;
+    return DCWMSG_ERR_UNKNOWN_ID;
+  }
+}
+
+enum dcwmsg_error WIN32_EXPORT
+dcwmsg_marshal_ex(struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len, unsigned * const offset) {
+#ifdef DCWPROTO_STATS
+  const unsigned long long start = dcwstats_hook_start();
+  const enum dcwmsg_error rv = dcwmsg_marshal_ex_any(output, buf, buf_len, offset);
+  dcwstats_hook_marshal_error(buf, buf_len, rv, start);
+  return rv;
+#else
+  return dcwmsg_marshal_ex_any(output, buf, buf_len, offset);
+#endif
+}
+
+const char * WIN32_EXPORT
+dcwmsg_strerror(const enum dcwmsg_error error) {
+  switch (error) {
+  case DCWMSG_OK:                 return "success";
+  case DCWMSG_ERR_TRUNCATED:      return "message truncated";
+  case DCWMSG_ERR_COUNT_TOO_BIG:  return "entry count too big";
+  case DCWMSG_ERR_SSID_TOO_LONG:  return "SSID too long";
+  case DCWMSG_ERR_UNKNOWN_ID:     return "unknown message id";
+  default:                        return "unknown error";
+  }
+}
+
+
+
+
+
+
+
+/*
+
+  Batch functions begin here...
+  Messages are processed in chunks; within each chunk they are grouped by
+  message id so each per-type function runs in its own tight loop rather
+  than going through the id switch once per message.
+
+*/
+#define BATCH_CHUNK_SIZE 64
+#define BATCH_SLOT_COUNT 9 /* one per known message id plus one for unknown ids */
+
+static const enum dcwmsg_id batch_slot_ids[BATCH_SLOT_COUNT - 1] = {
+  DCWMSG_STA_JOIN,
+  DCWMSG_STA_UNJOIN,
+  DCWMSG_STA_ACK,
+  DCWMSG_STA_NACK,
+  DCWMSG_AP_ACCEPT_STA,
+  DCWMSG_AP_REJECT_STA,
+  DCWMSG_AP_ACK_DISCONNECT,
+  DCWMSG_AP_QUIT,
+};
+
+static unsigned
+batch_slot(const unsigned id) {
+  switch (id) {
+  case DCWMSG_STA_JOIN:           return 0;
+  case DCWMSG_STA_UNJOIN:         return 1;
+  case DCWMSG_STA_ACK:            return 2;
+  case DCWMSG_STA_NACK:           return 3;
+  case DCWMSG_AP_ACCEPT_STA:      return 4;
+  case DCWMSG_AP_REJECT_STA:      return 5;
+  case DCWMSG_AP_ACK_DISCONNECT:  return 6;
+  case DCWMSG_AP_QUIT:            return 7;
+  default:                        return BATCH_SLOT_COUNT - 1;
+  }
+}
+
+/* counting-sorts the chunk's message indices by slot; fills in slot_start[] */
+static void
+batch_group(unsigned char * const slots, const unsigned chunk_len, unsigned char * const order, unsigned * const slot_start) {
+  unsigned slot_pos[BATCH_SLOT_COUNT];
+  unsigned i;
+
+  memset(slot_start, 0, sizeof(unsigned) * (BATCH_SLOT_COUNT + 1));
+  for (i = 0; i < chunk_len; i++) {
+    slot_start[slots[i] + 1]++;
+  }
+  for (i = 0; i < BATCH_SLOT_COUNT; i++) {
+    slot_start[i + 1] += slot_start[i];
+    slot_pos[i] = slot_start[i];
+  }
+  for (i = 0; i < chunk_len; i++) {
+    order[slot_pos[slots[i]]++] = (unsigned char)i;
+  }
+}
+
+/* runs "call" over every message of the current group; j is the message index */
+#define BATCH_GROUP_LOOP(call) \
+  for (i = slot_start[slot]; i < slot_start[slot + 1]; i++) { \
+    j = chunk_base + order[i]; \
+    call; \
+  }
+
+unsigned WIN32_EXPORT
+dcwmsg_marshal_batch(struct dcwmsg * const outputs, const unsigned char * const * const bufs, const unsigned * const buf_lens, int * const results, const unsigned count) {
+  unsigned char slots[BATCH_CHUNK_SIZE];
+  unsigned char order[BATCH_CHUNK_SIZE];
+  unsigned slot_start[BATCH_SLOT_COUNT + 1];
+  unsigned succeeded;
+  unsigned chunk_base;
+  unsigned chunk_len;
+  unsigned slot;
+  unsigned i, j;
+
+  succeeded = 0;
+  for (chunk_base = 0; chunk_base < count; chunk_base += chunk_len) {
+    chunk_len = count - chunk_base;
+    if (chunk_len > BATCH_CHUNK_SIZE) chunk_len = BATCH_CHUNK_SIZE;
+
+    /* classify... empty buffers go in the unknown slot */
+    for (i = 0; i < chunk_len; i++) {
+      j = chunk_base + i;
+      slots[i] = (buf_lens[j] < 1) ? (BATCH_SLOT_COUNT - 1) : batch_slot(bufs[j][0]);
     }
-    fprintf(f, "  Data Channel MAC Address:\n");
-    for (i = 0; i < msg->sta_unjoin.data_macaddr_count; i++) {
-      fprintf(f, "    . ");
-      fprintf_macaddr(f, msg->sta_unjoin.data_macaddrs[i]);
-      fprintf(f, "\n");
+    batch_group(slots, chunk_len, order, slot_start);
+
+    /* marshal each group with its own loop; the id switch runs once per group */
+    for (slot = 0; slot < BATCH_SLOT_COUNT; slot++) {
+      if (slot_start[slot] == slot_start[slot + 1]) continue; /* empty group */
+      if (slot == (BATCH_SLOT_COUNT - 1)) {
+        BATCH_GROUP_LOOP(results[j] = 0); /* empty buffer or unknown id */
+        continue;
+      }
+      BATCH_GROUP_LOOP(outputs[j].id = batch_slot_ids[slot]);
+      switch (batch_slot_ids[slot]) {
+      case DCWMSG_STA_JOIN:           BATCH_GROUP_LOOP(results[j] = dcwmsg_marshal_sta_join(&outputs[j].sta_join, bufs[j] + 1, buf_lens[j] - 1)); break;
+      case DCWMSG_STA_UNJOIN:         BATCH_GROUP_LOOP(results[j] = dcwmsg_marshal_sta_unjoin(&outputs[j].sta_unjoin, bufs[j] + 1, buf_lens[j] - 1)); break;
+      case DCWMSG_STA_ACK:            BATCH_GROUP_LOOP(results[j] = dcwmsg_marshal_sta_ack(&outputs[j].sta_ack, bufs[j] + 1, buf_lens[j] - 1)); break;
+      case DCWMSG_STA_NACK:           BATCH_GROUP_LOOP(results[j] = dcwmsg_marshal_sta_nack(&outputs[j].sta_nack, bufs[j] + 1, buf_lens[j] - 1)); break;
+      case DCWMSG_AP_ACCEPT_STA:      BATCH_GROUP_LOOP(results[j] = dcwmsg_marshal_ap_accept_sta(&outputs[j].ap_accept_sta, bufs[j] + 1, buf_lens[j] - 1)); break;
+      case DCWMSG_AP_REJECT_STA:      BATCH_GROUP_LOOP(results[j] = dcwmsg_marshal_ap_reject_sta(&outputs[j].ap_reject_sta, bufs[j] + 1, buf_lens[j] - 1)); break;
+      default:                        BATCH_GROUP_LOOP(results[j] = 1); break; /* id only */
+      }
     }
-    break;
 
-  case DCWMSG_STA_ACK:
-    fprintf(f, "  Type: Station Acknowledgement\n");
-    fprintf(f, "  Bonded Data Channel Count: %u\n", msg->sta_ack.bonded_data_channel_count);
-    if (msg->sta_ack.bonded_data_channel_count > ELEMENT_COUNT(msg->sta_ack.bonded_data_channels)) {
-      fprintf(f, "  (Count too high)\n");
-      return;
-    }
-    fprintf(f, "  Bonded Data Channels:\n");
-    for (i = 0; i < msg->sta_ack.bonded_data_channel_count; i++) {
-      fprintf(f, "    . ");
-      fprintf_macaddr(f, msg->sta_ack.bonded_data_channels[i].macaddr);
-      fprintf(f, " -> '%.*s'\n", (int)sizeof(msg->sta_ack.bonded_data_channels[i].ssid), msg->sta_ack.bonded_data_channels[i].ssid);
+    for (i = 0; i < chunk_len; i++) {
+      j = chunk_base + i;
+      if (results[j]) succeeded++;
+#ifdef DCWPROTO_STATS
+      /* batched messages are counted like single ones, minus the latency sample */
+      if (results[j]) {
+        dcwstats_hook_marshal_error(bufs[j], buf_lens[j], DCWMSG_OK, 0);
+      } else {
+        unsigned offset;
+        struct dcwmsg scratch;
+        dcwstats_hook_marshal_error(bufs[j], buf_lens[j], dcwmsg_marshal_ex_any(&scratch, bufs[j], buf_lens[j], &offset), 0);
+      }
+#endif
     }
-    break;
+  }
 
-  case DCWMSG_STA_NACK:
-    fprintf(f, "  Type: Station Negative Acknowledgement\n");
-    fprintf(f, "  Data Channel MAC Address Count: %u\n", msg->sta_nack.data_macaddr_count);
-    if (msg->sta_nack.data_macaddr_count > ELEMENT_COUNT(msg->sta_nack.data_macaddrs)) {
-      fprintf(f, "  (Count too high)\n");
-      return;
+  return succeeded;
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_serialize_batch(unsigned char * const * const bufs, const struct dcwmsg * const inputs, const unsigned * const buf_lens, unsigned * const results, const unsigned count) {
+  unsigned char slots[BATCH_CHUNK_SIZE];
+  unsigned char order[BATCH_CHUNK_SIZE];
+  unsigned slot_start[BATCH_SLOT_COUNT + 1];
+  unsigned succeeded;
+  unsigned chunk_base;
+  unsigned chunk_len;
+  unsigned slot;
+  unsigned i, j;
+
+  succeeded = 0;
+  for (chunk_base = 0; chunk_base < count; chunk_base += chunk_len) {
+    chunk_len = count - chunk_base;
+    if (chunk_len > BATCH_CHUNK_SIZE) chunk_len = BATCH_CHUNK_SIZE;
+
+    /* classify... empty buffers go in the unknown slot */
+    for (i = 0; i < chunk_len; i++) {
+      j = chunk_base + i;
+      slots[i] = (buf_lens[j] < 1) ? (BATCH_SLOT_COUNT - 1) : batch_slot((unsigned)inputs[j].id);
     }
-    fprintf(f, "  Data Channel MAC Address:\n");
-    for (i = 0; i < msg->sta_nack.data_macaddr_count; i++) {
-      fprintf(f, "    . ");
-      fprintf_macaddr(f, msg->sta_nack.data_macaddrs[i]);
-      fprintf(f, "\n");
+    batch_group(slots, chunk_len, order, slot_start);
+
+    /* serialize each group with its own loop; the id switch runs once per group */
+    for (slot = 0; slot < BATCH_SLOT_COUNT; slot++) {
+      if (slot_start[slot] == slot_start[slot + 1]) continue; /* empty group */
+      if (slot == (BATCH_SLOT_COUNT - 1)) {
+        BATCH_GROUP_LOOP(results[j] = 0); /* empty buffer or unknown id */
+        continue;
+      }
+      BATCH_GROUP_LOOP(bufs[j][0] = (unsigned char)(unsigned)batch_slot_ids[slot]);
+      switch (batch_slot_ids[slot]) {
+      case DCWMSG_STA_JOIN:           BATCH_GROUP_LOOP(results[j] = dcwmsg_serialize_sta_join(bufs[j] + 1, &inputs[j].sta_join, buf_lens[j] - 1)); break;
+      case DCWMSG_STA_UNJOIN:         BATCH_GROUP_LOOP(results[j] = dcwmsg_serialize_sta_unjoin(bufs[j] + 1, &inputs[j].sta_unjoin, buf_lens[j] - 1)); break;
+      case DCWMSG_STA_ACK:            BATCH_GROUP_LOOP(results[j] = dcwmsg_serialize_sta_ack(bufs[j] + 1, &inputs[j].sta_ack, buf_lens[j] - 1)); break;
+      case DCWMSG_STA_NACK:           BATCH_GROUP_LOOP(results[j] = dcwmsg_serialize_sta_nack(bufs[j] + 1, &inputs[j].sta_nack, buf_lens[j] - 1)); break;
+      case DCWMSG_AP_ACCEPT_STA:      BATCH_GROUP_LOOP(results[j] = dcwmsg_serialize_ap_accept_sta(bufs[j] + 1, &inputs[j].ap_accept_sta, buf_lens[j] - 1)); break;
+      case DCWMSG_AP_REJECT_STA:      BATCH_GROUP_LOOP(results[j] = dcwmsg_serialize_ap_reject_sta(bufs[j] + 1, &inputs[j].ap_reject_sta, buf_lens[j] - 1)); break;
+      default:                        BATCH_GROUP_LOOP(results[j] = 1); continue; /* id only */
+      }
+      BATCH_GROUP_LOOP(if (results[j] != 0) results[j]++); /* count the id byte; 0 means serialize failed */
     }
-    break;
 
-  case DCWMSG_AP_ACCEPT_STA:
-    fprintf(f, "  Type: AP Accept Station\n");
-    fprintf(f, "  Data Channel SSID Count: %u\n", msg->ap_accept_sta.data_ssid_count);
-    if (msg->ap_accept_sta.data_ssid_count > ELEMENT_COUNT(msg->ap_accept_sta.data_ssids)) {
-      fprintf(f, "  (Count too high)\n");
-      return;
-    }
-    fprintf(f, "  Data Channel SSIDs:\n");
-    for (i = 0; i < msg->ap_accept_sta.data_ssid_count; i++) {
-      fprintf(f, "    . %.*s\n", (int)sizeof(msg->ap_accept_sta.data_ssids[i]), msg->ap_accept_sta.data_ssids[i]);
+    for (i = 0; i < chunk_len; i++) {
+      j = chunk_base + i;
+      if (results[j]) succeeded++;
+#ifdef DCWPROTO_STATS
+      /* batched messages are counted like single ones, minus the latency sample */
+      dcwstats_hook_serialize(&inputs[j], buf_lens[j], results[j], 0);
+#endif
     }
-    break;
+  }
+
+  return succeeded;
+}
 
+#undef BATCH_GROUP_LOOP
+
+
+
+
+
+
+
+/*
+
+  Exact-size serialization functions begin here...
+  dcwmsg_serialized_size() walks the input once to compute the exact encoded
+  size; dcwmsg_serialize_exact() checks the output buffer once against that
+  size and then writes every field without further bounds checks.
+
+*/
+unsigned WIN32_EXPORT
+dcwmsg_serialized_size(const struct dcwmsg * const input) {
+  unsigned size;
+  unsigned i;
+
+  switch (input->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
   case DCWMSG_AP_REJECT_STA:
-    fprintf(f, "  Type: AP Reject Station\n");
-    fprintf(f, "  Data Channel MAC Address Count: %u\n", msg->ap_reject_sta.data_macaddr_count);
-    if (msg->ap_reject_sta.data_macaddr_count > ELEMENT_COUNT(msg->ap_reject_sta.data_macaddrs)) {
-      fprintf(f, "  (Count too high)\n");
-      return;
+    /* all four MAC list structs share the same layout */
+    if (input->sta_join.data_macaddr_count > ELEMENT_COUNT(input->sta_join.data_macaddrs)) return 0;
+    return 2 + (input->sta_join.data_macaddr_count * sizeof(dcwmsg_macaddr_t));
+
+  case DCWMSG_STA_ACK:
+    if (input->sta_ack.bonded_data_channel_count > ELEMENT_COUNT(input->sta_ack.bonded_data_channels)) return 0;
+    size = 2;
+    for (i = 0; i < input->sta_ack.bonded_data_channel_count; i++) {
+      size += sizeof(dcwmsg_macaddr_t) + 1;
+      size += strnlen(input->sta_ack.bonded_data_channels[i].ssid, sizeof(input->sta_ack.bonded_data_channels[i].ssid));
     }
-    fprintf(f, "  Data Channel MAC Addresses:\n");
-    for (i = 0; i < msg->ap_reject_sta.data_macaddr_count; i++) {
-      fprintf(f, "    . ");
-      fprintf_macaddr(f, msg->ap_reject_sta.data_macaddrs[i]);
-      fprintf(f, "\n");
+    return size;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    if (input->ap_accept_sta.data_ssid_count > ELEMENT_COUNT(input->ap_accept_sta.data_ssids)) return 0;
+    size = 2;
+    for (i = 0; i < input->ap_accept_sta.data_ssid_count; i++) {
+      size += 1 + strnlen(input->ap_accept_sta.data_ssids[i], sizeof(input->ap_accept_sta.data_ssids[i]));
     }
-    break;
+    return size;
 
   case DCWMSG_AP_ACK_DISCONNECT:
-    fprintf(f, "  Type: AP ACK Station Disconnect\n");
-    break;
-
   case DCWMSG_AP_QUIT:
-    fprintf(f, "  Type: AP Quit\n");
-    break;
+    return 1; /* this message is id only */
 
   default:
-    fprintf(f, "  Type: Unknown\n");
+    return 0; /* unknown message id */
+  }
+}
+
+static unsigned char *
+dcwmsg_serialize_unchecked_macaddrs(unsigned char *buf, const unsigned count, const dcwmsg_macaddr_t * const macaddrs) {
+  (*buf++) = (unsigned char)count;
+  memcpy(buf, macaddrs, count * sizeof(dcwmsg_macaddr_t));
+  return buf + (count * sizeof(dcwmsg_macaddr_t));
+}
+
+static unsigned char *
+dcwmsg_serialize_unchecked_sta_ack(unsigned char *buf, const struct dcwmsg_sta_ack * const input) {
+  unsigned copy_size;
+  unsigned i;
+
+  (*buf++) = (unsigned char)input->bonded_data_channel_count;
+  for (i = 0; i < input->bonded_data_channel_count; i++) {
+    memcpy(buf, input->bonded_data_channels[i].macaddr, sizeof(input->bonded_data_channels[i].macaddr));
+    buf += sizeof(input->bonded_data_channels[i].macaddr);
+
+    copy_size = strnlen(input->bonded_data_channels[i].ssid, sizeof(input->bonded_data_channels[i].ssid));
+    (*buf++) = (unsigned char)copy_size;
+    memcpy(buf, input->bonded_data_channels[i].ssid, copy_size);
+    buf += copy_size;
+  }
+  return buf;
+}
+
+static unsigned char *
+dcwmsg_serialize_unchecked_ap_accept_sta(unsigned char *buf, const struct dcwmsg_ap_accept_sta * const input) {
+  unsigned copy_size;
+  unsigned i;
+
+  (*buf++) = (unsigned char)input->data_ssid_count;
+  for (i = 0; i < input->data_ssid_count; i++) {
+    copy_size = strnlen(input->data_ssids[i], sizeof(input->data_ssids[i]));
+    (*buf++) = (unsigned char)copy_size;
+    memcpy(buf, input->data_ssids[i], copy_size);
+    buf += copy_size;
+  }
+  return buf;
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_serialize_exact(unsigned char * const buf, const struct dcwmsg * const input, const unsigned buf_len) {
+  unsigned size;
+
+  /* the one and only output size check... */
+  size = dcwmsg_serialized_size(input);
+  if ((size == 0) || (buf_len < size)) return 0; /* serialize failed */
+
+  buf[0] = (unsigned char)(unsigned)input->id;
+
+  switch (input->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    dcwmsg_serialize_unchecked_macaddrs(buf + 1, input->sta_join.data_macaddr_count, input->sta_join.data_macaddrs);
+    break;
+  case DCWMSG_STA_ACK:
+    dcwmsg_serialize_unchecked_sta_ack(buf + 1, &input->sta_ack);
+    break;
+  case DCWMSG_AP_ACCEPT_STA:
+    dcwmsg_serialize_unchecked_ap_accept_sta(buf + 1, &input->ap_accept_sta);
     break;
+  default:
+    break; /* id only */
   }
+
+  return size;
+}
+
+
+
+
+
+
+
+/*
+
+  Diagnostic functions begin here...
+  The dump is rendered by dcwmsg_format() and written with a single call, so
+  concurrent dumps from different threads don't interleave line by line.
+
+*/
+void WIN32_EXPORT
+dcwmsg_dbgdump(const struct dcwmsg * const msg) {
+  char text[4096];
+  unsigned text_len;
+
+  text_len = dcwmsg_format(text, sizeof(text), msg, DCWMSG_FORMAT_DUMP);
+  if (text_len >= sizeof(text)) text_len = sizeof(text) - 1;
+  fwrite(text, 1, text_len, stderr);
 }
 
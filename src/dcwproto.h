@@ -27,21 +27,42 @@
 #define WIN32_EXPORT
 #endif
 
+#include <stddef.h>
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+  Thread safety...
+  The codec functions (marshal, serialize, views, peek, compact, batch,
+  container, extended, validate, format) keep no state of their own: they
+  only touch their arguments, so any number of threads may call them at
+  once on different buffers. Objects (pools, SSID pools, station tables,
+  journals, endpoints and codec contexts) are owned by the caller and are
+  not locked; use each from one thread at a time. The only process-wide
+  state is the optional dcwstats instrumentation, which counts per thread.
+  dcwmsg_dbgdump() writes to the shared stderr; use dcwproto_ctx_format()
+  or dcwmsg_format() to render from several threads. Every codec call has a
+  dcwproto_ctx_* variant that applies a context's limits and counters
+  instead; the objects keep their state in themselves and take no context.
+*/
+
+#define DCWMSG_MAX_ENTRIES   32 /* max MACs / SSIDs / bonded channels per message */
+#define DCWMSG_MAX_SERIALIZED_SIZE (2 + (DCWMSG_MAX_ENTRIES * (6 + 1 + 32))) /* largest encoding (full STA_ACK) */
+
 typedef unsigned char dcwmsg_macaddr_t[6];
 typedef char          dcwmsg_ssid_t[32];
 
 struct dcwmsg_sta_join {
   unsigned            data_macaddr_count;
-  dcwmsg_macaddr_t    data_macaddrs[32];
+  dcwmsg_macaddr_t    data_macaddrs[DCWMSG_MAX_ENTRIES];
 };
 
 struct dcwmsg_sta_unjoin {
   unsigned            data_macaddr_count;
-  dcwmsg_macaddr_t    data_macaddrs[32];
+  dcwmsg_macaddr_t    data_macaddrs[DCWMSG_MAX_ENTRIES];
 };
 
 
@@ -50,24 +71,24 @@ struct dcwmsg_sta_ack {
   struct {
     dcwmsg_macaddr_t macaddr;
     dcwmsg_ssid_t    ssid;
-  } bonded_data_channels[32];
+  } bonded_data_channels[DCWMSG_MAX_ENTRIES];
 };
 
 struct dcwmsg_sta_nack {
   unsigned            data_macaddr_count;
-  dcwmsg_macaddr_t    data_macaddrs[32];
+  dcwmsg_macaddr_t    data_macaddrs[DCWMSG_MAX_ENTRIES];
 };
 
 
 
 struct dcwmsg_ap_accept_sta {
   unsigned            data_ssid_count;
-  dcwmsg_ssid_t       data_ssids[32];
+  dcwmsg_ssid_t       data_ssids[DCWMSG_MAX_ENTRIES];
 };
 
 struct dcwmsg_ap_reject_sta {
   unsigned            data_macaddr_count;
-  dcwmsg_macaddr_t    data_macaddrs[32];
+  dcwmsg_macaddr_t    data_macaddrs[DCWMSG_MAX_ENTRIES];
 };
 
 
@@ -104,6 +125,378 @@ unsigned WIN32_EXPORT dcwmsg_serialize(unsigned char * const /* buf */, const st
 void WIN32_EXPORT dcwmsg_dbgdump(const struct dcwmsg * const /* msg */);
 
 
+/*
+  Marshal with a reason...
+  Same as dcwmsg_marshal() but says why a message was rejected, in the same
+  single pass. On success "*offset" is the number of bytes the message used
+  (any trailing bytes are not part of it); on failure it is the offset of the
+  field that failed: the id byte, a count byte, an SSID length byte, or the
+  first field that runs past the end of the buffer.
+*/
+enum dcwmsg_error {
+  DCWMSG_OK                 = 0,
+  DCWMSG_ERR_TRUNCATED      = 1,
+  DCWMSG_ERR_COUNT_TOO_BIG  = 2,
+  DCWMSG_ERR_SSID_TOO_LONG  = 3,
+  DCWMSG_ERR_UNKNOWN_ID     = 4,
+};
+
+enum dcwmsg_error WIN32_EXPORT dcwmsg_marshal_ex(struct dcwmsg * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */, unsigned * const /* offset */);
+const char * WIN32_EXPORT dcwmsg_strerror(const enum dcwmsg_error /* error */);
+
+
+/*
+  Zero-copy message views...
+  dcwmsg_view_init() validates the wire bytes in a single pass (a known id,
+  at most DCWMSG_MAX_ENTRIES entries, SSIDs of at most 32 bytes and every
+  entry present) and the view then points straight into the caller's buffer.
+  The buffer must outlive the view. Nothing is copied and no SSID is
+  NUL-terminated; use ssid_len.
+*/
+struct dcwmsg_view {
+  enum dcwmsg_id        id;
+  unsigned              count;    /* entry count (0 for id-only messages) */
+  const unsigned char  *entries;  /* first entry byte on the wire */
+  unsigned              length;   /* total encoded length including the id byte */
+};
+
+struct dcwmsg_view_entry {
+  const unsigned char  *macaddr;  /* NULL for DCWMSG_AP_ACCEPT_STA */
+  const char           *ssid;     /* NULL for MAC-only messages */
+  unsigned              ssid_len;
+};
+
+struct dcwmsg_view_iter {
+  const struct dcwmsg_view  *view;
+  const unsigned char       *pos;
+  unsigned                   index;
+};
+
+int WIN32_EXPORT dcwmsg_view_init(struct dcwmsg_view * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+const unsigned char * WIN32_EXPORT dcwmsg_view_macaddr(const struct dcwmsg_view * const /* view */, const unsigned /* index */);
+void WIN32_EXPORT dcwmsg_view_iter_init(struct dcwmsg_view_iter * const /* iter */, const struct dcwmsg_view * const /* view */);
+int WIN32_EXPORT dcwmsg_view_iter_next(struct dcwmsg_view_iter * const /* iter */, struct dcwmsg_view_entry * const /* output */);
+int WIN32_EXPORT dcwmsg_view_marshal(struct dcwmsg * const /* output */, const struct dcwmsg_view * const /* view */);
+
+/*
+  Classification only: validates the message like dcwmsg_view_init() and
+  returns its id, entry count and total encoded length, touching nothing but
+  the count and length bytes. Any output pointer may be NULL.
+*/
+int WIN32_EXPORT dcwmsg_peek(const unsigned char * const /* buf */, const unsigned /* buf_len */, enum dcwmsg_id * const /* id */, unsigned * const /* count */, unsigned * const /* length */);
+
+
+/*
+  Container frames...
+  Several messages in one datagram: DCWMSG_CONTAINER, a message count, then
+  each message prefixed by its 2-byte big-endian length. Peers that predate
+  containers drop them as an unknown id, so only send them to peers known to
+  accept them.
+  dcwmsg_container_pack() fills one frame of at most buf_len bytes (e.g. the
+  path MTU payload) from the front of "inputs" and sets "*packed" to how many
+  it took; it stops early at an invalid message. When only one message fits
+  it is written plain, without the container framing. Returns the frame
+  size, 0 if not even inputs[0] could be written.
+  The iterator takes a container frame or a plain message, checks the
+  framing once and then hands out each message in place.
+*/
+#define DCWMSG_CONTAINER            0xC0 /* id byte; not part of enum dcwmsg_id */
+#define DCWMSG_CONTAINER_MAX_COUNT  255
+
+struct dcwmsg_container_iter {
+  const unsigned char  *pos;
+  unsigned              remaining;  /* messages not yet returned */
+  unsigned              plain_len;  /* non-zero when the frame is a single plain message */
+};
+
+unsigned WIN32_EXPORT dcwmsg_container_pack(unsigned char * const /* buf */, const unsigned /* buf_len */, const struct dcwmsg * const /* inputs */, const unsigned /* count */, unsigned * const /* packed */);
+int WIN32_EXPORT dcwmsg_container_iter_init(struct dcwmsg_container_iter * const /* iter */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+int WIN32_EXPORT dcwmsg_container_iter_next(struct dcwmsg_container_iter * const /* iter */, const unsigned char ** const /* msg */, unsigned * const /* msg_len */);
+
+
+/*
+  Extended encoding (v1)...
+  For peers that have opted in, a message may carry up to
+  DCWMSG_EXT_MAX_ENTRIES entries: DCWMSG_EXT_V1, the message id, the entry
+  count as a varint (7 bits per byte, low bits first, minimal length) and
+  the entries exactly as in the legacy encoding. ID-only messages have no
+  count. SSIDs carry an explicit length and are never NUL terminated.
+
+  Entries live in storage owned by the struct, which grows as needed: start
+  with dcwmsg_ext_init(), reuse the struct across messages to keep the
+  storage, and release it with dcwmsg_ext_free(). dcwmsg_ext_marshal() also
+  accepts legacy messages, so one receive path can handle both.
+
+  Negotiation: send dcwmsg_ext_hello() to each peer (legacy peers drop it as
+  an unknown id) and pass every received frame to dcwmsg_ext_peer_observe(),
+  which returns 1 for a hello that needs no further handling. Peers whose
+  version is still 0 get legacy messages: dcwmsg_ext_split() copies up to
+  DCWMSG_MAX_ENTRIES entries starting at "first" into a struct dcwmsg and
+  returns how many it took, so
+    first = 0;
+    do {
+      first += dcwmsg_ext_split(&legacy, &ext, first);
+      ... dcwmsg_serialize(buf, &legacy, sizeof(buf)) ...
+    } while (first < ext.count);
+  sends an extended message as legacy ones.
+*/
+#define DCWMSG_EXT_V1           0xE1 /* first byte of an extended message */
+#define DCWMSG_EXT_HELLO        0x00 /* message id of a hello; not part of enum dcwmsg_id */
+#define DCWMSG_EXT_VERSION      1
+#define DCWMSG_EXT_MAX_ENTRIES  65535
+
+struct dcwmsg_ext_bonded_data_channel {
+  dcwmsg_macaddr_t    macaddr;
+  unsigned char       ssid_len;
+  dcwmsg_ssid_t       ssid;
+};
+
+struct dcwmsg_ext_ssid {
+  unsigned char       len;
+  dcwmsg_ssid_t       ssid;
+};
+
+struct dcwmsg_ext {
+  enum dcwmsg_id      id;
+  unsigned            count;
+  union {
+    dcwmsg_macaddr_t                        *macaddrs;              /* STA_JOIN, STA_UNJOIN, STA_NACK, AP_REJECT_STA */
+    struct dcwmsg_ext_bonded_data_channel   *bonded_data_channels;  /* STA_ACK */
+    struct dcwmsg_ext_ssid                  *ssids;                 /* AP_ACCEPT_STA */
+    void                                    *storage;
+  };
+  unsigned long       storage_size;  /* bytes */
+};
+
+struct dcwmsg_ext_peer {
+  unsigned            version;  /* 0 until the peer is known to accept extended messages */
+};
+
+void WIN32_EXPORT dcwmsg_ext_init(struct dcwmsg_ext * const /* msg */);
+void WIN32_EXPORT dcwmsg_ext_free(struct dcwmsg_ext * const /* msg */);
+int WIN32_EXPORT dcwmsg_ext_reserve(struct dcwmsg_ext * const /* msg */, const enum dcwmsg_id /* id */, const unsigned /* count */); /* sets id and count, sizes the storage */
+int WIN32_EXPORT dcwmsg_ext_marshal(struct dcwmsg_ext * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwmsg_ext_serialized_size(const struct dcwmsg_ext * const /* input */);
+unsigned WIN32_EXPORT dcwmsg_ext_serialize(unsigned char * const /* buf */, const struct dcwmsg_ext * const /* input */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwmsg_ext_split(struct dcwmsg * const /* output */, const struct dcwmsg_ext * const /* input */, const unsigned /* first */);
+
+unsigned WIN32_EXPORT dcwmsg_ext_hello(unsigned char * const /* buf */, const unsigned /* buf_len */);
+void WIN32_EXPORT dcwmsg_ext_peer_init(struct dcwmsg_ext_peer * const /* peer */);
+int WIN32_EXPORT dcwmsg_ext_peer_observe(struct dcwmsg_ext_peer * const /* peer */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+
+
+/*
+  Compact messages...
+  A small header followed by the entries packed exactly as they appear on the
+  wire, so a one-MAC STA_JOIN takes 10 bytes instead of sizeof(struct dcwmsg).
+  Allocate DCWMSG_COMPACT_HEADER_SIZE plus the entry bytes (at most
+  DCWMSG_COMPACT_MAX_SIZE); each function returns the number of bytes used
+  (or written), 0 on failure. Use dcwmsg_compact_view() to walk the entries;
+  it, dcwmsg_compact_unpack() and dcwmsg_compact_serialize() validate the
+  header and entries the same way dcwmsg_view_init() validates wire bytes.
+*/
+struct dcwmsg_compact {
+  unsigned char   id;
+  unsigned char   count;
+  unsigned short  entries_len;
+#ifndef __cplusplus
+  unsigned char   entries[];  /* entries_len bytes */
+#else
+  unsigned char   entries[1]; /* really entries_len bytes; C++ has no flexible array members */
+#endif
+};
+
+#define DCWMSG_COMPACT_HEADER_SIZE  (offsetof(struct dcwmsg_compact, entries))
+#define DCWMSG_COMPACT_MAX_SIZE     (DCWMSG_COMPACT_HEADER_SIZE + DCWMSG_MAX_SERIALIZED_SIZE - 2)
+
+unsigned WIN32_EXPORT dcwmsg_compact_marshal(struct dcwmsg_compact * const /* output */, const unsigned /* output_size */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwmsg_compact_serialize(unsigned char * const /* buf */, const struct dcwmsg_compact * const /* input */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwmsg_compact_pack(struct dcwmsg_compact * const /* output */, const unsigned /* output_size */, const struct dcwmsg * const /* input */);
+int WIN32_EXPORT dcwmsg_compact_unpack(struct dcwmsg * const /* output */, const struct dcwmsg_compact * const /* input */);
+int WIN32_EXPORT dcwmsg_compact_view(struct dcwmsg_view * const /* output */, const struct dcwmsg_compact * const /* input */);
+
+
+/*
+  Batch entry points...
+  Process "count" messages at once, grouping them by message id internally.
+  Per-message status goes to results[] (same meaning as the single message
+  return values); the return value is the number of messages that succeeded.
+*/
+unsigned WIN32_EXPORT dcwmsg_marshal_batch(struct dcwmsg * const /* outputs */, const unsigned char * const * const /* bufs */, const unsigned * const /* buf_lens */, int * const /* results */, const unsigned /* count */);
+unsigned WIN32_EXPORT dcwmsg_serialize_batch(unsigned char * const * const /* bufs */, const struct dcwmsg * const /* inputs */, const unsigned * const /* buf_lens */, unsigned * const /* results */, const unsigned /* count */);
+
+#ifdef __linux__
+/* recvmmsg()/sendmmsg() variants; dcwmsg_serialize_mmsg() trims each iov_len to the serialized size */
+struct mmsghdr;
+unsigned dcwmsg_marshal_mmsg(struct dcwmsg * const /* outputs */, const struct mmsghdr * const /* msgs */, int * const /* results */, const unsigned /* count */);
+unsigned dcwmsg_serialize_mmsg(struct mmsghdr * const /* msgs */, const struct dcwmsg * const /* inputs */, unsigned * const /* results */, const unsigned /* count */);
+#endif
+
+
+/*
+  Exact-size serialization...
+  dcwmsg_serialized_size() returns the exact number of bytes dcwmsg_serialize()
+  will produce (0 if the message is invalid). dcwmsg_serialize_exact() checks
+  buf_len once up front, so on failure nothing is written.
+*/
+unsigned WIN32_EXPORT dcwmsg_serialized_size(const struct dcwmsg * const /* input */);
+unsigned WIN32_EXPORT dcwmsg_serialize_exact(unsigned char * const /* buf */, const struct dcwmsg * const /* input */, const unsigned /* buf_len */);
+
+
+/*
+  Allocation-free text rendering...
+  Renders "msg" into "buf" without stdio: DCWMSG_FORMAT_LINE is a compact
+  single line, DCWMSG_FORMAT_JSON a single JSON object and DCWMSG_FORMAT_DUMP
+  the multi-line text of dcwmsg_dbgdump(). Like snprintf(), the output is
+  always NUL terminated and the return value is the full rendered length,
+  so a return value >= buf_len means it was truncated.
+*/
+enum dcwmsg_format_mode {
+  DCWMSG_FORMAT_LINE = 0,
+  DCWMSG_FORMAT_JSON = 1,
+  DCWMSG_FORMAT_DUMP = 2,
+};
+
+unsigned WIN32_EXPORT dcwmsg_format(char * const /* buf */, const unsigned /* buf_len */, const struct dcwmsg * const /* msg */, const enum dcwmsg_format_mode /* mode */);
+
+
+/*
+  Data channel MAC address validation...
+  DCWMSG_VALIDATE_ADDRESSES rejects multicast, broadcast and all-zero MAC
+  addresses; DCWMSG_VALIDATE_DUPLICATES rejects a MAC address appearing twice
+  in one message. Each returns 1 if valid. dcwmsg_marshal_validated() is
+  dcwmsg_marshal() with the checks done on the wire bytes before any copy.
+*/
+#define DCWMSG_VALIDATE_ADDRESSES   0x01
+#define DCWMSG_VALIDATE_DUPLICATES  0x02
+
+int WIN32_EXPORT dcwmsg_validate_macaddrs(const unsigned char * const /* macaddrs */, const unsigned /* count */, const unsigned /* flags */);
+int WIN32_EXPORT dcwmsg_validate_view(const struct dcwmsg_view * const /* view */, const unsigned /* flags */);
+int WIN32_EXPORT dcwmsg_marshal_validated(struct dcwmsg * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */, const unsigned /* flags */);
+
+
+/*
+  Message/buffer pools...
+  Pre-allocates "msg_count" message structs and "buf_count" output buffers of
+  DCWMSG_MAX_SERIALIZED_SIZE bytes each. get returns NULL once exhausted;
+  reset returns every slot at once (e.g. at the end of an event loop pass).
+  put ignores pointers that did not come from the pool and puts into a pool
+  whose slots are all free already; it cannot catch every double put.
+  Pools are not locked; use one pool per thread.
+*/
+struct dcwmsg_pool;
+
+struct dcwmsg_pool * WIN32_EXPORT dcwmsg_pool_create(const unsigned /* msg_count */, const unsigned /* buf_count */);
+void WIN32_EXPORT dcwmsg_pool_destroy(struct dcwmsg_pool * const /* pool */);
+void WIN32_EXPORT dcwmsg_pool_reset(struct dcwmsg_pool * const /* pool */);
+struct dcwmsg * WIN32_EXPORT dcwmsg_pool_get_msg(struct dcwmsg_pool * const /* pool */);
+void WIN32_EXPORT dcwmsg_pool_put_msg(struct dcwmsg_pool * const /* pool */, struct dcwmsg * const /* msg */);
+unsigned char * WIN32_EXPORT dcwmsg_pool_get_buf(struct dcwmsg_pool * const /* pool */);
+void WIN32_EXPORT dcwmsg_pool_put_buf(struct dcwmsg_pool * const /* pool */, unsigned char * const /* buf */);
+
+
+/*
+  Codec contexts...
+  One per worker thread: the configuration, counters and scratch space that
+  thread's codec calls use. The dcwproto_ctx_* functions read and write
+  nothing outside their context and arguments (no dcwstats either), and a
+  context is cache line aligned, so workers with a context each need no
+  locks and don't share cache lines.
+
+  max_entries caps the entries per message (0 for DCWMSG_MAX_ENTRIES) and
+  ext_max_entries those per extended message (0 for DCWMSG_EXT_MAX_ENTRIES;
+  checked after decoding), validate_flags (DCWMSG_VALIDATE_*) is applied to
+  every message marshaled or serialized, and strict_length rejects input
+  with bytes after the message. Counters only ever go up; diff two
+  snapshots for rates. The context counters are the per-thread statistics:
+  the process-wide dcwstats build option never sees context calls.
+
+  Reads (view, marshal, peek, container_next, ext_marshal, compact_marshal)
+  count under marshal, writes (serialize, container_pack, ext_serialize,
+  compact_pack) under serialize, and bytes are always wire bytes.
+*/
+struct dcwproto_ctx_config {
+  unsigned  max_entries;
+  unsigned  validate_flags;
+  int       strict_length;
+  unsigned  ext_max_entries;
+};
+
+struct dcwproto_ctx_counters {
+  unsigned long long  messages;     /* successful calls */
+  unsigned long long  bytes;        /* wire bytes read or written */
+  unsigned long long  malformed;    /* marshal: bad wire format; serialize: bad message or buffer too small */
+  unsigned long long  over_limit;   /* more than max_entries entries */
+  unsigned long long  invalid;      /* rejected by validate_flags */
+  unsigned long long  trailing;     /* marshal: bytes after the message with strict_length */
+};
+
+struct dcwproto_ctx_stats {
+  struct dcwproto_ctx_counters  marshal;
+  struct dcwproto_ctx_counters  serialize;
+};
+
+#define DCWPROTO_CTX_TEXT_SIZE 8192 /* dcwproto_ctx_format() output, NUL included */
+
+struct dcwproto_ctx;
+
+void WIN32_EXPORT dcwproto_ctx_config_init(struct dcwproto_ctx_config * const /* config */); /* the defaults: no limits or validation beyond the format */
+struct dcwproto_ctx * WIN32_EXPORT dcwproto_ctx_create(const struct dcwproto_ctx_config * const /* config */); /* NULL config for the defaults */
+void WIN32_EXPORT dcwproto_ctx_destroy(struct dcwproto_ctx * const /* ctx */);
+
+/* dcwmsg_view_init() / dcwmsg_marshal() / dcwmsg_serialize() under the context's configuration; a failed serialize may have written to buf */
+int WIN32_EXPORT dcwproto_ctx_view(struct dcwproto_ctx * const /* ctx */, struct dcwmsg_view * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+int WIN32_EXPORT dcwproto_ctx_marshal(struct dcwproto_ctx * const /* ctx */, struct dcwmsg * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwproto_ctx_serialize(struct dcwproto_ctx * const /* ctx */, unsigned char * const /* buf */, const struct dcwmsg * const /* input */, const unsigned /* buf_len */);
+
+/* dcwmsg_peek() after the full dcwproto_ctx_view() checks */
+int WIN32_EXPORT dcwproto_ctx_peek(struct dcwproto_ctx * const /* ctx */, const unsigned char * const /* buf */, const unsigned /* buf_len */, enum dcwmsg_id * const /* id */, unsigned * const /* count */, unsigned * const /* length */);
+
+/* max_entries and validate_flags on a view made elsewhere; only a rejection is counted (under marshal) */
+int WIN32_EXPORT dcwproto_ctx_validate(struct dcwproto_ctx * const /* ctx */, const struct dcwmsg_view * const /* view */);
+
+/*
+  dcwproto_ctx_container_pack() stops at the first message the context
+  rejects, as dcwmsg_container_pack() stops at an invalid one, so
+  inputs[*packed] is the one to look at. dcwproto_ctx_container_next()
+  returns 1 with the next message's view, 0 at the end of the frame, or -1
+  for a message the context rejected (carry on to the next one).
+*/
+unsigned WIN32_EXPORT dcwproto_ctx_container_pack(struct dcwproto_ctx * const /* ctx */, unsigned char * const /* buf */, const unsigned /* buf_len */, const struct dcwmsg * const /* inputs */, const unsigned /* count */, unsigned * const /* packed */);
+int WIN32_EXPORT dcwproto_ctx_container_next(struct dcwproto_ctx * const /* ctx */, struct dcwmsg_container_iter * const /* iter */, struct dcwmsg_view * const /* output */);
+
+/* dcwmsg_ext_marshal() / dcwmsg_ext_serialize(); legacy input gets the dcwproto_ctx_view() checks */
+int WIN32_EXPORT dcwproto_ctx_ext_marshal(struct dcwproto_ctx * const /* ctx */, struct dcwmsg_ext * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwproto_ctx_ext_serialize(struct dcwproto_ctx * const /* ctx */, unsigned char * const /* buf */, const struct dcwmsg_ext * const /* input */, const unsigned /* buf_len */);
+
+/* dcwmsg_compact_marshal() / dcwmsg_compact_pack(); an output_size that is too small is not counted */
+unsigned WIN32_EXPORT dcwproto_ctx_compact_marshal(struct dcwproto_ctx * const /* ctx */, struct dcwmsg_compact * const /* output */, const unsigned /* output_size */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwproto_ctx_compact_pack(struct dcwproto_ctx * const /* ctx */, struct dcwmsg_compact * const /* output */, const unsigned /* output_size */, const struct dcwmsg * const /* input */);
+
+/* renders into the context's text buffer (valid until the next call); truncated at DCWPROTO_CTX_TEXT_SIZE */
+const char * WIN32_EXPORT dcwproto_ctx_format(struct dcwproto_ctx * const /* ctx */, const struct dcwmsg * const /* msg */, const enum dcwmsg_format_mode /* mode */);
+
+/* scratch owned by the context: a message, and a buffer of DCWMSG_MAX_SERIALIZED_SIZE bytes */
+struct dcwmsg * WIN32_EXPORT dcwproto_ctx_msg(struct dcwproto_ctx * const /* ctx */);
+unsigned char * WIN32_EXPORT dcwproto_ctx_buf(struct dcwproto_ctx * const /* ctx */);
+
+void WIN32_EXPORT dcwproto_ctx_snapshot(const struct dcwproto_ctx * const /* ctx */, struct dcwproto_ctx_stats * const /* output */);
+
+#ifndef WIN32
+/*
+  Scatter-gather serialization for sendmsg()...
+  Fills at most DCWMSG_SERIALIZE_IOV_MAX iovecs and returns how many were used
+  (0 on failure). Headers and length bytes go into the caller's scratch area;
+  MAC arrays are referenced in place, so "input" must outlive the send. The
+  scratch area needs 2 bytes for MAC list messages and
+  dcwmsg_serialized_size() bytes for the others.
+*/
+#define DCWMSG_SERIALIZE_IOV_MAX 2
+struct iovec;
+unsigned dcwmsg_serialize_iov(struct iovec * const /* iov */, const unsigned /* iov_len */, unsigned char * const /* scratch */, const unsigned /* scratch_len */, const struct dcwmsg * const /* input */);
+#endif
+
+
 #ifdef __cplusplus
 }; //extern "C" {
 #endif
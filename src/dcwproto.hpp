@@ -0,0 +1,330 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWPROTO_HPP_INCLUDED
+#define DCWPROTO_HPP_INCLUDED
+
+/*
+  Header-only C++17 codec...
+  One strongly typed struct per message id with constexpr wire layout traits;
+  dcw::encode<T>() / dcw::decode<T>() are resolved at compile time, so there
+  is no id switch and no union. The wire format is byte-for-byte the one
+  produced and accepted by dcwmsg_serialize() / dcwmsg_marshal(): like the C
+  serializer, encode<T>() writes an SSID only up to its first NUL byte.
+*/
+
+#include <dcwproto.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#if __has_include(<span>)
+#include <span>
+#endif
+
+namespace dcw {
+
+/* minimal byte range; converts from std::span when built as C++20 */
+template <typename Byte>
+struct byte_range {
+  Byte        *data = nullptr;
+  std::size_t  size = 0;
+
+  constexpr byte_range() = default;
+  constexpr byte_range(Byte * const d, const std::size_t s) : data(d), size(s) {}
+  template <std::size_t N>
+  constexpr byte_range(Byte (&arr)[N]) : data(arr), size(N) {}
+#if defined(__cpp_lib_span)
+  template <std::size_t E>
+  constexpr byte_range(std::span<Byte, E> s) : data(s.data()), size(s.size()) {}
+#endif
+};
+using const_bytes   = byte_range<const unsigned char>;
+using mutable_bytes = byte_range<unsigned char>;
+
+using macaddr = std::array<unsigned char, 6>;
+
+struct ssid {
+  std::size_t           len = 0;
+  std::array<char, 32>  chars{};
+
+  constexpr std::string_view view() const { return std::string_view(chars.data(), len); }
+
+  /* the bytes encode<T>() writes: stops at the first NUL, as strnlen() does in dcwmsg_serialize() */
+  constexpr std::size_t wire_len() const {
+    std::size_t n = 0;
+    while ((n < len) && (n < chars.size()) && (chars[n] != '\0')) n++;
+    return n;
+  }
+};
+
+
+
+/*
+  Message types...
+*/
+template <dcwmsg_id Id>
+struct macaddr_list {
+  static constexpr dcwmsg_id id = Id;
+  std::size_t                               count = 0;
+  std::array<macaddr, DCWMSG_MAX_ENTRIES>   macaddrs{};
+};
+
+struct sta_join       : macaddr_list<DCWMSG_STA_JOIN> {};
+struct sta_unjoin     : macaddr_list<DCWMSG_STA_UNJOIN> {};
+struct sta_nack       : macaddr_list<DCWMSG_STA_NACK> {};
+struct ap_reject_sta  : macaddr_list<DCWMSG_AP_REJECT_STA> {};
+
+struct sta_ack {
+  static constexpr dcwmsg_id id = DCWMSG_STA_ACK;
+  struct bonded_data_channel {
+    dcw::macaddr  macaddr{};
+    dcw::ssid     ssid{};
+  };
+  std::size_t                                           count = 0;
+  std::array<bonded_data_channel, DCWMSG_MAX_ENTRIES>   bonded_data_channels{};
+};
+
+struct ap_accept_sta {
+  static constexpr dcwmsg_id id = DCWMSG_AP_ACCEPT_STA;
+  std::size_t                             count = 0;
+  std::array<ssid, DCWMSG_MAX_ENTRIES>    data_ssids{};
+};
+
+struct ap_ack_disconnect { static constexpr dcwmsg_id id = DCWMSG_AP_ACK_DISCONNECT; };
+struct ap_quit           { static constexpr dcwmsg_id id = DCWMSG_AP_QUIT; };
+
+
+
+/*
+  Wire layout traits...
+  entry_size is the fixed per-entry size, or 0 when entries carry an SSID
+  length byte and are therefore variable.
+*/
+template <typename T, typename = void>
+struct wire_traits;
+
+template <typename T>
+struct wire_traits<T, std::enable_if_t<std::is_base_of_v<macaddr_list<T::id>, T>>> {
+  static constexpr dcwmsg_id    id          = T::id;
+  static constexpr bool         has_count   = true;
+  static constexpr std::size_t  entry_size  = sizeof(macaddr);
+  static constexpr std::size_t  max_size    = 2 + (DCWMSG_MAX_ENTRIES * entry_size);
+};
+
+template <>
+struct wire_traits<sta_ack> {
+  static constexpr dcwmsg_id    id          = DCWMSG_STA_ACK;
+  static constexpr bool         has_count   = true;
+  static constexpr std::size_t  entry_size  = 0;
+  static constexpr std::size_t  max_size    = 2 + (DCWMSG_MAX_ENTRIES * (sizeof(macaddr) + 1 + 32));
+};
+
+template <>
+struct wire_traits<ap_accept_sta> {
+  static constexpr dcwmsg_id    id          = DCWMSG_AP_ACCEPT_STA;
+  static constexpr bool         has_count   = true;
+  static constexpr std::size_t  entry_size  = 0;
+  static constexpr std::size_t  max_size    = 2 + (DCWMSG_MAX_ENTRIES * (1 + 32));
+};
+
+template <>
+struct wire_traits<ap_ack_disconnect> {
+  static constexpr dcwmsg_id    id          = DCWMSG_AP_ACK_DISCONNECT;
+  static constexpr bool         has_count   = false;
+  static constexpr std::size_t  entry_size  = 0;
+  static constexpr std::size_t  max_size    = 1;
+};
+
+template <>
+struct wire_traits<ap_quit> {
+  static constexpr dcwmsg_id    id          = DCWMSG_AP_QUIT;
+  static constexpr bool         has_count   = false;
+  static constexpr std::size_t  entry_size  = 0;
+  static constexpr std::size_t  max_size    = 1;
+};
+
+static_assert(wire_traits<sta_ack>::max_size == DCWMSG_MAX_SERIALIZED_SIZE, "STA_ACK is the largest encoding");
+
+
+
+/*
+  Encoded size...
+*/
+template <typename T>
+inline std::size_t
+encoded_size(const T &msg) {
+  using traits = wire_traits<T>;
+  if constexpr (!traits::has_count) {
+    (void)msg;
+    return 1;
+  }
+  else if constexpr (traits::entry_size != 0) {
+    if (msg.count > DCWMSG_MAX_ENTRIES) return 0;
+    return 2 + (msg.count * traits::entry_size);
+  }
+  else if constexpr (std::is_same_v<T, sta_ack>) {
+    if (msg.count > DCWMSG_MAX_ENTRIES) return 0;
+    std::size_t size = 2;
+    for (std::size_t i = 0; i < msg.count; i++) {
+      if (msg.bonded_data_channels[i].ssid.len > 32) return 0;
+      size += sizeof(macaddr) + 1 + msg.bonded_data_channels[i].ssid.wire_len();
+    }
+    return size;
+  }
+  else {
+    if (msg.count > DCWMSG_MAX_ENTRIES) return 0;
+    std::size_t size = 2;
+    for (std::size_t i = 0; i < msg.count; i++) {
+      if (msg.data_ssids[i].len > 32) return 0;
+      size += 1 + msg.data_ssids[i].wire_len();
+    }
+    return size;
+  }
+}
+
+
+
+/*
+  Encoding...
+  Returns the number of bytes written, or 0 if the message is invalid or
+  "out" is too small (in which case nothing is written).
+*/
+template <typename T>
+inline std::size_t
+encode(const T &msg, const mutable_bytes out) {
+  using traits = wire_traits<T>;
+
+  const std::size_t size = encoded_size(msg);
+  if ((size == 0) || (out.size < size)) return 0;
+
+  unsigned char *p = out.data;
+  *p++ = static_cast<unsigned char>(traits::id);
+  if constexpr (!traits::has_count) {
+    return size;
+  }
+  else {
+    *p++ = static_cast<unsigned char>(msg.count);
+    if constexpr (traits::entry_size != 0) {
+      std::memcpy(p, msg.macaddrs.data(), msg.count * traits::entry_size);
+    }
+    else if constexpr (std::is_same_v<T, sta_ack>) {
+      for (std::size_t i = 0; i < msg.count; i++) {
+        const auto &chan = msg.bonded_data_channels[i];
+        std::memcpy(p, chan.macaddr.data(), chan.macaddr.size());
+        p += chan.macaddr.size();
+        const std::size_t ssid_len = chan.ssid.wire_len();
+        *p++ = static_cast<unsigned char>(ssid_len);
+        std::memcpy(p, chan.ssid.chars.data(), ssid_len);
+        p += ssid_len;
+      }
+    }
+    else {
+      for (std::size_t i = 0; i < msg.count; i++) {
+        const std::size_t ssid_len = msg.data_ssids[i].wire_len();
+        *p++ = static_cast<unsigned char>(ssid_len);
+        std::memcpy(p, msg.data_ssids[i].chars.data(), ssid_len);
+        p += ssid_len;
+      }
+    }
+    return size;
+  }
+}
+
+
+
+/*
+  Decoding...
+  Returns the number of bytes consumed, or 0 if "in" does not hold a valid
+  message of type T. Trailing bytes are ignored, as with dcwmsg_marshal().
+*/
+namespace detail {
+inline bool
+decode_ssid(ssid &out, const unsigned char *&p, std::size_t &remaining) {
+  if (remaining < 1) return false;
+  const std::size_t len = *p++;
+  remaining--;
+  if ((len > out.chars.size()) || (remaining < len)) return false;
+  out.len = len;
+  std::memcpy(out.chars.data(), p, len);
+  p += len;
+  remaining -= len;
+  return true;
+}
+} // namespace detail
+
+template <typename T>
+inline std::size_t
+decode(T &msg, const const_bytes in) {
+  using traits = wire_traits<T>;
+
+  if ((in.size < 1) || (in.data[0] != static_cast<unsigned char>(traits::id))) return 0;
+  if constexpr (!traits::has_count) {
+    (void)msg;
+    return 1;
+  }
+  else {
+    if (in.size < 2) return 0;
+    const std::size_t count = in.data[1];
+    if (count > DCWMSG_MAX_ENTRIES) return 0;
+
+    const unsigned char *p = in.data + 2;
+    std::size_t remaining = in.size - 2;
+
+    if constexpr (traits::entry_size != 0) {
+      if (remaining < (count * traits::entry_size)) return 0;
+      std::memcpy(msg.macaddrs.data(), p, count * traits::entry_size);
+      p += count * traits::entry_size;
+    }
+    else if constexpr (std::is_same_v<T, sta_ack>) {
+      for (std::size_t i = 0; i < count; i++) {
+        auto &chan = msg.bonded_data_channels[i];
+        if (remaining < chan.macaddr.size()) return 0;
+        std::memcpy(chan.macaddr.data(), p, chan.macaddr.size());
+        p += chan.macaddr.size();
+        remaining -= chan.macaddr.size();
+        if (!detail::decode_ssid(chan.ssid, p, remaining)) return 0;
+      }
+    }
+    else {
+      for (std::size_t i = 0; i < count; i++) {
+        if (!detail::decode_ssid(msg.data_ssids[i], p, remaining)) return 0;
+      }
+    }
+
+    msg.count = count;
+    return static_cast<std::size_t>(p - in.data);
+  }
+}
+
+/* returns the message id byte, for picking which decode<T>() to call */
+inline bool
+peek_id(dcwmsg_id &id, const const_bytes in) {
+  if (in.size < 1) return false;
+  id = static_cast<dcwmsg_id>(in.data[0]);
+  return true;
+}
+
+} // namespace dcw
+
+
+#endif /* #ifndef DCWPROTO_HPP_INCLUDED */
@@ -0,0 +1,172 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+#include "dcwproto_view_validate.h"
+
+#include <stddef.h>
+#include <string.h>
+
+
+
+/*
+
+  Compact message functions begin here...
+  A compact message keeps its entries packed exactly as they are on the wire
+  (everything after the count byte), so marshal and serialize are a single
+  validation pass plus one memcpy, and the view iterator works on it as-is.
+
+*/
+unsigned
+dcwmsg_compact_from_view(struct dcwmsg_compact * const output, const unsigned output_size, const struct dcwmsg_view * const view) {
+  unsigned entries_len;
+
+  entries_len = (view->length > 2) ? (view->length - 2) : 0;
+  if (output_size < (DCWMSG_COMPACT_HEADER_SIZE + entries_len)) return 0; /* output too small */
+
+  output->id          = (unsigned char)(unsigned)view->id;
+  output->count       = (unsigned char)view->count;
+  output->entries_len = (unsigned short)entries_len;
+  if (entries_len > 0) memcpy(output->entries, view->entries, entries_len); /* ID only views have no entries pointer */
+
+  return DCWMSG_COMPACT_HEADER_SIZE + entries_len;
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_compact_marshal(struct dcwmsg_compact * const output, const unsigned output_size, const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+
+  if (!dcwmsg_view_init(&view, buf, buf_len)) return 0; /* marshal failed */
+  return dcwmsg_compact_from_view(output, output_size, &view);
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_compact_pack(struct dcwmsg_compact * const output, const unsigned output_size, const struct dcwmsg * const input) {
+  unsigned char *pos;
+  unsigned entries_len;
+  unsigned copy_size;
+  unsigned size;
+  unsigned i;
+
+  /* the same size walk dcwmsg_serialize_exact() makes, so the entries match its output byte for byte */
+  size = dcwmsg_serialized_size(input);
+  if (size == 0) return 0; /* invalid message */
+  entries_len = (size > 2) ? (size - 2) : 0;
+  if (output_size < (DCWMSG_COMPACT_HEADER_SIZE + entries_len)) return 0; /* output too small */
+
+  output->id          = (unsigned char)(unsigned)input->id;
+  output->count       = 0;
+  output->entries_len = (unsigned short)entries_len;
+
+  /* write the entries straight into the compact message; sizes were checked above */
+  pos = output->entries;
+  switch (input->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* all four MAC list structs share the same layout */
+    output->count = (unsigned char)input->sta_join.data_macaddr_count;
+    memcpy(pos, input->sta_join.data_macaddrs, entries_len);
+    break;
+
+  case DCWMSG_STA_ACK:
+    output->count = (unsigned char)input->sta_ack.bonded_data_channel_count;
+    for (i = 0; i < input->sta_ack.bonded_data_channel_count; i++) {
+      memcpy(pos, input->sta_ack.bonded_data_channels[i].macaddr, sizeof(dcwmsg_macaddr_t));
+      pos += sizeof(dcwmsg_macaddr_t);
+
+      copy_size = strnlen(input->sta_ack.bonded_data_channels[i].ssid, sizeof(input->sta_ack.bonded_data_channels[i].ssid));
+      (*pos++) = (unsigned char)copy_size;
+      memcpy(pos, input->sta_ack.bonded_data_channels[i].ssid, copy_size);
+      pos += copy_size;
+    }
+    break;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    output->count = (unsigned char)input->ap_accept_sta.data_ssid_count;
+    for (i = 0; i < input->ap_accept_sta.data_ssid_count; i++) {
+      copy_size = strnlen(input->ap_accept_sta.data_ssids[i], sizeof(input->ap_accept_sta.data_ssids[i]));
+      (*pos++) = (unsigned char)copy_size;
+      memcpy(pos, input->ap_accept_sta.data_ssids[i], copy_size);
+      pos += copy_size;
+    }
+    break;
+
+  default:
+    break; /* id only */
+  }
+
+  return DCWMSG_COMPACT_HEADER_SIZE + entries_len;
+}
+
+int WIN32_EXPORT
+dcwmsg_compact_view(struct dcwmsg_view * const output, const struct dcwmsg_compact * const input) {
+  unsigned span;
+
+  output->id      = (enum dcwmsg_id)input->id;
+  output->count   = 0;
+  output->entries = NULL;
+  output->length  = 1;
+
+  switch (output->id) {
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    /* these messages are ID only */
+    return ((input->count == 0) && (input->entries_len == 0));
+  default:
+    break;
+  }
+
+  /* the header is caller memory too: the entries must span exactly entries_len bytes */
+  if (!dcwmsg_view_validate_entries(output->id, input->count, input->entries, input->entries_len, &span)) return 0;
+  if (span != input->entries_len) return 0;
+
+  output->count   = input->count;
+  output->entries = input->entries;
+  output->length  = 2 + span;
+  return 1;
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_compact_serialize(unsigned char * const buf, const struct dcwmsg_compact * const input, const unsigned buf_len) {
+  struct dcwmsg_view view;
+
+  if (!dcwmsg_compact_view(&view, input)) return 0; /* invalid compact message */
+  if (buf_len < view.length) return 0; /* serialize failed */
+
+  buf[0] = input->id;
+  if (view.length == 1) return 1; /* this message is id only */
+  buf[1] = input->count;
+  memcpy(&buf[2], input->entries, input->entries_len);
+  return view.length;
+}
+
+int WIN32_EXPORT
+dcwmsg_compact_unpack(struct dcwmsg * const output, const struct dcwmsg_compact * const input) {
+  struct dcwmsg_view view;
+
+  if (!dcwmsg_compact_view(&view, input)) return 0;
+  return dcwmsg_view_marshal(output, &view);
+}
+
@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#define CONTAINER_HEADER_SIZE  2 /* id + message count */
+#define CONTAINER_LENGTH_SIZE  2 /* big endian length before each message */
+
+
+
+/*
+
+  Container encoder...
+
+*/
+unsigned WIN32_EXPORT
+dcwmsg_container_pack(unsigned char * const buf, const unsigned buf_len, const struct dcwmsg * const inputs, const unsigned count, unsigned * const packed) {
+  unsigned offset;
+  unsigned size;
+  unsigned n;
+
+  (*packed) = 0;
+  if (count == 0) return 0;
+
+  n      = 0;
+  offset = CONTAINER_HEADER_SIZE;
+  if (buf_len >= offset) {
+    while ((n < count) && (n < DCWMSG_CONTAINER_MAX_COUNT)) {
+      size = dcwmsg_serialized_size(&inputs[n]);
+      if (size == 0) break; /* invalid; the caller sees it at inputs[*packed] */
+      if ((buf_len - offset) < (CONTAINER_LENGTH_SIZE + size)) break; /* frame full */
+
+      buf[offset]     = (unsigned char)(size >> 8);
+      buf[offset + 1] = (unsigned char)size;
+      dcwmsg_serialize_exact(buf + offset + CONTAINER_LENGTH_SIZE, &inputs[n], size);
+      offset += CONTAINER_LENGTH_SIZE + size;
+      n++;
+    }
+  }
+
+  switch (n) {
+  case 0:
+    /* a message can still fit on its own when it does not fit with the framing */
+    size = dcwmsg_serialize_exact(buf, &inputs[0], buf_len);
+    if (size == 0) return 0;
+    (*packed) = 1;
+    return size;
+
+  case 1:
+    /* a lone message goes out as itself, which every peer understands */
+    size = offset - CONTAINER_HEADER_SIZE - CONTAINER_LENGTH_SIZE;
+    memmove(buf, buf + CONTAINER_HEADER_SIZE + CONTAINER_LENGTH_SIZE, size);
+    (*packed) = 1;
+    return size;
+
+  default:
+    buf[0] = DCWMSG_CONTAINER;
+    buf[1] = (unsigned char)n;
+    (*packed) = n;
+    return offset;
+  }
+}
+
+
+
+
+/*
+
+  Container iterator...
+  The whole frame is checked up front, so iteration itself can't fail part
+  way through. The contained messages are not validated here; pass each one
+  to dcwmsg_marshal(), dcwmsg_view_init() or dcwmsg_peek().
+
+*/
+int WIN32_EXPORT
+dcwmsg_container_iter_init(struct dcwmsg_container_iter * const iter, const unsigned char * const buf, const unsigned buf_len) {
+  unsigned offset;
+  unsigned count;
+  unsigned len;
+  unsigned i;
+
+  if (buf_len < 1) return 0;
+
+  if (buf[0] != DCWMSG_CONTAINER) {
+    /* a plain message is a frame of one */
+    iter->pos       = buf;
+    iter->remaining = 1;
+    iter->plain_len = buf_len;
+    return 1;
+  }
+
+  if (buf_len < CONTAINER_HEADER_SIZE) return 0;
+  count = (unsigned)buf[1];
+  if (count == 0) return 0;
+
+  /* the lengths must cover the frame exactly; containers do not nest */
+  offset = CONTAINER_HEADER_SIZE;
+  for (i = 0; i < count; i++) {
+    if ((buf_len - offset) < CONTAINER_LENGTH_SIZE) return 0;
+    len = ((unsigned)buf[offset] << 8) | (unsigned)buf[offset + 1];
+    offset += CONTAINER_LENGTH_SIZE;
+    if ((len == 0) || ((buf_len - offset) < len)) return 0;
+    if (buf[offset] == DCWMSG_CONTAINER) return 0;
+    offset += len;
+  }
+  if (offset != buf_len) return 0;
+
+  iter->pos       = buf + CONTAINER_HEADER_SIZE;
+  iter->remaining = count;
+  iter->plain_len = 0;
+  return 1;
+}
+
+int WIN32_EXPORT
+dcwmsg_container_iter_next(struct dcwmsg_container_iter * const iter, const unsigned char ** const msg, unsigned * const msg_len) {
+  if (iter->remaining == 0) return 0; /* end of the frame */
+  iter->remaining--;
+
+  if (iter->plain_len != 0) {
+    (*msg)     = iter->pos;
+    (*msg_len) = iter->plain_len;
+    return 1;
+  }
+
+  (*msg_len) = ((unsigned)iter->pos[0] << 8) | (unsigned)iter->pos[1];
+  (*msg)     = iter->pos + CONTAINER_LENGTH_SIZE;
+  iter->pos += CONTAINER_LENGTH_SIZE + (*msg_len);
+  return 1;
+}
+
@@ -0,0 +1,373 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+#include "dcwproto_view_validate.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CTX_ALIGN 64 /* cache line size on the targets that matter */
+
+
+
+/*
+
+  Codec context functions begin here...
+  Everything a context needs lives in its one allocation, aligned and
+  padded to whole cache lines so no other object shares them. Only the
+  uninstrumented codec functions (views, dcwmsg_serialize_exact(), format,
+  container, extended, compact and validate) are used underneath; none of
+  them carry dcwstats instrumentation or any other shared state.
+
+*/
+struct dcwproto_ctx {
+  struct dcwproto_ctx_config  config;
+  struct dcwproto_ctx_stats   stats;
+  void                       *alloc;    /* what malloc() returned, before alignment */
+  struct dcwmsg               msg;
+  unsigned char               buf[DCWMSG_MAX_SERIALIZED_SIZE];
+  char                        text[DCWPROTO_CTX_TEXT_SIZE];
+};
+
+/* max_entries and validate_flags, counted against "counters" when they reject */
+static int
+ctx_check_limits(struct dcwproto_ctx * const ctx, struct dcwproto_ctx_counters * const counters, const struct dcwmsg_view * const view) {
+  if (view->count > ctx->config.max_entries) {
+    counters->over_limit++;
+    return 0;
+  }
+  if ((ctx->config.validate_flags != 0) && !dcwmsg_validate_view(view, ctx->config.validate_flags)) {
+    counters->invalid++;
+    return 0;
+  }
+  return 1;
+}
+
+/* everything dcwproto_ctx_view() checks, without counting the success */
+static int
+ctx_check_input(struct dcwproto_ctx * const ctx, struct dcwmsg_view * const output, const unsigned char * const buf, const unsigned buf_len) {
+  if (!dcwmsg_view_init(output, buf, buf_len)) {
+    ctx->stats.marshal.malformed++;
+    return 0; /* view failed */
+  }
+  if (ctx->config.strict_length && (output->length != buf_len)) {
+    ctx->stats.marshal.trailing++;
+    return 0;
+  }
+  return ctx_check_limits(ctx, &ctx->stats.marshal, output);
+}
+
+/* the serialize side checks the limits on the wire bytes, the same as marshal */
+static int
+ctx_check_output(struct dcwproto_ctx * const ctx, const unsigned char * const buf, const unsigned size) {
+  struct dcwmsg_view view;
+
+  if ((ctx->config.max_entries >= DCWMSG_MAX_ENTRIES) && (ctx->config.validate_flags == 0)) return 1; /* nothing to check */
+  dcwmsg_view_init(&view, buf, size);
+  return ctx_check_limits(ctx, &ctx->stats.serialize, &view);
+}
+
+/* validate_flags for extended messages, whose entries can outnumber a view's */
+static int
+ctx_ext_validate(const struct dcwmsg_ext * const msg, const unsigned flags) {
+  unsigned char local[DCWMSG_MAX_ENTRIES * sizeof(dcwmsg_macaddr_t)];
+  unsigned char *macaddrs;
+  unsigned i;
+  int rv;
+
+  switch (msg->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    if (msg->count == 0) return 1;
+    return dcwmsg_validate_macaddrs(msg->macaddrs[0], msg->count, flags);
+
+  case DCWMSG_STA_ACK:
+    if (msg->count == 0) return 1;
+    /* dcwmsg_validate_macaddrs() wants them contiguous; large messages gather on the heap */
+    macaddrs = (msg->count <= DCWMSG_MAX_ENTRIES) ? local : malloc(msg->count * sizeof(dcwmsg_macaddr_t));
+    if (macaddrs == NULL) return 0; /* can't check it, so don't pass it */
+    for (i = 0; i < msg->count; i++) {
+      memcpy(macaddrs + (i * sizeof(dcwmsg_macaddr_t)), msg->bonded_data_channels[i].macaddr, sizeof(dcwmsg_macaddr_t));
+    }
+    rv = dcwmsg_validate_macaddrs(macaddrs, msg->count, flags);
+    if (macaddrs != local) free(macaddrs);
+    return rv;
+
+  default:
+    return 1; /* no MAC addresses */
+  }
+}
+
+/* ext_max_entries and validate_flags for extended messages */
+static int
+ctx_ext_check_limits(struct dcwproto_ctx * const ctx, struct dcwproto_ctx_counters * const counters, const struct dcwmsg_ext * const msg) {
+  if (msg->count > ctx->config.ext_max_entries) {
+    counters->over_limit++;
+    return 0;
+  }
+  if ((ctx->config.validate_flags != 0) && !ctx_ext_validate(msg, ctx->config.validate_flags)) {
+    counters->invalid++;
+    return 0;
+  }
+  return 1;
+}
+
+void WIN32_EXPORT
+dcwproto_ctx_config_init(struct dcwproto_ctx_config * const config) {
+  config->max_entries     = DCWMSG_MAX_ENTRIES;
+  config->validate_flags  = 0;
+  config->strict_length   = 0;
+  config->ext_max_entries = DCWMSG_EXT_MAX_ENTRIES;
+}
+
+struct dcwproto_ctx * WIN32_EXPORT
+dcwproto_ctx_create(const struct dcwproto_ctx_config * const config) {
+  struct dcwproto_ctx *ctx;
+  size_t size;
+  void *alloc;
+
+  size  = (sizeof(*ctx) + CTX_ALIGN - 1) & ~(size_t)(CTX_ALIGN - 1);
+  alloc = malloc(size + CTX_ALIGN - 1);
+  if (alloc == NULL) return NULL;
+
+  ctx = (struct dcwproto_ctx *)(((size_t)alloc + CTX_ALIGN - 1) & ~(size_t)(CTX_ALIGN - 1));
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->alloc = alloc;
+
+  if (config != NULL) {
+    ctx->config = (*config);
+  }
+  else {
+    dcwproto_ctx_config_init(&ctx->config);
+  }
+  if ((ctx->config.max_entries == 0) || (ctx->config.max_entries > DCWMSG_MAX_ENTRIES)) ctx->config.max_entries = DCWMSG_MAX_ENTRIES;
+  if ((ctx->config.ext_max_entries == 0) || (ctx->config.ext_max_entries > DCWMSG_EXT_MAX_ENTRIES)) ctx->config.ext_max_entries = DCWMSG_EXT_MAX_ENTRIES;
+
+  return ctx;
+}
+
+void WIN32_EXPORT
+dcwproto_ctx_destroy(struct dcwproto_ctx * const ctx) {
+  if (ctx == NULL) return;
+  free(ctx->alloc);
+}
+
+int WIN32_EXPORT
+dcwproto_ctx_view(struct dcwproto_ctx * const ctx, struct dcwmsg_view * const output, const unsigned char * const buf, const unsigned buf_len) {
+  if (!ctx_check_input(ctx, output, buf, buf_len)) return 0; /* view failed */
+
+  ctx->stats.marshal.messages++;
+  ctx->stats.marshal.bytes += output->length;
+  return 1; /* success */
+}
+
+int WIN32_EXPORT
+dcwproto_ctx_marshal(struct dcwproto_ctx * const ctx, struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+
+  if (!dcwproto_ctx_view(ctx, &view, buf, buf_len)) return 0; /* marshal failed */
+  dcwmsg_view_marshal(output, &view);
+  return 1; /* success */
+}
+
+unsigned WIN32_EXPORT
+dcwproto_ctx_serialize(struct dcwproto_ctx * const ctx, unsigned char * const buf, const struct dcwmsg * const input, const unsigned buf_len) {
+  unsigned size;
+
+  size = dcwmsg_serialize_exact(buf, input, buf_len);
+  if (size == 0) {
+    ctx->stats.serialize.malformed++;
+    return 0; /* serialize failed */
+  }
+  if (!ctx_check_output(ctx, buf, size)) return 0;
+
+  ctx->stats.serialize.messages++;
+  ctx->stats.serialize.bytes += size;
+  return size;
+}
+
+int WIN32_EXPORT
+dcwproto_ctx_peek(struct dcwproto_ctx * const ctx, const unsigned char * const buf, const unsigned buf_len, enum dcwmsg_id * const id, unsigned * const count, unsigned * const length) {
+  struct dcwmsg_view view;
+
+  if (!dcwproto_ctx_view(ctx, &view, buf, buf_len)) return 0; /* peek failed */
+  if (id != NULL)     (*id)     = view.id;
+  if (count != NULL)  (*count)  = view.count;
+  if (length != NULL) (*length) = view.length;
+  return 1; /* success */
+}
+
+int WIN32_EXPORT
+dcwproto_ctx_validate(struct dcwproto_ctx * const ctx, const struct dcwmsg_view * const view) {
+  return ctx_check_limits(ctx, &ctx->stats.marshal, view);
+}
+
+unsigned WIN32_EXPORT
+dcwproto_ctx_container_pack(struct dcwproto_ctx * const ctx, unsigned char * const buf, const unsigned buf_len, const struct dcwmsg * const inputs, const unsigned count, unsigned * const packed) {
+  unsigned accepted;
+  unsigned need;
+  unsigned size;
+
+  /*
+    the context's checks run on each message before it is packed, stopping
+    at the first rejection; messages that would not fit in this frame are
+    left for the next one without being checked (or counted) yet
+  */
+  need = 2; /* container header */
+  for (accepted = 0; (accepted < count) && (accepted < DCWMSG_CONTAINER_MAX_COUNT); accepted++) {
+    size  = dcwmsg_serialized_size(&inputs[accepted]);
+    need += 2 + size;
+    if ((accepted > 0) && (need > buf_len)) break; /* frame full */
+    if (size == 0) {
+      ctx->stats.serialize.malformed++;
+      break;
+    }
+    if ((ctx->config.max_entries < DCWMSG_MAX_ENTRIES) || (ctx->config.validate_flags != 0)) {
+      if (dcwmsg_serialize_exact(ctx->buf, &inputs[accepted], sizeof(ctx->buf)) != size) {
+        ctx->stats.serialize.malformed++;
+        break;
+      }
+      if (!ctx_check_output(ctx, ctx->buf, size)) break;
+    }
+  }
+
+  size = dcwmsg_container_pack(buf, buf_len, inputs, accepted, packed);
+  if ((size == 0) && (accepted > 0)) ctx->stats.serialize.malformed++; /* the first message does not fit buf */
+
+  ctx->stats.serialize.messages += (*packed);
+  ctx->stats.serialize.bytes += size;
+  return size;
+}
+
+int WIN32_EXPORT
+dcwproto_ctx_container_next(struct dcwproto_ctx * const ctx, struct dcwmsg_container_iter * const iter, struct dcwmsg_view * const output) {
+  const unsigned char *msg;
+  unsigned msg_len;
+
+  if (!dcwmsg_container_iter_next(iter, &msg, &msg_len)) return 0; /* end of the frame */
+  return dcwproto_ctx_view(ctx, output, msg, msg_len) ? 1 : -1;
+}
+
+int WIN32_EXPORT
+dcwproto_ctx_ext_marshal(struct dcwproto_ctx * const ctx, struct dcwmsg_ext * const output, const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+  unsigned length;
+
+  if ((buf_len < 1) || (buf[0] != DCWMSG_EXT_V1)) {
+    /* legacy messages get exactly the dcwproto_ctx_view() checks */
+    if (!ctx_check_input(ctx, &view, buf, buf_len)) return 0;
+    if (!dcwmsg_ext_marshal(output, buf, view.length)) return 0; /* out of memory */
+    ctx->stats.marshal.messages++;
+    ctx->stats.marshal.bytes += view.length;
+    return 1; /* success */
+  }
+
+  if (!dcwmsg_ext_marshal(output, buf, buf_len)) {
+    ctx->stats.marshal.malformed++;
+    return 0; /* marshal failed */
+  }
+  length = dcwmsg_ext_serialized_size(output); /* the encoding is canonical, so this is what was read */
+  if (ctx->config.strict_length && (length != buf_len)) {
+    ctx->stats.marshal.trailing++;
+    return 0;
+  }
+  if (!ctx_ext_check_limits(ctx, &ctx->stats.marshal, output)) return 0;
+
+  ctx->stats.marshal.messages++;
+  ctx->stats.marshal.bytes += length;
+  return 1; /* success */
+}
+
+unsigned WIN32_EXPORT
+dcwproto_ctx_ext_serialize(struct dcwproto_ctx * const ctx, unsigned char * const buf, const struct dcwmsg_ext * const input, const unsigned buf_len) {
+  unsigned size;
+
+  if (!ctx_ext_check_limits(ctx, &ctx->stats.serialize, input)) return 0;
+  size = dcwmsg_ext_serialize(buf, input, buf_len);
+  if (size == 0) {
+    ctx->stats.serialize.malformed++;
+    return 0; /* serialize failed */
+  }
+
+  ctx->stats.serialize.messages++;
+  ctx->stats.serialize.bytes += size;
+  return size;
+}
+
+unsigned WIN32_EXPORT
+dcwproto_ctx_compact_marshal(struct dcwproto_ctx * const ctx, struct dcwmsg_compact * const output, const unsigned output_size, const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+  unsigned size;
+
+  if (!ctx_check_input(ctx, &view, buf, buf_len)) return 0; /* marshal failed */
+  size = dcwmsg_compact_from_view(output, output_size, &view);
+  if (size == 0) return 0; /* output too small; the input was fine, so nothing is counted */
+
+  ctx->stats.marshal.messages++;
+  ctx->stats.marshal.bytes += view.length;
+  return size;
+}
+
+unsigned WIN32_EXPORT
+dcwproto_ctx_compact_pack(struct dcwproto_ctx * const ctx, struct dcwmsg_compact * const output, const unsigned output_size, const struct dcwmsg * const input) {
+  struct dcwmsg_view view;
+  unsigned size;
+
+  size = dcwmsg_compact_pack(output, output_size, input);
+  if (size == 0) {
+    ctx->stats.serialize.malformed++;
+    return 0; /* pack failed */
+  }
+  dcwmsg_compact_view(&view, output);
+  if (!ctx_check_limits(ctx, &ctx->stats.serialize, &view)) return 0;
+
+  ctx->stats.serialize.messages++;
+  ctx->stats.serialize.bytes += view.length;
+  return size;
+}
+
+const char * WIN32_EXPORT
+dcwproto_ctx_format(struct dcwproto_ctx * const ctx, const struct dcwmsg * const msg, const enum dcwmsg_format_mode mode) {
+  dcwmsg_format(ctx->text, sizeof(ctx->text), msg, mode);
+  return ctx->text;
+}
+
+struct dcwmsg * WIN32_EXPORT
+dcwproto_ctx_msg(struct dcwproto_ctx * const ctx) {
+  return &ctx->msg;
+}
+
+unsigned char * WIN32_EXPORT
+dcwproto_ctx_buf(struct dcwproto_ctx * const ctx) {
+  return ctx->buf;
+}
+
+void WIN32_EXPORT
+dcwproto_ctx_snapshot(const struct dcwproto_ctx * const ctx, struct dcwproto_ctx_stats * const output) {
+  memcpy(output, &ctx->stats, sizeof(*output));
+}
+
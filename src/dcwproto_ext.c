@@ -0,0 +1,412 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VARINT_MAX_SIZE 3 /* enough for DCWMSG_EXT_MAX_ENTRIES */
+
+
+
+/*
+
+  Varint helpers...
+
+*/
+static unsigned
+varint_size(unsigned value) {
+  unsigned size;
+
+  for (size = 1; value >= 0x80; size++) value >>= 7;
+  return size;
+}
+
+static unsigned
+varint_put(unsigned char * const p, unsigned value) {
+  unsigned size;
+
+  for (size = 0; value >= 0x80; size++) {
+    p[size] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  p[size++] = (unsigned char)value;
+  return size;
+}
+
+/* returns the bytes used, 0 if truncated, too long or not minimal */
+static unsigned
+varint_get(const unsigned char * const p, const unsigned len, unsigned * const value) {
+  unsigned v;
+  unsigned i;
+
+  v = 0;
+  for (i = 0; (i < len) && (i < VARINT_MAX_SIZE); i++) {
+    v |= (unsigned)(p[i] & 0x7F) << (7 * i);
+    if (!(p[i] & 0x80)) {
+      if ((i > 0) && (p[i] == 0)) return 0; /* a longer encoding than needed */
+      (*value) = v;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+
+
+/*
+
+  Extended message storage...
+
+*/
+
+/* per entry: bytes of storage, and the fewest wire bytes it can take */
+static int
+ext_layout(const enum dcwmsg_id id, unsigned * const entry_size, unsigned * const min_wire_size) {
+  switch (id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    (*entry_size)    = sizeof(dcwmsg_macaddr_t);
+    (*min_wire_size) = sizeof(dcwmsg_macaddr_t);
+    return 1;
+  case DCWMSG_STA_ACK:
+    (*entry_size)    = sizeof(struct dcwmsg_ext_bonded_data_channel);
+    (*min_wire_size) = sizeof(dcwmsg_macaddr_t) + 1;
+    return 1;
+  case DCWMSG_AP_ACCEPT_STA:
+    (*entry_size)    = sizeof(struct dcwmsg_ext_ssid);
+    (*min_wire_size) = 1;
+    return 1;
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    (*entry_size)    = 0; /* ID only */
+    (*min_wire_size) = 0;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+void WIN32_EXPORT
+dcwmsg_ext_init(struct dcwmsg_ext * const msg) {
+  memset(msg, 0, sizeof(*msg));
+}
+
+void WIN32_EXPORT
+dcwmsg_ext_free(struct dcwmsg_ext * const msg) {
+  free(msg->storage);
+  dcwmsg_ext_init(msg);
+}
+
+int WIN32_EXPORT
+dcwmsg_ext_reserve(struct dcwmsg_ext * const msg, const enum dcwmsg_id id, const unsigned count) {
+  unsigned entry_size;
+  unsigned min_wire_size;
+  unsigned long needed;
+  void *storage;
+
+  if (!ext_layout(id, &entry_size, &min_wire_size)) return 0;
+  if ((count > DCWMSG_EXT_MAX_ENTRIES) || ((entry_size == 0) && (count != 0))) return 0;
+
+  needed = (unsigned long)count * entry_size;
+  if (needed > msg->storage_size) {
+    storage = realloc(msg->storage, needed);
+    if (storage == NULL) return 0;
+    msg->storage      = storage;
+    msg->storage_size = needed;
+  }
+
+  msg->id    = id;
+  msg->count = count;
+  return 1;
+}
+
+
+
+/*
+
+  Extended marshal functions begin here...
+
+*/
+
+/* entries are laid out as in the legacy encoding; storage is already sized */
+static int
+ext_decode_entries(struct dcwmsg_ext * const output, const unsigned char *p, unsigned remaining) {
+  struct dcwmsg_ext_bonded_data_channel *chan;
+  struct dcwmsg_ext_ssid *ssid;
+  unsigned len;
+  unsigned i;
+
+  switch (output->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    if (remaining < (output->count * sizeof(dcwmsg_macaddr_t))) return 0;
+    if (output->count > 0) memcpy(output->macaddrs, p, output->count * sizeof(dcwmsg_macaddr_t));
+    return 1;
+
+  case DCWMSG_STA_ACK:
+    for (i = 0; i < output->count; i++) {
+      chan = &output->bonded_data_channels[i];
+      if (remaining < (sizeof(dcwmsg_macaddr_t) + 1)) return 0;
+      memcpy(chan->macaddr, p, sizeof(dcwmsg_macaddr_t));
+      len = (unsigned)p[sizeof(dcwmsg_macaddr_t)];
+      p         += sizeof(dcwmsg_macaddr_t) + 1;
+      remaining -= sizeof(dcwmsg_macaddr_t) + 1;
+      if ((len > sizeof(dcwmsg_ssid_t)) || (remaining < len)) return 0;
+      chan->ssid_len = (unsigned char)len;
+      memcpy(chan->ssid, p, len);
+      p         += len;
+      remaining -= len;
+    }
+    return 1;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    for (i = 0; i < output->count; i++) {
+      ssid = &output->ssids[i];
+      if (remaining < 1) return 0;
+      len = (unsigned)*p++;
+      remaining--;
+      if ((len > sizeof(dcwmsg_ssid_t)) || (remaining < len)) return 0;
+      ssid->len = (unsigned char)len;
+      memcpy(ssid->ssid, p, len);
+      p         += len;
+      remaining -= len;
+    }
+    return 1;
+
+  default:
+    return 1; /* ID only */
+  }
+}
+
+int WIN32_EXPORT
+dcwmsg_ext_marshal(struct dcwmsg_ext * const output, const unsigned char * const buf, const unsigned buf_len) {
+  enum dcwmsg_id id;
+  unsigned entry_size;
+  unsigned min_wire_size;
+  unsigned offset;
+  unsigned count;
+  unsigned size;
+
+  if (buf_len < 1) return 0;
+
+  if (buf[0] == DCWMSG_EXT_V1) {
+    if (buf_len < 2) return 0;
+    id = (enum dcwmsg_id)buf[1];
+    if (!ext_layout(id, &entry_size, &min_wire_size)) return 0; /* unknown id, or a hello */
+    offset = 2;
+    count  = 0;
+    if (entry_size != 0) {
+      size = varint_get(buf + offset, buf_len - offset, &count);
+      if (size == 0) return 0;
+      if (count > DCWMSG_EXT_MAX_ENTRIES) return 0; /* count too big */
+      offset += size;
+    }
+  }
+  else {
+    /* legacy encoding; same rules as dcwmsg_view_init() */
+    id = (enum dcwmsg_id)buf[0];
+    if (!ext_layout(id, &entry_size, &min_wire_size)) return 0;
+    offset = 1;
+    count  = 0;
+    if (entry_size != 0) {
+      if (buf_len < 2) return 0;
+      count = (unsigned)buf[1];
+      if (count > DCWMSG_MAX_ENTRIES) return 0; /* count too big */
+      offset = 2;
+    }
+  }
+
+  /* don't grow the storage for entries the buffer can't possibly hold */
+  if (((unsigned long)count * min_wire_size) > (buf_len - offset)) return 0;
+  if (!dcwmsg_ext_reserve(output, id, count)) return 0;
+  return ext_decode_entries(output, buf + offset, buf_len - offset);
+}
+
+
+
+
+/*
+
+  Extended serialize functions begin here...
+
+*/
+unsigned WIN32_EXPORT
+dcwmsg_ext_serialized_size(const struct dcwmsg_ext * const input) {
+  unsigned entry_size;
+  unsigned min_wire_size;
+  unsigned size;
+  unsigned i;
+
+  if (!ext_layout(input->id, &entry_size, &min_wire_size)) return 0;
+  if (entry_size == 0) return 2; /* marker + ID */
+  if (input->count > DCWMSG_EXT_MAX_ENTRIES) return 0;
+
+  size = 2 + varint_size(input->count);
+  switch (input->id) {
+  case DCWMSG_STA_ACK:
+    for (i = 0; i < input->count; i++) {
+      if (input->bonded_data_channels[i].ssid_len > sizeof(dcwmsg_ssid_t)) return 0;
+      size += sizeof(dcwmsg_macaddr_t) + 1 + input->bonded_data_channels[i].ssid_len;
+    }
+    return size;
+  case DCWMSG_AP_ACCEPT_STA:
+    for (i = 0; i < input->count; i++) {
+      if (input->ssids[i].len > sizeof(dcwmsg_ssid_t)) return 0;
+      size += 1 + input->ssids[i].len;
+    }
+    return size;
+  default:
+    return size + (input->count * sizeof(dcwmsg_macaddr_t));
+  }
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_ext_serialize(unsigned char * const buf, const struct dcwmsg_ext * const input, const unsigned buf_len) {
+  const struct dcwmsg_ext_bonded_data_channel *chan;
+  unsigned char *p;
+  unsigned size;
+  unsigned i;
+
+  size = dcwmsg_ext_serialized_size(input);
+  if ((size == 0) || (size > buf_len)) return 0; /* invalid message or not enough room */
+
+  p = buf;
+  *p++ = DCWMSG_EXT_V1;
+  *p++ = (unsigned char)input->id;
+  if (size == 2) return size; /* ID only */
+  p += varint_put(p, input->count);
+
+  switch (input->id) {
+  case DCWMSG_STA_ACK:
+    for (i = 0; i < input->count; i++) {
+      chan = &input->bonded_data_channels[i];
+      memcpy(p, chan->macaddr, sizeof(dcwmsg_macaddr_t));
+      p += sizeof(dcwmsg_macaddr_t);
+      *p++ = chan->ssid_len;
+      memcpy(p, chan->ssid, chan->ssid_len);
+      p += chan->ssid_len;
+    }
+    break;
+  case DCWMSG_AP_ACCEPT_STA:
+    for (i = 0; i < input->count; i++) {
+      *p++ = input->ssids[i].len;
+      memcpy(p, input->ssids[i].ssid, input->ssids[i].len);
+      p += input->ssids[i].len;
+    }
+    break;
+  default:
+    if (input->count > 0) memcpy(p, input->macaddrs, input->count * sizeof(dcwmsg_macaddr_t));
+    break;
+  }
+  return size;
+}
+
+/* legacy SSIDs are NUL terminated when shorter than the field */
+static void
+split_ssid(dcwmsg_ssid_t output, const char * const ssid, unsigned len) {
+  if (len > sizeof(dcwmsg_ssid_t)) len = sizeof(dcwmsg_ssid_t);
+  memcpy(output, ssid, len);
+  if (len < sizeof(dcwmsg_ssid_t)) output[len] = '\0';
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_ext_split(struct dcwmsg * const output, const struct dcwmsg_ext * const input, const unsigned first) {
+  unsigned n;
+  unsigned i;
+
+  output->id = input->id;
+  n = (first < input->count) ? (input->count - first) : 0;
+  if (n > DCWMSG_MAX_ENTRIES) n = DCWMSG_MAX_ENTRIES;
+
+  switch (input->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* all four MAC list structs share the same layout */
+    output->sta_join.data_macaddr_count = n;
+    if (n > 0) memcpy(output->sta_join.data_macaddrs, input->macaddrs + first, n * sizeof(dcwmsg_macaddr_t));
+    break;
+  case DCWMSG_STA_ACK:
+    output->sta_ack.bonded_data_channel_count = n;
+    for (i = 0; i < n; i++) {
+      memcpy(output->sta_ack.bonded_data_channels[i].macaddr, input->bonded_data_channels[first + i].macaddr, sizeof(dcwmsg_macaddr_t));
+      split_ssid(output->sta_ack.bonded_data_channels[i].ssid, input->bonded_data_channels[first + i].ssid, input->bonded_data_channels[first + i].ssid_len);
+    }
+    break;
+  case DCWMSG_AP_ACCEPT_STA:
+    output->ap_accept_sta.data_ssid_count = n;
+    for (i = 0; i < n; i++) {
+      split_ssid(output->ap_accept_sta.data_ssids[i], input->ssids[first + i].ssid, input->ssids[first + i].len);
+    }
+    break;
+  default:
+    break; /* ID only */
+  }
+  return n;
+}
+
+
+
+
+/*
+
+  Peer negotiation...
+
+*/
+unsigned WIN32_EXPORT
+dcwmsg_ext_hello(unsigned char * const buf, const unsigned buf_len) {
+  if (buf_len < 3) return 0;
+  buf[0] = DCWMSG_EXT_V1;
+  buf[1] = DCWMSG_EXT_HELLO;
+  buf[2] = DCWMSG_EXT_VERSION;
+  return 3;
+}
+
+void WIN32_EXPORT
+dcwmsg_ext_peer_init(struct dcwmsg_ext_peer * const peer) {
+  peer->version = 0;
+}
+
+int WIN32_EXPORT
+dcwmsg_ext_peer_observe(struct dcwmsg_ext_peer * const peer, const unsigned char * const buf, const unsigned buf_len) {
+  if ((buf_len < 2) || (buf[0] != DCWMSG_EXT_V1)) return 0;
+
+  if (buf[1] == DCWMSG_EXT_HELLO) {
+    if (buf_len < 3) return 0;
+    /* speak the lower of the two versions; a hello for 0 opts the peer out */
+    peer->version = (buf[2] < DCWMSG_EXT_VERSION) ? buf[2] : DCWMSG_EXT_VERSION;
+    return 1;
+  }
+
+  /* a peer that sends extended messages can read them */
+  if (peer->version == 0) peer->version = DCWMSG_EXT_VERSION;
+  return 0;
+}
+
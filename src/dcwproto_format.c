@@ -0,0 +1,418 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+
+#include <stddef.h>
+#include <string.h>
+
+
+
+/*
+
+  Output buffer helpers...
+  Writes past the end of the buffer are dropped but still counted, so the
+  final position is the full rendered length (snprintf() style).
+
+*/
+struct format_out {
+  char      *buf;
+  unsigned   buf_len;
+  unsigned   pos;
+};
+
+static void
+put_char(struct format_out * const out, const char c) {
+  if (out->pos < out->buf_len) out->buf[out->pos] = c;
+  out->pos++;
+}
+
+static void
+put_mem(struct format_out * const out, const char * const s, const unsigned len) {
+  unsigned copy_size;
+
+  if (out->pos < out->buf_len) {
+    copy_size = out->buf_len - out->pos;
+    if (copy_size > len) copy_size = len;
+    memcpy(&out->buf[out->pos], s, copy_size);
+  }
+  out->pos += len;
+}
+
+static void
+put_str(struct format_out * const out, const char * const s) {
+  put_mem(out, s, (unsigned)strlen(s));
+}
+
+static void
+put_uint(struct format_out * const out, unsigned value) {
+  char digits[10];
+  unsigned i;
+
+  i = sizeof(digits);
+  do {
+    digits[--i] = (char)('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+  put_mem(out, &digits[i], sizeof(digits) - i);
+}
+
+static void
+put_macaddr(struct format_out * const out, const unsigned char * const macaddr) {
+  static const char hex[] = "0123456789ABCDEF";
+  char text[17];
+  unsigned i;
+
+  for (i = 0; i < 6; i++) {
+    text[(i * 3) + 0] = hex[macaddr[i] >> 4];
+    text[(i * 3) + 1] = hex[macaddr[i] & 0x0F];
+    if (i < 5) text[(i * 3) + 2] = '-';
+  }
+  put_mem(out, text, sizeof(text));
+}
+
+/* an SSID is printed up to its first NUL, as with "%.*s" */
+static unsigned
+ssid_len(const char * const ssid) {
+  const char *nul;
+
+  nul = memchr(ssid, '\0', sizeof(dcwmsg_ssid_t));
+  return (nul == NULL) ? sizeof(dcwmsg_ssid_t) : (unsigned)(nul - ssid);
+}
+
+static void
+put_ssid(struct format_out * const out, const char * const ssid) {
+  put_mem(out, ssid, ssid_len(ssid));
+}
+
+static void
+put_json_ssid(struct format_out * const out, const char * const ssid) {
+  static const char hex[] = "0123456789abcdef";
+  unsigned len;
+  unsigned i;
+  unsigned char c;
+
+  len = ssid_len(ssid);
+  put_char(out, '"');
+  for (i = 0; i < len; i++) {
+    c = (unsigned char)ssid[i];
+    if ((c == '"') || (c == '\\')) {
+      put_char(out, '\\');
+      put_char(out, (char)c);
+    }
+    else if ((c < 0x20) || (c >= 0x7F)) {
+      /* SSIDs are raw bytes, not UTF-8: keep the output pure ASCII */
+      put_str(out, "\\u00");
+      put_char(out, hex[c >> 4]);
+      put_char(out, hex[c & 0x0F]);
+    }
+    else {
+      put_char(out, (char)c);
+    }
+  }
+  put_char(out, '"');
+}
+
+
+
+/*
+
+  Message field accessors...
+  The four MAC list messages share one layout.
+
+*/
+static const char *
+msg_id_name(const enum dcwmsg_id id) {
+  switch (id) {
+  case DCWMSG_STA_JOIN:           return "STA_JOIN";
+  case DCWMSG_STA_UNJOIN:         return "STA_UNJOIN";
+  case DCWMSG_STA_ACK:            return "STA_ACK";
+  case DCWMSG_STA_NACK:           return "STA_NACK";
+  case DCWMSG_AP_ACCEPT_STA:      return "AP_ACCEPT_STA";
+  case DCWMSG_AP_REJECT_STA:      return "AP_REJECT_STA";
+  case DCWMSG_AP_ACK_DISCONNECT:  return "AP_ACK_DISCONNECT";
+  case DCWMSG_AP_QUIT:            return "AP_QUIT";
+  default:                        return NULL;
+  }
+}
+
+static int
+msg_is_macaddr_list(const enum dcwmsg_id id) {
+  switch (id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+
+
+/*
+
+  Renderers...
+
+*/
+static void
+format_dump(struct format_out * const out, const struct dcwmsg * const msg) {
+  unsigned count;
+  unsigned i;
+
+  put_str(out, "DCW Message Dump:\n");
+
+  if (msg == NULL) {
+    put_str(out, "  (NULL)\n");
+    return;
+  }
+
+  switch (msg->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    switch (msg->id) {
+    case DCWMSG_STA_JOIN:   put_str(out, "  Type: Station Join\n"); break;
+    case DCWMSG_STA_UNJOIN: put_str(out, "  Type: Station Unjoin\n"); break;
+    case DCWMSG_STA_NACK:   put_str(out, "  Type: Station Negative Acknowledgement\n"); break;
+    default:                put_str(out, "  Type: AP Reject Station\n"); break;
+    }
+    count = msg->sta_join.data_macaddr_count;
+    put_str(out, "  Data Channel MAC Address Count: ");
+    put_uint(out, count);
+    put_char(out, '\n');
+    if (count > DCWMSG_MAX_ENTRIES) {
+      put_str(out, "  (Count too high)\n");
+      return;
+    }
+    put_str(out, (msg->id == DCWMSG_AP_REJECT_STA) ? "  Data Channel MAC Addresses:\n" : "  Data Channel MAC Address:\n");
+    for (i = 0; i < count; i++) {
+      put_str(out, "    . ");
+      put_macaddr(out, msg->sta_join.data_macaddrs[i]);
+      put_char(out, '\n');
+    }
+    break;
+
+  case DCWMSG_STA_ACK:
+    count = msg->sta_ack.bonded_data_channel_count;
+    put_str(out, "  Type: Station Acknowledgement\n");
+    put_str(out, "  Bonded Data Channel Count: ");
+    put_uint(out, count);
+    put_char(out, '\n');
+    if (count > DCWMSG_MAX_ENTRIES) {
+      put_str(out, "  (Count too high)\n");
+      return;
+    }
+    put_str(out, "  Bonded Data Channels:\n");
+    for (i = 0; i < count; i++) {
+      put_str(out, "    . ");
+      put_macaddr(out, msg->sta_ack.bonded_data_channels[i].macaddr);
+      put_str(out, " -> '");
+      put_ssid(out, msg->sta_ack.bonded_data_channels[i].ssid);
+      put_str(out, "'\n");
+    }
+    break;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    count = msg->ap_accept_sta.data_ssid_count;
+    put_str(out, "  Type: AP Accept Station\n");
+    put_str(out, "  Data Channel SSID Count: ");
+    put_uint(out, count);
+    put_char(out, '\n');
+    if (count > DCWMSG_MAX_ENTRIES) {
+      put_str(out, "  (Count too high)\n");
+      return;
+    }
+    put_str(out, "  Data Channel SSIDs:\n");
+    for (i = 0; i < count; i++) {
+      put_str(out, "    . ");
+      put_ssid(out, msg->ap_accept_sta.data_ssids[i]);
+      put_char(out, '\n');
+    }
+    break;
+
+  case DCWMSG_AP_ACK_DISCONNECT:
+    put_str(out, "  Type: AP ACK Station Disconnect\n");
+    break;
+
+  case DCWMSG_AP_QUIT:
+    put_str(out, "  Type: AP Quit\n");
+    break;
+
+  default:
+    put_str(out, "  Type: Unknown\n");
+    break;
+  }
+}
+
+static void
+format_line(struct format_out * const out, const struct dcwmsg * const msg) {
+  const char *name;
+  unsigned count;
+  unsigned i;
+
+  if (msg == NULL) {
+    put_str(out, "(NULL)");
+    return;
+  }
+
+  name = msg_id_name(msg->id);
+  if (name == NULL) {
+    put_str(out, "UNKNOWN id=");
+    put_uint(out, (unsigned)msg->id);
+    return;
+  }
+  put_str(out, name);
+
+  if (msg_is_macaddr_list(msg->id)) {
+    count = msg->sta_join.data_macaddr_count;
+    put_str(out, " count=");
+    put_uint(out, count);
+    if (count > DCWMSG_MAX_ENTRIES) return;
+    put_str(out, " macaddrs=");
+    for (i = 0; i < count; i++) {
+      if (i > 0) put_char(out, ',');
+      put_macaddr(out, msg->sta_join.data_macaddrs[i]);
+    }
+  }
+  else if (msg->id == DCWMSG_STA_ACK) {
+    count = msg->sta_ack.bonded_data_channel_count;
+    put_str(out, " count=");
+    put_uint(out, count);
+    if (count > DCWMSG_MAX_ENTRIES) return;
+    put_str(out, " channels=");
+    for (i = 0; i < count; i++) {
+      if (i > 0) put_char(out, ',');
+      put_macaddr(out, msg->sta_ack.bonded_data_channels[i].macaddr);
+      put_str(out, "->'");
+      put_ssid(out, msg->sta_ack.bonded_data_channels[i].ssid);
+      put_char(out, '\'');
+    }
+  }
+  else if (msg->id == DCWMSG_AP_ACCEPT_STA) {
+    count = msg->ap_accept_sta.data_ssid_count;
+    put_str(out, " count=");
+    put_uint(out, count);
+    if (count > DCWMSG_MAX_ENTRIES) return;
+    put_str(out, " ssids=");
+    for (i = 0; i < count; i++) {
+      if (i > 0) put_char(out, ',');
+      put_char(out, '\'');
+      put_ssid(out, msg->ap_accept_sta.data_ssids[i]);
+      put_char(out, '\'');
+    }
+  }
+}
+
+static void
+format_json(struct format_out * const out, const struct dcwmsg * const msg) {
+  const char *name;
+  unsigned count;
+  unsigned i;
+
+  if (msg == NULL) {
+    put_str(out, "null");
+    return;
+  }
+
+  name = msg_id_name(msg->id);
+  if (name == NULL) {
+    put_str(out, "{\"id\":");
+    put_uint(out, (unsigned)msg->id);
+    put_char(out, '}');
+    return;
+  }
+  put_str(out, "{\"id\":\"");
+  put_str(out, name);
+  put_char(out, '"');
+
+  if (msg_is_macaddr_list(msg->id)) {
+    count = msg->sta_join.data_macaddr_count;
+    if (count > DCWMSG_MAX_ENTRIES) {
+      put_str(out, ",\"error\":\"count too high\"}");
+      return;
+    }
+    put_str(out, ",\"data_macaddrs\":[");
+    for (i = 0; i < count; i++) {
+      if (i > 0) put_char(out, ',');
+      put_char(out, '"');
+      put_macaddr(out, msg->sta_join.data_macaddrs[i]);
+      put_char(out, '"');
+    }
+    put_char(out, ']');
+  }
+  else if (msg->id == DCWMSG_STA_ACK) {
+    count = msg->sta_ack.bonded_data_channel_count;
+    if (count > DCWMSG_MAX_ENTRIES) {
+      put_str(out, ",\"error\":\"count too high\"}");
+      return;
+    }
+    put_str(out, ",\"bonded_data_channels\":[");
+    for (i = 0; i < count; i++) {
+      if (i > 0) put_char(out, ',');
+      put_str(out, "{\"macaddr\":\"");
+      put_macaddr(out, msg->sta_ack.bonded_data_channels[i].macaddr);
+      put_str(out, "\",\"ssid\":");
+      put_json_ssid(out, msg->sta_ack.bonded_data_channels[i].ssid);
+      put_char(out, '}');
+    }
+    put_char(out, ']');
+  }
+  else if (msg->id == DCWMSG_AP_ACCEPT_STA) {
+    count = msg->ap_accept_sta.data_ssid_count;
+    if (count > DCWMSG_MAX_ENTRIES) {
+      put_str(out, ",\"error\":\"count too high\"}");
+      return;
+    }
+    put_str(out, ",\"data_ssids\":[");
+    for (i = 0; i < count; i++) {
+      if (i > 0) put_char(out, ',');
+      put_json_ssid(out, msg->ap_accept_sta.data_ssids[i]);
+    }
+    put_char(out, ']');
+  }
+
+  put_char(out, '}');
+}
+
+unsigned WIN32_EXPORT
+dcwmsg_format(char * const buf, const unsigned buf_len, const struct dcwmsg * const msg, const enum dcwmsg_format_mode mode) {
+  struct format_out out;
+
+  out.buf     = buf;
+  out.buf_len = buf_len;
+  out.pos     = 0;
+
+  switch (mode) {
+  case DCWMSG_FORMAT_DUMP:  format_dump(&out, msg); break;
+  case DCWMSG_FORMAT_JSON:  format_json(&out, msg); break;
+  default:                  format_line(&out, msg); break;
+  }
+
+  /* always NUL terminate, truncating if need be */
+  if (buf_len > 0) buf[(out.pos < buf_len) ? out.pos : (buf_len - 1)] = '\0';
+  return out.pos;
+}
+
@@ -0,0 +1,78 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef WIN32
+
+
+#include <config.h>
+#include <dcwproto.h>
+
+#include <sys/uio.h>
+
+
+
+/*
+
+  Scatter-gather serialization...
+  The MAC list messages are a 2-byte header (id + count) followed by the MAC
+  array exactly as it sits in the struct, so the header goes in the scratch
+  area and the second iovec points straight at the struct's MAC storage.
+  The SSID-bearing messages interleave length bytes with every entry, so they
+  are encoded into the scratch area in full (one iovec); splitting them would
+  cost more iovec entries than the bytes they save.
+
+*/
+unsigned
+dcwmsg_serialize_iov(struct iovec * const iov, const unsigned iov_len, unsigned char * const scratch, const unsigned scratch_len, const struct dcwmsg * const input) {
+  unsigned size;
+
+  if (iov_len < 1) return 0; /* serialize failed */
+
+  switch (input->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* all four MAC list structs share the same layout */
+    if (input->sta_join.data_macaddr_count > DCWMSG_MAX_ENTRIES) return 0;
+    if (scratch_len < 2) return 0;
+    scratch[0] = (unsigned char)(unsigned)input->id;
+    scratch[1] = (unsigned char)input->sta_join.data_macaddr_count;
+    iov[0].iov_base = scratch;
+    iov[0].iov_len  = 2;
+    if (input->sta_join.data_macaddr_count == 0) return 1;
+
+    if (iov_len < 2) return 0;
+    iov[1].iov_base = (void *)input->sta_join.data_macaddrs;
+    iov[1].iov_len  = input->sta_join.data_macaddr_count * sizeof(dcwmsg_macaddr_t);
+    return 2;
+
+  default:
+    size = dcwmsg_serialize_exact(scratch, input, scratch_len);
+    if (size == 0) return 0;
+    iov[0].iov_base = scratch;
+    iov[0].iov_len  = size;
+    return 1;
+  }
+}
+
+
+#endif /* #ifndef WIN32 */
+
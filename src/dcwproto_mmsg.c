@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* struct mmsghdr */
+#endif
+#include <config.h>
+#include <dcwproto.h>
+
+#ifdef __linux__
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define MMSG_CHUNK_SIZE 64
+
+
+
+/*
+
+  recvmmsg()/sendmmsg() adapters for the batch functions...
+  Only the first iovec of each message is used. A received datagram that
+  was truncated (MSG_TRUNC) fails, and msg_len is clamped to that iovec
+  since it can be larger when the datagram spans several.
+
+*/
+unsigned
+dcwmsg_marshal_mmsg(struct dcwmsg * const outputs, const struct mmsghdr * const msgs, int * const results, const unsigned count) {
+  const unsigned char *bufs[MMSG_CHUNK_SIZE];
+  unsigned buf_lens[MMSG_CHUNK_SIZE];
+  unsigned succeeded;
+  unsigned chunk_base;
+  unsigned chunk_len;
+  unsigned i;
+
+  succeeded = 0;
+  for (chunk_base = 0; chunk_base < count; chunk_base += chunk_len) {
+    chunk_len = count - chunk_base;
+    if (chunk_len > MMSG_CHUNK_SIZE) chunk_len = MMSG_CHUNK_SIZE;
+
+    for (i = 0; i < chunk_len; i++) {
+      if ((msgs[chunk_base + i].msg_hdr.msg_iovlen < 1) || (msgs[chunk_base + i].msg_hdr.msg_flags & MSG_TRUNC)) {
+        bufs[i]     = NULL;
+        buf_lens[i] = 0; /* fails as truncated */
+        continue;
+      }
+      bufs[i]     = msgs[chunk_base + i].msg_hdr.msg_iov[0].iov_base;
+      buf_lens[i] = msgs[chunk_base + i].msg_len;
+      if (buf_lens[i] > msgs[chunk_base + i].msg_hdr.msg_iov[0].iov_len) buf_lens[i] = (unsigned)msgs[chunk_base + i].msg_hdr.msg_iov[0].iov_len;
+    }
+
+    succeeded += dcwmsg_marshal_batch(&outputs[chunk_base], bufs, buf_lens, &results[chunk_base], chunk_len);
+  }
+
+  return succeeded;
+}
+
+unsigned
+dcwmsg_serialize_mmsg(struct mmsghdr * const msgs, const struct dcwmsg * const inputs, unsigned * const results, const unsigned count) {
+  unsigned char *bufs[MMSG_CHUNK_SIZE];
+  unsigned buf_lens[MMSG_CHUNK_SIZE];
+  unsigned succeeded;
+  unsigned chunk_base;
+  unsigned chunk_len;
+  unsigned i;
+
+  succeeded = 0;
+  for (chunk_base = 0; chunk_base < count; chunk_base += chunk_len) {
+    chunk_len = count - chunk_base;
+    if (chunk_len > MMSG_CHUNK_SIZE) chunk_len = MMSG_CHUNK_SIZE;
+
+    for (i = 0; i < chunk_len; i++) {
+      if (msgs[chunk_base + i].msg_hdr.msg_iovlen < 1) {
+        bufs[i]     = NULL;
+        buf_lens[i] = 0;
+        continue;
+      }
+      bufs[i]     = msgs[chunk_base + i].msg_hdr.msg_iov[0].iov_base;
+      buf_lens[i] = (unsigned)msgs[chunk_base + i].msg_hdr.msg_iov[0].iov_len;
+    }
+
+    succeeded += dcwmsg_serialize_batch(bufs, &inputs[chunk_base], buf_lens, &results[chunk_base], chunk_len);
+
+    /* trim each iovec down to what was written so sendmmsg() can go as-is */
+    for (i = 0; i < chunk_len; i++) {
+      if (results[chunk_base + i] == 0) continue;
+      msgs[chunk_base + i].msg_hdr.msg_iovlen = 1;
+      msgs[chunk_base + i].msg_hdr.msg_iov[0].iov_len = results[chunk_base + i];
+    }
+  }
+
+  return succeeded;
+}
+
+#endif /* #ifdef __linux__ */
+
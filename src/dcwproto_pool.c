@@ -0,0 +1,119 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+
+#include <stdlib.h>
+
+
+
+/*
+
+  Message/buffer pool functions begin here...
+  Everything is allocated once at creation time. Free slots are kept on
+  an index stack, so get/put are O(1) and never touch the system allocator.
+  A pool has no locking; use one pool per thread.
+
+*/
+struct dcwmsg_pool {
+  struct dcwmsg    *msgs;
+  unsigned char    *bufs;
+  unsigned         *msg_free;   /* stack of free message slot indexes */
+  unsigned         *buf_free;   /* stack of free buffer slot indexes */
+  unsigned          msg_count;
+  unsigned          buf_count;
+  unsigned          msg_free_top;
+  unsigned          buf_free_top;
+};
+
+void WIN32_EXPORT
+dcwmsg_pool_reset(struct dcwmsg_pool * const pool) {
+  unsigned i;
+
+  for (i = 0; i < pool->msg_count; i++) pool->msg_free[i] = pool->msg_count - i - 1;
+  for (i = 0; i < pool->buf_count; i++) pool->buf_free[i] = pool->buf_count - i - 1;
+  pool->msg_free_top = pool->msg_count;
+  pool->buf_free_top = pool->buf_count;
+}
+
+struct dcwmsg_pool * WIN32_EXPORT
+dcwmsg_pool_create(const unsigned msg_count, const unsigned buf_count) {
+  struct dcwmsg_pool *pool;
+
+  pool = calloc(1, sizeof(*pool));
+  if (pool == NULL) return NULL;
+
+  pool->msg_count = msg_count;
+  pool->buf_count = buf_count;
+  pool->msgs      = malloc(sizeof(struct dcwmsg) * (msg_count ? msg_count : 1));
+  pool->bufs      = malloc(DCWMSG_MAX_SERIALIZED_SIZE * (buf_count ? buf_count : 1));
+  pool->msg_free  = malloc(sizeof(unsigned) * (msg_count ? msg_count : 1));
+  pool->buf_free  = malloc(sizeof(unsigned) * (buf_count ? buf_count : 1));
+  if ((pool->msgs == NULL) || (pool->bufs == NULL) || (pool->msg_free == NULL) || (pool->buf_free == NULL)) {
+    dcwmsg_pool_destroy(pool);
+    return NULL;
+  }
+
+  dcwmsg_pool_reset(pool);
+  return pool;
+}
+
+void WIN32_EXPORT
+dcwmsg_pool_destroy(struct dcwmsg_pool * const pool) {
+  if (pool == NULL) return;
+  free(pool->msgs);
+  free(pool->bufs);
+  free(pool->msg_free);
+  free(pool->buf_free);
+  free(pool);
+}
+
+struct dcwmsg * WIN32_EXPORT
+dcwmsg_pool_get_msg(struct dcwmsg_pool * const pool) {
+  if (pool->msg_free_top == 0) return NULL; /* exhausted */
+  return &pool->msgs[pool->msg_free[--pool->msg_free_top]];
+}
+
+void WIN32_EXPORT
+dcwmsg_pool_put_msg(struct dcwmsg_pool * const pool, struct dcwmsg * const msg) {
+  if (msg == NULL) return;
+  if ((msg < pool->msgs) || (msg >= (pool->msgs + pool->msg_count))) return; /* not from this pool */
+  if (pool->msg_free_top >= pool->msg_count) return; /* every slot is already free: double put */
+  pool->msg_free[pool->msg_free_top++] = (unsigned)(msg - pool->msgs);
+}
+
+unsigned char * WIN32_EXPORT
+dcwmsg_pool_get_buf(struct dcwmsg_pool * const pool) {
+  if (pool->buf_free_top == 0) return NULL; /* exhausted */
+  return &pool->bufs[pool->buf_free[--pool->buf_free_top] * DCWMSG_MAX_SERIALIZED_SIZE];
+}
+
+void WIN32_EXPORT
+dcwmsg_pool_put_buf(struct dcwmsg_pool * const pool, unsigned char * const buf) {
+  if (buf == NULL) return;
+  if ((buf < pool->bufs) || (buf >= (pool->bufs + ((size_t)pool->buf_count * DCWMSG_MAX_SERIALIZED_SIZE)))) return; /* not from this pool */
+  if (((size_t)(buf - pool->bufs) % DCWMSG_MAX_SERIALIZED_SIZE) != 0) return; /* not the start of a slot */
+  if (pool->buf_free_top >= pool->buf_count) return; /* every slot is already free: double put */
+  pool->buf_free[pool->buf_free_top++] = (unsigned)((buf - pool->bufs) / DCWMSG_MAX_SERIALIZED_SIZE);
+}
+
@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define HAVE_SSE2_KERNEL 1
+#include <emmintrin.h>
+#endif
+
+
+
+/*
+
+  MAC address validation functions begin here...
+  A data channel MAC address is rejected if it is a group address (the I/G
+  bit of the first octet is set; this includes broadcast) or all zeros.
+
+*/
+static int
+macaddr_is_acceptable(const unsigned char * const macaddr) {
+  if (macaddr[0] & 0x01) return 0; /* multicast / broadcast */
+  if ((macaddr[0] | macaddr[1] | macaddr[2] | macaddr[3] | macaddr[4] | macaddr[5]) == 0) return 0; /* all zeros */
+  return 1;
+}
+
+#ifdef HAVE_SSE2_KERNEL
+/*
+  6-byte records line up with 16-byte vectors every 48 bytes, so each pass
+  checks 8 MAC addresses with 3 loads: the I/G bits are picked out with a
+  per-load mask, and the zero-byte movemasks are stitched into one 48-bit
+  mask where an all-zero MAC address shows up as a run of 6 set bits.
+*/
+static unsigned
+macaddrs_check_sse2(const unsigned char * const macaddrs, const unsigned count) {
+  const __m128i group_bit0 = _mm_setr_epi8(1,0,0,0,0,0, 1,0,0,0,0,0, 1,0,0,0);
+  const __m128i group_bit1 = _mm_setr_epi8(0,0, 1,0,0,0,0,0, 1,0,0,0,0,0, 1,0);
+  const __m128i group_bit2 = _mm_setr_epi8(0,0,0,0, 1,0,0,0,0,0, 1,0,0,0,0,0);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v0, v1, v2;
+  unsigned long long zero_bytes;
+  unsigned i, k;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v0 = _mm_loadu_si128((const __m128i *)&macaddrs[(i * 6)]);
+    v1 = _mm_loadu_si128((const __m128i *)&macaddrs[(i * 6) + 16]);
+    v2 = _mm_loadu_si128((const __m128i *)&macaddrs[(i * 6) + 32]);
+
+    /* any I/G bit set in this block? */
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(_mm_or_si128(
+          _mm_and_si128(v0, group_bit0),
+          _mm_and_si128(v1, group_bit1)),
+          _mm_and_si128(v2, group_bit2)), zero)) != 0xFFFF) {
+      return 0;
+    }
+
+    /* any all-zero MAC address in this block? */
+    zero_bytes =  (unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v0, zero))
+               | ((unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v1, zero)) << 16)
+               | ((unsigned long long)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v2, zero)) << 32);
+    if (zero_bytes != 0) {
+      for (k = 0; k < 8; k++) {
+        if (((zero_bytes >> (k * 6)) & 0x3F) == 0x3F) return 0;
+      }
+    }
+  }
+
+  return i; /* number of MAC addresses checked; the caller does the tail */
+}
+#endif
+
+static unsigned long long
+macaddr_key(const unsigned char * const macaddr) {
+  return ((unsigned long long)macaddr[0] << 40) |
+         ((unsigned long long)macaddr[1] << 32) |
+         ((unsigned long long)macaddr[2] << 24) |
+         ((unsigned long long)macaddr[3] << 16) |
+         ((unsigned long long)macaddr[4] <<  8) |
+         ((unsigned long long)macaddr[5]);
+}
+
+static int
+compare_keys(const void * const a, const void * const b) {
+  const unsigned long long ka = *(const unsigned long long *)a;
+  const unsigned long long kb = *(const unsigned long long *)b;
+  return (ka > kb) - (ka < kb);
+}
+
+static int
+macaddrs_have_duplicates(const unsigned char * const macaddrs, const unsigned stride, const unsigned count) {
+  unsigned long long local_keys[DCWMSG_MAX_ENTRIES];
+  unsigned long long *keys;
+  unsigned long long key;
+  unsigned i, j;
+  int rv;
+
+  if (count < 2) return 0;
+
+  keys = local_keys;
+  if (count > DCWMSG_MAX_ENTRIES) {
+    keys = malloc(sizeof(*keys) * count);
+    if (keys == NULL) return 1; /* can't tell; fail closed */
+  }
+
+  /* small lists get an insertion sort, bigger ones qsort */
+  for (i = 0; i < count; i++) {
+    key = macaddr_key(&macaddrs[i * stride]);
+    if (count > DCWMSG_MAX_ENTRIES) {
+      keys[i] = key;
+      continue;
+    }
+    for (j = i; (j > 0) && (keys[j - 1] > key); j--) keys[j] = keys[j - 1];
+    keys[j] = key;
+  }
+  if (count > DCWMSG_MAX_ENTRIES) qsort(keys, count, sizeof(*keys), compare_keys);
+
+  rv = 0;
+  for (i = 1; i < count; i++) {
+    if (keys[i] == keys[i - 1]) {
+      rv = 1;
+      break;
+    }
+  }
+
+  if (keys != local_keys) free(keys);
+  return rv;
+}
+
+int WIN32_EXPORT
+dcwmsg_validate_macaddrs(const unsigned char * const macaddrs, const unsigned count, const unsigned flags) {
+  unsigned i;
+
+  if (flags & DCWMSG_VALIDATE_ADDRESSES) {
+    i = 0;
+#ifdef HAVE_SSE2_KERNEL
+    if (count >= 8) {
+      i = macaddrs_check_sse2(macaddrs, count);
+      if (i == 0) return 0;
+    }
+#endif
+    for (; i < count; i++) {
+      if (!macaddr_is_acceptable(&macaddrs[i * sizeof(dcwmsg_macaddr_t)])) return 0;
+    }
+  }
+
+  if (flags & DCWMSG_VALIDATE_DUPLICATES) {
+    if (macaddrs_have_duplicates(macaddrs, sizeof(dcwmsg_macaddr_t), count)) return 0;
+  }
+
+  return 1; /* valid */
+}
+
+int WIN32_EXPORT
+dcwmsg_validate_view(const struct dcwmsg_view * const view, const unsigned flags) {
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+  unsigned char macaddrs[DCWMSG_MAX_ENTRIES * sizeof(dcwmsg_macaddr_t)];
+  unsigned i;
+
+  switch (view->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* MAC list messages are validated in place */
+    return dcwmsg_validate_macaddrs(view->entries, view->count, flags);
+
+  case DCWMSG_STA_ACK:
+    /* bonded channel MAC addresses are interleaved with SSIDs; gather them first */
+    dcwmsg_view_iter_init(&iter, view);
+    for (i = 0; dcwmsg_view_iter_next(&iter, &entry); i++) {
+      memcpy(&macaddrs[i * sizeof(dcwmsg_macaddr_t)], entry.macaddr, sizeof(dcwmsg_macaddr_t));
+    }
+    return dcwmsg_validate_macaddrs(macaddrs, view->count, flags);
+
+  default:
+    return 1; /* no MAC addresses to validate */
+  }
+}
+
+int WIN32_EXPORT
+dcwmsg_marshal_validated(struct dcwmsg * const output, const unsigned char * const buf, const unsigned buf_len, const unsigned flags) {
+  struct dcwmsg_view view;
+
+  if (!dcwmsg_view_init(&view, buf, buf_len)) return 0; /* marshal failed */
+  if (!dcwmsg_validate_view(&view, flags)) return 0; /* validation failed */
+  return dcwmsg_view_marshal(output, &view);
+}
+
@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwproto.h>
+#include "dcwproto_view_validate.h"
+
+#include <string.h>
+
+
+
+/*
+
+  View validation functions begin here...
+  Each checks "count" entries packed at "entries" (the bytes after the count
+  byte) and stores the number of bytes they span in "span". Shared with the
+  compact functions, whose entries are stored apart from the count.
+
+*/
+static int
+dcwmsg_view_validate_macaddrs(const unsigned count, const unsigned entries_len, unsigned * const span) {
+  if (count > DCWMSG_MAX_ENTRIES) return 0; /* count too big */
+
+  (*span) = count * sizeof(dcwmsg_macaddr_t);
+  if (entries_len < (*span)) return 0; /* not enough input data... */
+  return 1;
+}
+
+static int
+dcwmsg_view_validate_sta_ack(const unsigned count, const unsigned char * const entries, const unsigned entries_len, unsigned * const span) {
+  unsigned offset;
+  unsigned ssid_len;
+  unsigned i;
+
+  if (count > DCWMSG_MAX_ENTRIES) return 0; /* count too big */
+
+  offset = 0;
+  for (i = 0; i < count; i++) {
+    /* mac address plus the ssid length byte */
+    if ((entries_len - offset) < (sizeof(dcwmsg_macaddr_t) + 1)) return 0;
+    offset += sizeof(dcwmsg_macaddr_t);
+    ssid_len = (unsigned)entries[offset++];
+    if (ssid_len > sizeof(dcwmsg_ssid_t)) return 0;
+
+    /* ssid string bytes */
+    if ((entries_len - offset) < ssid_len) return 0;
+    offset += ssid_len;
+  }
+
+  (*span) = offset;
+  return 1;
+}
+
+static int
+dcwmsg_view_validate_ap_accept_sta(const unsigned count, const unsigned char * const entries, const unsigned entries_len, unsigned * const span) {
+  unsigned offset;
+  unsigned ssid_len;
+  unsigned i;
+
+  if (count > DCWMSG_MAX_ENTRIES) return 0; /* count too big */
+
+  offset = 0;
+  for (i = 0; i < count; i++) {
+    /* ssid length byte */
+    if ((entries_len - offset) < 1) return 0;
+    ssid_len = (unsigned)entries[offset++];
+    if (ssid_len > sizeof(dcwmsg_ssid_t)) return 0;
+
+    /* ssid string bytes */
+    if ((entries_len - offset) < ssid_len) return 0;
+    offset += ssid_len;
+  }
+
+  (*span) = offset;
+  return 1;
+}
+
+int
+dcwmsg_view_validate_entries(const enum dcwmsg_id id, const unsigned count, const unsigned char * const entries, const unsigned entries_len, unsigned * const span) {
+  switch (id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    return dcwmsg_view_validate_macaddrs(count, entries_len, span);
+  case DCWMSG_STA_ACK:
+    return dcwmsg_view_validate_sta_ack(count, entries, entries_len, span);
+  case DCWMSG_AP_ACCEPT_STA:
+    return dcwmsg_view_validate_ap_accept_sta(count, entries, entries_len, span);
+  default:
+    return 0; /* unknown id, or an ID only message (which has no entries) */
+  }
+}
+
+int WIN32_EXPORT
+dcwmsg_view_init(struct dcwmsg_view * const output, const unsigned char * const buf, const unsigned buf_len) {
+  unsigned span;
+
+  if (buf_len < 1) return 0; /* view failed */
+
+  output->id      = (enum dcwmsg_id)buf[0];
+  output->count   = 0;
+  output->entries = NULL;
+
+  switch (output->id) {
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    /* these messages are ID only */
+    output->length  = 1;
+    return 1;
+  default:
+    break;
+  }
+
+  if (buf_len < 2) return 0; /* no count byte */
+  output->count = (unsigned)buf[1];
+  if (!dcwmsg_view_validate_entries(output->id, output->count, buf + 2, buf_len - 2, &span)) return 0; /* view failed */
+  output->entries = buf + 2; /* skip the id and count bytes */
+  output->length  = span + 2;
+  return 1; /* success */
+}
+
+
+
+
+/*
+
+  View accessor functions begin here...
+
+*/
+const unsigned char * WIN32_EXPORT
+dcwmsg_view_macaddr(const struct dcwmsg_view * const view, const unsigned index) {
+  switch (view->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    if (index >= view->count) return NULL;
+    return view->entries + (index * sizeof(dcwmsg_macaddr_t));
+  default:
+    return NULL; /* no random access on variable-length entries; use the iterator */
+  }
+}
+
+void WIN32_EXPORT
+dcwmsg_view_iter_init(struct dcwmsg_view_iter * const iter, const struct dcwmsg_view * const view) {
+  iter->view  = view;
+  iter->pos   = view->entries;
+  iter->index = 0;
+}
+
+int WIN32_EXPORT
+dcwmsg_view_iter_next(struct dcwmsg_view_iter * const iter, struct dcwmsg_view_entry * const output) {
+  if (iter->index >= iter->view->count) return 0; /* end of entries */
+
+  /* the view has already been validated, so no bounds checks are needed here */
+  switch (iter->view->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    output->macaddr  = iter->pos;
+    output->ssid     = NULL;
+    output->ssid_len = 0;
+    iter->pos += sizeof(dcwmsg_macaddr_t);
+    break;
+
+  case DCWMSG_STA_ACK:
+    output->macaddr  = iter->pos;
+    iter->pos += sizeof(dcwmsg_macaddr_t);
+    output->ssid_len = (unsigned)*iter->pos++;
+    output->ssid     = (const char *)iter->pos;
+    iter->pos += output->ssid_len;
+    break;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    output->macaddr  = NULL;
+    output->ssid_len = (unsigned)*iter->pos++;
+    output->ssid     = (const char *)iter->pos;
+    iter->pos += output->ssid_len;
+    break;
+
+  default:
+    return 0;
+  }
+
+  iter->index++;
+  return 1;
+}
+
+
+
+
+/*
+
+  Peek...
+
+*/
+int WIN32_EXPORT
+dcwmsg_peek(const unsigned char * const buf, const unsigned buf_len, enum dcwmsg_id * const id, unsigned * const count, unsigned * const length) {
+  struct dcwmsg_view view;
+
+  if (!dcwmsg_view_init(&view, buf, buf_len)) return 0; /* peek failed */
+
+  if (id != NULL)     (*id)     = view.id;
+  if (count != NULL)  (*count)  = view.count;
+  if (length != NULL) (*length) = view.length;
+  return 1; /* success */
+}
+
+
+
+
+/*
+
+  View to struct conversion...
+  For the messages that do need a full decode after classification.
+  Skips re-validation since dcwmsg_view_init() has already done it.
+
+*/
+int WIN32_EXPORT
+dcwmsg_view_marshal(struct dcwmsg * const output, const struct dcwmsg_view * const view) {
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+  unsigned i;
+
+  output->id = view->id;
+
+  switch (view->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* all four MAC list structs share the same layout */
+    output->sta_join.data_macaddr_count = view->count;
+    memcpy(output->sta_join.data_macaddrs, view->entries, view->count * sizeof(dcwmsg_macaddr_t));
+    return 1;
+
+  case DCWMSG_STA_ACK:
+    output->sta_ack.bonded_data_channel_count = view->count;
+    dcwmsg_view_iter_init(&iter, view);
+    for (i = 0; dcwmsg_view_iter_next(&iter, &entry); i++) {
+      memcpy(output->sta_ack.bonded_data_channels[i].macaddr, entry.macaddr, sizeof(dcwmsg_macaddr_t));
+      memcpy(output->sta_ack.bonded_data_channels[i].ssid, entry.ssid, entry.ssid_len);
+      if (entry.ssid_len < sizeof(dcwmsg_ssid_t)) {
+        output->sta_ack.bonded_data_channels[i].ssid[entry.ssid_len] = '\0';
+      }
+    }
+    return 1;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    output->ap_accept_sta.data_ssid_count = view->count;
+    dcwmsg_view_iter_init(&iter, view);
+    for (i = 0; dcwmsg_view_iter_next(&iter, &entry); i++) {
+      memcpy(output->ap_accept_sta.data_ssids[i], entry.ssid, entry.ssid_len);
+      if (entry.ssid_len < sizeof(dcwmsg_ssid_t)) {
+        output->ap_accept_sta.data_ssids[i][entry.ssid_len] = '\0';
+      }
+    }
+    return 1;
+
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    return 1; /* this message is ID only */
+
+  default:
+    return 0;
+  }
+}
+
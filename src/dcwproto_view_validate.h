@@ -0,0 +1,42 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWPROTO_VIEW_VALIDATE_H_INCLUDED
+#define DCWPROTO_VIEW_VALIDATE_H_INCLUDED
+
+/*
+  Library-internal entry validation shared by the view and compact
+  functions (not installed). Checks "count" entries of message "id" packed
+  at "entries" (everything after the count byte) and stores the number of
+  bytes they span in "span"; returns 0 for invalid entries, unknown ids and
+  ID only messages.
+
+  dcwmsg_compact_from_view() copies a view that has already been validated
+  into "output", so the codec contexts can check a view before compacting it
+  without a second validation pass; returns the bytes used, 0 when
+  "output_size" is too small.
+*/
+#include <dcwproto.h>
+
+int dcwmsg_view_validate_entries(const enum dcwmsg_id /* id */, const unsigned /* count */, const unsigned char * const /* entries */, const unsigned /* entries_len */, unsigned * const /* span */);
+unsigned dcwmsg_compact_from_view(struct dcwmsg_compact * const /* output */, const unsigned /* output_size */, const struct dcwmsg_view * const /* view */);
+
+
+#endif /* #ifndef DCWPROTO_VIEW_VALIDATE_H_INCLUDED */
@@ -0,0 +1,256 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwssid.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+
+/*
+
+  SSID pool functions begin here...
+  SSIDs live in fixed 32-byte slots indexed by handle; an open addressing
+  index (<= 50% load) maps hash -> handle. Each bucket caches the full hash,
+  so interning a repeat SSID is one hash plus (almost always) one memcmp.
+
+*/
+struct ssid_slot {
+  unsigned char   len;
+  char            bytes[sizeof(dcwmsg_ssid_t)];
+};
+
+struct ssid_bucket {
+  unsigned          hash;
+  dcwssid_handle_t  handle; /* DCWSSID_INVALID_HANDLE when empty */
+};
+
+struct dcwssid_pool {
+  struct ssid_slot    *slots;
+  struct ssid_bucket  *buckets;
+  unsigned             bucket_mask;
+  unsigned             max_ssids;
+  unsigned             count;
+};
+
+static unsigned
+ssid_hash(const char * const ssid, const unsigned ssid_len) {
+  unsigned h;
+  unsigned i;
+
+  /* FNV-1a */
+  h = 2166136261u;
+  for (i = 0; i < ssid_len; i++) {
+    h ^= (unsigned char)ssid[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void WIN32_EXPORT
+dcwssid_pool_reset(struct dcwssid_pool * const pool) {
+  unsigned i;
+
+  for (i = 0; i <= pool->bucket_mask; i++) pool->buckets[i].handle = DCWSSID_INVALID_HANDLE;
+  pool->count = 0;
+}
+
+struct dcwssid_pool * WIN32_EXPORT
+dcwssid_pool_create(const unsigned max_ssids) {
+  struct dcwssid_pool *pool;
+  unsigned buckets;
+
+  if (max_ssids >= DCWSSID_INVALID_HANDLE) return NULL; /* handles are 16 bits */
+
+  pool = calloc(1, sizeof(*pool));
+  if (pool == NULL) return NULL;
+
+  for (buckets = 16; buckets < (max_ssids * 2); buckets *= 2) ;
+  pool->bucket_mask = buckets - 1;
+  pool->max_ssids   = max_ssids;
+  pool->slots       = malloc(sizeof(*pool->slots) * (max_ssids ? max_ssids : 1));
+  pool->buckets     = malloc(sizeof(*pool->buckets) * buckets);
+  if ((pool->slots == NULL) || (pool->buckets == NULL)) {
+    dcwssid_pool_destroy(pool);
+    return NULL;
+  }
+
+  dcwssid_pool_reset(pool);
+  return pool;
+}
+
+void WIN32_EXPORT
+dcwssid_pool_destroy(struct dcwssid_pool * const pool) {
+  if (pool == NULL) return;
+  free(pool->slots);
+  free(pool->buckets);
+  free(pool);
+}
+
+dcwssid_handle_t WIN32_EXPORT
+dcwssid_intern(struct dcwssid_pool * const pool, const char * const ssid, const unsigned ssid_len) {
+  struct ssid_bucket *bucket;
+  struct ssid_slot *slot;
+  unsigned hash;
+  unsigned i;
+
+  if (ssid_len > sizeof(dcwmsg_ssid_t)) return DCWSSID_INVALID_HANDLE;
+
+  hash = ssid_hash(ssid, ssid_len);
+  for (i = hash & pool->bucket_mask; ; i = (i + 1) & pool->bucket_mask) {
+    bucket = &pool->buckets[i];
+    if (bucket->handle == DCWSSID_INVALID_HANDLE) break;
+    if (bucket->hash != hash) continue;
+    slot = &pool->slots[bucket->handle];
+    if ((slot->len == ssid_len) && (memcmp(slot->bytes, ssid, ssid_len) == 0)) return bucket->handle;
+  }
+
+  /* first time this SSID has been seen */
+  if (pool->count >= pool->max_ssids) return DCWSSID_INVALID_HANDLE; /* pool full */
+  bucket->hash   = hash;
+  bucket->handle = (dcwssid_handle_t)pool->count++;
+  slot = &pool->slots[bucket->handle];
+  slot->len = (unsigned char)ssid_len;
+  memcpy(slot->bytes, ssid, ssid_len);
+  return bucket->handle;
+}
+
+const char * WIN32_EXPORT
+dcwssid_get(const struct dcwssid_pool * const pool, const dcwssid_handle_t handle, unsigned * const ssid_len) {
+  if (handle >= pool->count) return NULL;
+  if (ssid_len != NULL) (*ssid_len) = pool->slots[handle].len;
+  return pool->slots[handle].bytes;
+}
+
+
+
+/*
+
+  Interned marshal/serialize functions begin here...
+  Wire validation is the same as dcwmsg_marshal(), done by the view.
+
+*/
+int WIN32_EXPORT
+dcwssid_marshal_sta_ack(struct dcwssid_pool * const pool, struct dcwmsg_sta_ack_interned * const output, const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+  unsigned i;
+
+  if (!dcwmsg_view_init(&view, buf, buf_len)) return 0;
+  if (view.id != DCWMSG_STA_ACK) return 0;
+
+  dcwmsg_view_iter_init(&iter, &view);
+  for (i = 0; dcwmsg_view_iter_next(&iter, &entry); i++) {
+    memcpy(output->bonded_data_channels[i].macaddr, entry.macaddr, sizeof(dcwmsg_macaddr_t));
+    output->bonded_data_channels[i].ssid = dcwssid_intern(pool, entry.ssid, entry.ssid_len);
+    if (output->bonded_data_channels[i].ssid == DCWSSID_INVALID_HANDLE) return 0; /* pool full */
+  }
+  output->bonded_data_channel_count = view.count;
+  return 1;
+}
+
+int WIN32_EXPORT
+dcwssid_marshal_ap_accept_sta(struct dcwssid_pool * const pool, struct dcwmsg_ap_accept_sta_interned * const output, const unsigned char * const buf, const unsigned buf_len) {
+  struct dcwmsg_view view;
+  struct dcwmsg_view_iter iter;
+  struct dcwmsg_view_entry entry;
+  unsigned i;
+
+  if (!dcwmsg_view_init(&view, buf, buf_len)) return 0;
+  if (view.id != DCWMSG_AP_ACCEPT_STA) return 0;
+
+  dcwmsg_view_iter_init(&iter, &view);
+  for (i = 0; dcwmsg_view_iter_next(&iter, &entry); i++) {
+    output->data_ssids[i] = dcwssid_intern(pool, entry.ssid, entry.ssid_len);
+    if (output->data_ssids[i] == DCWSSID_INVALID_HANDLE) return 0; /* pool full */
+  }
+  output->data_ssid_count = view.count;
+  return 1;
+}
+
+/* the wire form of an SSID is its bytes up to the first NUL, as with dcwmsg_serialize() */
+static unsigned
+put_ssid(const struct dcwssid_pool * const pool, unsigned char * const buf, const unsigned buf_remaining, const dcwssid_handle_t handle) {
+  const struct ssid_slot *slot;
+  const char *nul;
+  unsigned len;
+
+  if (handle >= pool->count) return 0;
+  slot = &pool->slots[handle];
+  nul  = memchr(slot->bytes, '\0', slot->len);
+  len  = (nul == NULL) ? slot->len : (unsigned)(nul - slot->bytes);
+
+  if (buf_remaining < (1 + len)) return 0;
+  buf[0] = (unsigned char)len;
+  memcpy(&buf[1], slot->bytes, len);
+  return 1 + len;
+}
+
+unsigned WIN32_EXPORT
+dcwssid_serialize_sta_ack(const struct dcwssid_pool * const pool, unsigned char * const buf, const struct dcwmsg_sta_ack_interned * const input, const unsigned buf_len) {
+  unsigned pos;
+  unsigned rv;
+  unsigned i;
+
+  if (input->bonded_data_channel_count > DCWMSG_MAX_ENTRIES) return 0;
+  if (buf_len < 2) return 0;
+  buf[0] = DCWMSG_STA_ACK;
+  buf[1] = (unsigned char)input->bonded_data_channel_count;
+  pos = 2;
+
+  for (i = 0; i < input->bonded_data_channel_count; i++) {
+    if ((buf_len - pos) < sizeof(dcwmsg_macaddr_t)) return 0;
+    memcpy(&buf[pos], input->bonded_data_channels[i].macaddr, sizeof(dcwmsg_macaddr_t));
+    pos += sizeof(dcwmsg_macaddr_t);
+
+    rv = put_ssid(pool, &buf[pos], buf_len - pos, input->bonded_data_channels[i].ssid);
+    if (rv == 0) return 0;
+    pos += rv;
+  }
+
+  return pos;
+}
+
+unsigned WIN32_EXPORT
+dcwssid_serialize_ap_accept_sta(const struct dcwssid_pool * const pool, unsigned char * const buf, const struct dcwmsg_ap_accept_sta_interned * const input, const unsigned buf_len) {
+  unsigned pos;
+  unsigned rv;
+  unsigned i;
+
+  if (input->data_ssid_count > DCWMSG_MAX_ENTRIES) return 0;
+  if (buf_len < 2) return 0;
+  buf[0] = DCWMSG_AP_ACCEPT_STA;
+  buf[1] = (unsigned char)input->data_ssid_count;
+  pos = 2;
+
+  for (i = 0; i < input->data_ssid_count; i++) {
+    rv = put_ssid(pool, &buf[pos], buf_len - pos, input->data_ssids[i]);
+    if (rv == 0) return 0;
+    pos += rv;
+  }
+
+  return pos;
+}
+
@@ -0,0 +1,81 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWSSID_H_INCLUDED
+#define DCWSSID_H_INCLUDED
+
+#include <dcwproto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  SSID intern pool...
+  Each distinct SSID is stored once and referred to by a small handle. A pool
+  holds up to "max_ssids" SSIDs; handles stay valid until the pool is reset
+  or destroyed. A pool has no locking.
+*/
+typedef unsigned short dcwssid_handle_t;
+
+#define DCWSSID_INVALID_HANDLE ((dcwssid_handle_t)0xFFFF)
+
+struct dcwssid_pool;
+
+struct dcwssid_pool * WIN32_EXPORT dcwssid_pool_create(const unsigned /* max_ssids */);
+void WIN32_EXPORT dcwssid_pool_destroy(struct dcwssid_pool * const /* pool */);
+void WIN32_EXPORT dcwssid_pool_reset(struct dcwssid_pool * const /* pool */);
+
+/* returns DCWSSID_INVALID_HANDLE if the SSID is too long or the pool is full */
+dcwssid_handle_t WIN32_EXPORT dcwssid_intern(struct dcwssid_pool * const /* pool */, const char * const /* ssid */, const unsigned /* ssid_len */);
+const char * WIN32_EXPORT dcwssid_get(const struct dcwssid_pool * const /* pool */, const dcwssid_handle_t /* handle */, unsigned * const /* ssid_len */);
+
+
+/*
+  Interned forms of the SSID-bearing messages...
+  Same as struct dcwmsg_sta_ack / dcwmsg_ap_accept_sta, with handles in place
+  of the 32-byte SSID copies.
+*/
+struct dcwmsg_sta_ack_interned {
+  unsigned bonded_data_channel_count;
+  struct {
+    dcwmsg_macaddr_t  macaddr;
+    dcwssid_handle_t  ssid;
+  } bonded_data_channels[DCWMSG_MAX_ENTRIES];
+};
+
+struct dcwmsg_ap_accept_sta_interned {
+  unsigned            data_ssid_count;
+  dcwssid_handle_t    data_ssids[DCWMSG_MAX_ENTRIES];
+};
+
+/* the marshal functions take the full message (id byte included) */
+int WIN32_EXPORT dcwssid_marshal_sta_ack(struct dcwssid_pool * const /* pool */, struct dcwmsg_sta_ack_interned * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+int WIN32_EXPORT dcwssid_marshal_ap_accept_sta(struct dcwssid_pool * const /* pool */, struct dcwmsg_ap_accept_sta_interned * const /* output */, const unsigned char * const /* buf */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwssid_serialize_sta_ack(const struct dcwssid_pool * const /* pool */, unsigned char * const /* buf */, const struct dcwmsg_sta_ack_interned * const /* input */, const unsigned /* buf_len */);
+unsigned WIN32_EXPORT dcwssid_serialize_ap_accept_sta(const struct dcwssid_pool * const /* pool */, unsigned char * const /* buf */, const struct dcwmsg_ap_accept_sta_interned * const /* input */, const unsigned /* buf_len */);
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWSSID_H_INCLUDED */
@@ -0,0 +1,466 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwsta.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NIL 0xFFFFFFFFu
+
+
+
+/*
+
+  Open addressing map (64-bit key -> slot index)...
+  Linear probing at <= 50% load with backward-shift deletion, so there are
+  no tombstones and probe lengths stay short no matter the churn.
+
+*/
+struct u64map {
+  unsigned long long  *keys;
+  unsigned            *vals;  /* NIL marks an empty bucket */
+  unsigned             mask;
+};
+
+static unsigned long long
+hash_u64(unsigned long long k) {
+  /* murmur3 finalizer */
+  k ^= k >> 33;
+  k *= 0xFF51AFD7ED558CCDULL;
+  k ^= k >> 33;
+  k *= 0xC4CEB9FE1A85EC53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+static int
+u64map_init(struct u64map * const map, const unsigned max_entries) {
+  unsigned buckets;
+
+  for (buckets = 16; buckets < (max_entries * 2); buckets *= 2) ;
+  map->mask = buckets - 1;
+  map->keys = malloc(sizeof(*map->keys) * buckets);
+  map->vals = malloc(sizeof(*map->vals) * buckets);
+  if ((map->keys == NULL) || (map->vals == NULL)) return 0;
+  memset(map->vals, 0xFF, sizeof(*map->vals) * buckets);
+  return 1;
+}
+
+static void
+u64map_free(struct u64map * const map) {
+  free(map->keys);
+  free(map->vals);
+}
+
+/* returns the bucket holding "key", or the empty bucket where it would go */
+static unsigned
+u64map_bucket(const struct u64map * const map, const unsigned long long key) {
+  unsigned i;
+
+  for (i = (unsigned)hash_u64(key) & map->mask; map->vals[i] != NIL; i = (i + 1) & map->mask) {
+    if (map->keys[i] == key) break;
+  }
+  return i;
+}
+
+static unsigned
+u64map_get(const struct u64map * const map, const unsigned long long key) {
+  return map->vals[u64map_bucket(map, key)];
+}
+
+static void
+u64map_set(struct u64map * const map, const unsigned long long key, const unsigned val) {
+  unsigned i;
+
+  i = u64map_bucket(map, key);
+  map->keys[i] = key;
+  map->vals[i] = val;
+}
+
+static void
+u64map_del(struct u64map * const map, const unsigned long long key) {
+  unsigned i, j, home;
+
+  i = u64map_bucket(map, key);
+  if (map->vals[i] == NIL) return;
+
+  /* shift later members of the probe run back into the hole */
+  for (j = (i + 1) & map->mask; map->vals[j] != NIL; j = (j + 1) & map->mask) {
+    home = (unsigned)hash_u64(map->keys[j]) & map->mask;
+    if (((j > i) && ((home <= i) || (home > j))) || ((j < i) && ((home <= i) && (home > j)))) {
+      map->keys[i] = map->keys[j];
+      map->vals[i] = map->vals[j];
+      i = j;
+    }
+  }
+  map->vals[i] = NIL;
+}
+
+
+
+/*
+
+  Table storage...
+  Bindings live in a slab with stable indexes. Each binding sits on a
+  doubly linked chain of its station and (once bonded) of its SSID; the maps
+  point at the chain heads.
+
+*/
+struct binding_slot {
+  unsigned long long  data_key;
+  unsigned long long  primary_key;
+  unsigned long long  ssid_key;
+  unsigned            sta_prev, sta_next;
+  unsigned            ssid_prev, ssid_next;
+  unsigned char       state;
+  unsigned char       ssid_len;
+  char                ssid[sizeof(dcwmsg_ssid_t)];
+};
+
+struct dcwsta_table {
+  struct binding_slot *slots;
+  unsigned             max_bindings;
+  unsigned             count;
+  unsigned             free_head;   /* free slots are chained through sta_next */
+  struct u64map        by_data;     /* data MAC -> slot */
+  struct u64map        by_primary;  /* primary MAC -> first slot of the station chain */
+  struct u64map        by_ssid;     /* SSID hash -> first slot of the SSID chain */
+};
+
+static unsigned long long
+macaddr_key(const unsigned char * const macaddr) {
+  return ((unsigned long long)macaddr[0] << 40) |
+         ((unsigned long long)macaddr[1] << 32) |
+         ((unsigned long long)macaddr[2] << 24) |
+         ((unsigned long long)macaddr[3] << 16) |
+         ((unsigned long long)macaddr[4] <<  8) |
+         ((unsigned long long)macaddr[5]);
+}
+
+static void
+key_macaddr(unsigned char * const macaddr, const unsigned long long key) {
+  unsigned i;
+  for (i = 0; i < 6; i++) macaddr[i] = (unsigned char)(key >> (40 - (i * 8)));
+}
+
+static unsigned long long
+ssid_key(const char * const ssid, const unsigned ssid_len) {
+  unsigned long long h;
+  unsigned i;
+
+  /* FNV-1a; distinct SSIDs sharing a hash just share a chain */
+  h = 0xCBF29CE484222325ULL;
+  for (i = 0; i < ssid_len; i++) {
+    h ^= (unsigned char)ssid[i];
+    h *= 0x100000001B3ULL;
+  }
+  return h;
+}
+
+/* links/unlinks "slot" at the head of the chain keyed by "key" in "map" */
+#define CHAIN_LINK(TABLE, MAP, PREV, NEXT, KEY, SLOT) do {        \
+    unsigned head_ = u64map_get(&(TABLE)->MAP, (KEY));              \
+    (TABLE)->slots[SLOT].PREV = NIL;                                \
+    (TABLE)->slots[SLOT].NEXT = head_;                              \
+    if (head_ != NIL) (TABLE)->slots[head_].PREV = (SLOT);          \
+    u64map_set(&(TABLE)->MAP, (KEY), (SLOT));                       \
+  } while (0)
+
+#define CHAIN_UNLINK(TABLE, MAP, PREV, NEXT, KEY, SLOT) do {                          \
+    unsigned prev_ = (TABLE)->slots[SLOT].PREV;                                       \
+    unsigned next_ = (TABLE)->slots[SLOT].NEXT;                                       \
+    if (next_ != NIL) (TABLE)->slots[next_].PREV = prev_;                             \
+    if (prev_ != NIL) (TABLE)->slots[prev_].NEXT = next_;                             \
+    else if (next_ != NIL) u64map_set(&(TABLE)->MAP, (KEY), next_);                   \
+    else u64map_del(&(TABLE)->MAP, (KEY));                                            \
+  } while (0)
+
+struct dcwsta_table * WIN32_EXPORT
+dcwsta_table_create(const unsigned max_bindings) {
+  struct dcwsta_table *table;
+  unsigned i;
+
+  table = calloc(1, sizeof(*table));
+  if (table == NULL) return NULL;
+
+  table->max_bindings = max_bindings;
+  table->slots = malloc(sizeof(*table->slots) * (max_bindings ? max_bindings : 1));
+  if ((table->slots == NULL) ||
+      !u64map_init(&table->by_data, max_bindings) ||
+      !u64map_init(&table->by_primary, max_bindings) ||
+      !u64map_init(&table->by_ssid, max_bindings)) {
+    dcwsta_table_destroy(table);
+    return NULL;
+  }
+
+  for (i = 0; i < max_bindings; i++) table->slots[i].sta_next = i + 1;
+  if (max_bindings > 0) table->slots[max_bindings - 1].sta_next = NIL;
+  table->free_head = (max_bindings > 0) ? 0 : NIL;
+
+  return table;
+}
+
+void WIN32_EXPORT
+dcwsta_table_destroy(struct dcwsta_table * const table) {
+  if (table == NULL) return;
+  u64map_free(&table->by_data);
+  u64map_free(&table->by_primary);
+  u64map_free(&table->by_ssid);
+  free(table->slots);
+  free(table);
+}
+
+unsigned WIN32_EXPORT
+dcwsta_table_count(const struct dcwsta_table * const table) {
+  return table->count;
+}
+
+
+
+/*
+
+  Binding updates...
+
+*/
+static void
+binding_clear_ssid(struct dcwsta_table * const table, const unsigned slot) {
+  if (table->slots[slot].state != DCWSTA_BONDED) return; /* only bonded slots are on an SSID chain */
+  CHAIN_UNLINK(table, by_ssid, ssid_prev, ssid_next, table->slots[slot].ssid_key, slot);
+}
+
+static void
+binding_remove(struct dcwsta_table * const table, const unsigned long long data_key) {
+  unsigned slot;
+
+  slot = u64map_get(&table->by_data, data_key);
+  if (slot == NIL) return;
+
+  binding_clear_ssid(table, slot);
+  CHAIN_UNLINK(table, by_primary, sta_prev, sta_next, table->slots[slot].primary_key, slot);
+  u64map_del(&table->by_data, data_key);
+
+  table->slots[slot].sta_next = table->free_head;
+  table->free_head = slot;
+  table->count--;
+}
+
+/* finds or creates the binding for "data_key" owned by "primary_key" */
+static unsigned
+binding_upsert(struct dcwsta_table * const table, const unsigned long long data_key, const unsigned long long primary_key) {
+  struct binding_slot *b;
+  unsigned slot;
+
+  slot = u64map_get(&table->by_data, data_key);
+  if (slot != NIL) {
+    b = &table->slots[slot];
+    if (b->primary_key != primary_key) {
+      /* data channel moved to another station */
+      CHAIN_UNLINK(table, by_primary, sta_prev, sta_next, b->primary_key, slot);
+      b->primary_key = primary_key;
+      CHAIN_LINK(table, by_primary, sta_prev, sta_next, primary_key, slot);
+    }
+    return slot;
+  }
+
+  if (table->free_head == NIL) return NIL; /* table full */
+  slot = table->free_head;
+  table->free_head = table->slots[slot].sta_next;
+  table->count++;
+
+  b = &table->slots[slot];
+  b->data_key    = data_key;
+  b->primary_key = primary_key;
+  b->state       = DCWSTA_JOINING;
+  b->ssid_len    = 0;
+  u64map_set(&table->by_data, data_key, slot);
+  CHAIN_LINK(table, by_primary, sta_prev, sta_next, primary_key, slot);
+  return slot;
+}
+
+static int
+apply_join(struct dcwsta_table * const table, const unsigned long long primary_key, const struct dcwmsg_sta_join * const join) {
+  unsigned slot;
+  unsigned i;
+
+  for (i = 0; i < join->data_macaddr_count; i++) {
+    slot = binding_upsert(table, macaddr_key(join->data_macaddrs[i]), primary_key);
+    if (slot == NIL) return 0; /* table full */
+    binding_clear_ssid(table, slot);
+    table->slots[slot].state    = DCWSTA_JOINING;
+    table->slots[slot].ssid_len = 0;
+  }
+  return 1;
+}
+
+static int
+apply_ack(struct dcwsta_table * const table, const unsigned long long primary_key, const struct dcwmsg_sta_ack * const ack) {
+  struct binding_slot *b;
+  const char *ssid;
+  unsigned ssid_len;
+  unsigned slot;
+  unsigned i;
+
+  for (i = 0; i < ack->bonded_data_channel_count; i++) {
+    slot = binding_upsert(table, macaddr_key(ack->bonded_data_channels[i].macaddr), primary_key);
+    if (slot == NIL) return 0; /* table full */
+
+    ssid     = ack->bonded_data_channels[i].ssid;
+    ssid_len = (unsigned)strnlen(ssid, sizeof(dcwmsg_ssid_t));
+
+    binding_clear_ssid(table, slot);
+    b = &table->slots[slot];
+    b->state    = DCWSTA_BONDED;
+    b->ssid_len = (unsigned char)ssid_len;
+    b->ssid_key = ssid_key(ssid, ssid_len);
+    memcpy(b->ssid, ssid, ssid_len);
+    CHAIN_LINK(table, by_ssid, ssid_prev, ssid_next, b->ssid_key, slot);
+  }
+  return 1;
+}
+
+static void
+remove_macaddrs(struct dcwsta_table * const table, const unsigned count, const dcwmsg_macaddr_t * const macaddrs) {
+  unsigned i;
+  for (i = 0; i < count; i++) binding_remove(table, macaddr_key(macaddrs[i]));
+}
+
+static void
+remove_station(struct dcwsta_table * const table, const unsigned long long primary_key) {
+  unsigned slot;
+
+  while ((slot = u64map_get(&table->by_primary, primary_key)) != NIL) {
+    binding_remove(table, table->slots[slot].data_key);
+  }
+}
+
+int WIN32_EXPORT
+dcwsta_table_apply(struct dcwsta_table * const table, const unsigned char * const primary_macaddr, const struct dcwmsg * const msg) {
+  const unsigned long long primary_key = macaddr_key(primary_macaddr);
+
+  switch (msg->id) {
+  case DCWMSG_STA_JOIN:
+    if (msg->sta_join.data_macaddr_count > DCWMSG_MAX_ENTRIES) return 0;
+    return apply_join(table, primary_key, &msg->sta_join);
+
+  case DCWMSG_STA_ACK:
+    if (msg->sta_ack.bonded_data_channel_count > DCWMSG_MAX_ENTRIES) return 0;
+    return apply_ack(table, primary_key, &msg->sta_ack);
+
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    /* all three MAC list structs share the same layout */
+    if (msg->sta_unjoin.data_macaddr_count > DCWMSG_MAX_ENTRIES) return 0;
+    remove_macaddrs(table, msg->sta_unjoin.data_macaddr_count, msg->sta_unjoin.data_macaddrs);
+    return 1;
+
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    remove_station(table, primary_key);
+    return 1;
+
+  case DCWMSG_AP_ACCEPT_STA:
+    return 1; /* carries no per-station state */
+
+  default:
+    return 0;
+  }
+}
+
+
+
+/*
+
+  Lookups...
+
+*/
+static void
+slot_to_binding(const struct binding_slot * const b, struct dcwsta_binding * const output) {
+  key_macaddr(output->data_macaddr, b->data_key);
+  key_macaddr(output->primary_macaddr, b->primary_key);
+  output->state    = (enum dcwsta_state)b->state;
+  output->ssid_len = b->ssid_len;
+  memcpy(output->ssid, b->ssid, b->ssid_len);
+}
+
+int WIN32_EXPORT
+dcwsta_table_lookup(const struct dcwsta_table * const table, const unsigned char * const data_macaddr, struct dcwsta_binding * const output) {
+  unsigned slot;
+
+  slot = u64map_get(&table->by_data, macaddr_key(data_macaddr));
+  if (slot == NIL) return 0; /* not found */
+  if (output != NULL) slot_to_binding(&table->slots[slot], output);
+  return 1;
+}
+
+unsigned WIN32_EXPORT
+dcwsta_table_foreach_station(const struct dcwsta_table * const table, const unsigned char * const primary_macaddr, dcwsta_binding_cb cb, void * const ctx) {
+  struct dcwsta_binding binding;
+  unsigned matches;
+  unsigned slot;
+
+  matches = 0;
+  for (slot = u64map_get(&table->by_primary, macaddr_key(primary_macaddr)); slot != NIL; slot = table->slots[slot].sta_next) {
+    slot_to_binding(&table->slots[slot], &binding);
+    cb(&binding, ctx);
+    matches++;
+  }
+  return matches;
+}
+
+unsigned WIN32_EXPORT
+dcwsta_table_foreach_ssid(const struct dcwsta_table * const table, const char * const ssid, const unsigned ssid_len, dcwsta_binding_cb cb, void * const ctx) {
+  struct dcwsta_binding binding;
+  const struct binding_slot *b;
+  unsigned matches;
+  unsigned slot;
+
+  matches = 0;
+  for (slot = u64map_get(&table->by_ssid, ssid_key(ssid, ssid_len)); slot != NIL; slot = b->ssid_next) {
+    b = &table->slots[slot];
+    if ((b->ssid_len != ssid_len) || (memcmp(b->ssid, ssid, ssid_len) != 0)) continue; /* hash collision */
+    slot_to_binding(b, &binding);
+    cb(&binding, ctx);
+    matches++;
+  }
+  return matches;
+}
+
+unsigned WIN32_EXPORT
+dcwsta_table_foreach(const struct dcwsta_table * const table, dcwsta_binding_cb cb, void * const ctx) {
+  struct dcwsta_binding binding;
+  unsigned matches;
+  unsigned i;
+
+  /* walk the data MAC map; every binding is in it exactly once */
+  matches = 0;
+  for (i = 0; i <= table->by_data.mask; i++) {
+    if (table->by_data.vals[i] == NIL) continue;
+    slot_to_binding(&table->slots[table->by_data.vals[i]], &binding);
+    cb(&binding, ctx);
+    matches++;
+  }
+  return matches;
+}
+
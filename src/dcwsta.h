@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWSTA_H_INCLUDED
+#define DCWSTA_H_INCLUDED
+
+#include <dcwproto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Station association table...
+  Tracks which data channel MAC addresses are bonded to which primary station
+  (and over which SSID), driven directly by decoded DCW messages. Lookups by
+  data channel MAC are O(1); lookups by station or SSID walk only the matching
+  bindings. All storage is allocated up front for "max_bindings", so there are
+  no rehash pauses. A table has no locking.
+*/
+enum dcwsta_state {
+  DCWSTA_JOINING = 1, /* STA_JOIN seen, no STA_ACK yet */
+  DCWSTA_BONDED  = 2, /* STA_ACK seen */
+};
+
+struct dcwsta_binding {
+  dcwmsg_macaddr_t    data_macaddr;
+  dcwmsg_macaddr_t    primary_macaddr;
+  enum dcwsta_state   state;
+  unsigned            ssid_len;
+  dcwmsg_ssid_t       ssid;       /* not NUL terminated; use ssid_len */
+};
+
+struct dcwsta_table;
+
+typedef void (*dcwsta_binding_cb)(const struct dcwsta_binding * const /* binding */, void * const /* ctx */);
+
+struct dcwsta_table * WIN32_EXPORT dcwsta_table_create(const unsigned /* max_bindings */);
+void WIN32_EXPORT dcwsta_table_destroy(struct dcwsta_table * const /* table */);
+unsigned WIN32_EXPORT dcwsta_table_count(const struct dcwsta_table * const /* table */);
+
+/*
+  Applies one decoded message about station "primary_macaddr" (the peer the
+  message came from or is going to):
+    STA_JOIN                    -> each data MAC becomes DCWSTA_JOINING
+    STA_ACK                     -> each data MAC becomes DCWSTA_BONDED with its SSID
+    STA_UNJOIN / STA_NACK /
+    AP_REJECT_STA               -> each data MAC is removed
+    AP_ACK_DISCONNECT / AP_QUIT -> every binding of the station is removed
+  Returns 0 if the message is invalid or the table is full (bindings applied
+  before that point are kept).
+*/
+int WIN32_EXPORT dcwsta_table_apply(struct dcwsta_table * const /* table */, const unsigned char * const /* primary_macaddr */, const struct dcwmsg * const /* msg */);
+
+int WIN32_EXPORT dcwsta_table_lookup(const struct dcwsta_table * const /* table */, const unsigned char * const /* data_macaddr */, struct dcwsta_binding * const /* output */);
+unsigned WIN32_EXPORT dcwsta_table_foreach_station(const struct dcwsta_table * const /* table */, const unsigned char * const /* primary_macaddr */, dcwsta_binding_cb /* cb */, void * const /* ctx */);
+unsigned WIN32_EXPORT dcwsta_table_foreach_ssid(const struct dcwsta_table * const /* table */, const char * const /* ssid */, const unsigned /* ssid_len */, dcwsta_binding_cb /* cb */, void * const /* ctx */);
+/* every binding, in no particular order */
+unsigned WIN32_EXPORT dcwsta_table_foreach(const struct dcwsta_table * const /* table */, dcwsta_binding_cb /* cb */, void * const /* ctx */);
+
+
+#ifndef WIN32
+/*
+  Shared station table (one writer, many lock-free readers)...
+  Part of libdcwproto-mt.
+  Readers call dcwsta_shared_lookup() with their own reader_id
+  (0 .. max_readers - 1, one per thread) and never block. The single writer
+  calls dcwsta_shared_apply() for each update; updates become visible to
+  readers together on dcwsta_shared_publish(), which returns 0 if any update
+  in the batch failed to apply.
+*/
+struct dcwsta_shared;
+
+struct dcwsta_shared * dcwsta_shared_create(const unsigned /* max_bindings */, const unsigned /* max_readers */);
+void dcwsta_shared_destroy(struct dcwsta_shared * const /* shared */);
+int dcwsta_shared_lookup(struct dcwsta_shared * const /* shared */, const unsigned /* reader_id */, const unsigned char * const /* data_macaddr */, struct dcwsta_binding * const /* output */);
+int dcwsta_shared_apply(struct dcwsta_shared * const /* shared */, const unsigned char * const /* primary_macaddr */, const struct dcwmsg * const /* msg */);
+int dcwsta_shared_publish(struct dcwsta_shared * const /* shared */);
+#endif
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWSTA_H_INCLUDED */
@@ -0,0 +1,228 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef WIN32
+
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwsta.h>
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE_SIZE 64
+
+
+
+/*
+
+  Shared station table...
+  Implements the Left-Right technique over two dcwsta_table instances.
+  Readers always go to the instance the writer is not touching, announcing
+  themselves on a per-reader, cache-line sized indicator, so a lookup is two
+  uncontended atomic increments and never waits. The writer applies updates
+  to the idle instance (logging them as compact messages), and on publish
+  flips readers over, waits for the stragglers to drain and replays the log
+  onto the other instance.
+
+*/
+struct reader_indicator {
+  atomic_ulong  arrivals[2];   /* one per version index */
+  atomic_ulong  departures[2];
+  char          pad[CACHE_LINE_SIZE - (4 * sizeof(atomic_ulong))];
+};
+
+struct log_entry {
+  dcwmsg_macaddr_t  primary_macaddr;
+  unsigned short    size;       /* bytes of compact message that follow */
+};
+
+struct dcwsta_shared {
+  struct dcwsta_table      *tables[2];
+  atomic_uint               left_right;     /* instance readers should use */
+  atomic_uint               version_index;  /* indicator half arriving readers use */
+  struct reader_indicator  *readers;
+  unsigned                  max_readers;
+
+  /* writer side only */
+  unsigned char            *log;
+  unsigned                  log_len;
+  unsigned                  log_size;
+  int                       log_failed;
+};
+
+struct dcwsta_shared *
+dcwsta_shared_create(const unsigned max_bindings, const unsigned max_readers) {
+  struct dcwsta_shared *shared;
+  void *readers;
+  unsigned i;
+
+  shared = calloc(1, sizeof(*shared));
+  if (shared == NULL) return NULL;
+
+  shared->max_readers = max_readers;
+  shared->tables[0]   = dcwsta_table_create(max_bindings);
+  shared->tables[1]   = dcwsta_table_create(max_bindings);
+  /* posix_memalign() rather than C11 aligned_alloc(), which is hidden from C99 builds */
+  if (posix_memalign(&readers, CACHE_LINE_SIZE, sizeof(*shared->readers) * (max_readers ? max_readers : 1)) != 0) readers = NULL;
+  shared->readers     = readers;
+  if ((shared->tables[0] == NULL) || (shared->tables[1] == NULL) || (shared->readers == NULL)) {
+    dcwsta_shared_destroy(shared);
+    return NULL;
+  }
+
+  for (i = 0; i < max_readers; i++) {
+    atomic_init(&shared->readers[i].arrivals[0], 0);
+    atomic_init(&shared->readers[i].arrivals[1], 0);
+    atomic_init(&shared->readers[i].departures[0], 0);
+    atomic_init(&shared->readers[i].departures[1], 0);
+  }
+  atomic_init(&shared->left_right, 0);
+  atomic_init(&shared->version_index, 0);
+
+  return shared;
+}
+
+void
+dcwsta_shared_destroy(struct dcwsta_shared * const shared) {
+  if (shared == NULL) return;
+  dcwsta_table_destroy(shared->tables[0]);
+  dcwsta_table_destroy(shared->tables[1]);
+  free(shared->readers);
+  free(shared->log);
+  free(shared);
+}
+
+
+
+/*
+
+  Reader side...
+  Each reader thread passes its own reader_id (0 .. max_readers - 1).
+
+*/
+int
+dcwsta_shared_lookup(struct dcwsta_shared * const shared, const unsigned reader_id, const unsigned char * const data_macaddr, struct dcwsta_binding * const output) {
+  struct reader_indicator * const reader = &shared->readers[reader_id];
+  unsigned vi;
+  int rv;
+
+  /* arrive ; use the instance readers were pointed at ; depart */
+  vi = atomic_load(&shared->version_index);
+  atomic_fetch_add(&reader->arrivals[vi], 1);
+  rv = dcwsta_table_lookup(shared->tables[atomic_load(&shared->left_right)], data_macaddr, output);
+  atomic_fetch_add_explicit(&reader->departures[vi], 1, memory_order_release);
+
+  return rv;
+}
+
+
+
+/*
+
+  Writer side...
+  Only one thread may call these.
+
+*/
+int
+dcwsta_shared_apply(struct dcwsta_shared * const shared, const unsigned char * const primary_macaddr, const struct dcwmsg * const msg) {
+  struct log_entry entry;
+  unsigned char *grown;
+  unsigned needed;
+  unsigned size;
+  int rv;
+
+  /* log the update for the replay onto the other instance */
+  needed = shared->log_len + sizeof(entry) + DCWMSG_COMPACT_MAX_SIZE;
+  if (needed > shared->log_size) {
+    grown = realloc(shared->log, needed * 2);
+    if (grown == NULL) {
+      shared->log_failed = 1;
+      return 0;
+    }
+    shared->log      = grown;
+    shared->log_size = needed * 2;
+  }
+  size = dcwmsg_compact_pack((struct dcwmsg_compact *)&shared->log[shared->log_len + sizeof(entry)], DCWMSG_COMPACT_MAX_SIZE, msg);
+  if (size == 0) {
+    shared->log_failed = 1;
+    return 0; /* invalid message */
+  }
+  memcpy(entry.primary_macaddr, primary_macaddr, sizeof(entry.primary_macaddr));
+  entry.size = (unsigned short)size;
+  memcpy(&shared->log[shared->log_len], &entry, sizeof(entry));
+  shared->log_len += (sizeof(entry) + size + 3) & ~3u; /* keep compact headers aligned */
+
+  rv = dcwsta_table_apply(shared->tables[!atomic_load(&shared->left_right)], primary_macaddr, msg);
+  if (!rv) shared->log_failed = 1;
+  return rv;
+}
+
+static void
+wait_for_readers(struct dcwsta_shared * const shared, const unsigned vi) {
+  unsigned i;
+
+  for (i = 0; i < shared->max_readers; i++) {
+    while (atomic_load(&shared->readers[i].arrivals[vi]) != atomic_load_explicit(&shared->readers[i].departures[vi], memory_order_acquire)) {
+      sched_yield();
+    }
+  }
+}
+
+int
+dcwsta_shared_publish(struct dcwsta_shared * const shared) {
+  struct dcwmsg msg;
+  struct log_entry entry;
+  unsigned prev_vi;
+  unsigned offset;
+  unsigned lr;
+  int rv;
+
+  /* point new readers at the updated instance */
+  lr = !atomic_load(&shared->left_right);
+  atomic_store(&shared->left_right, lr);
+
+  /* make sure nobody is still reading the old one */
+  prev_vi = atomic_load(&shared->version_index);
+  wait_for_readers(shared, !prev_vi);
+  atomic_store(&shared->version_index, !prev_vi);
+  wait_for_readers(shared, prev_vi);
+
+  /* replay the batch onto the now idle instance */
+  for (offset = 0; offset < shared->log_len; offset += (sizeof(entry) + entry.size + 3) & ~3u) {
+    memcpy(&entry, &shared->log[offset], sizeof(entry));
+    dcwmsg_compact_unpack(&msg, (const struct dcwmsg_compact *)&shared->log[offset + sizeof(entry)]);
+    dcwsta_table_apply(shared->tables[!lr], entry.primary_macaddr, &msg);
+  }
+
+  rv = !shared->log_failed;
+  shared->log_len    = 0;
+  shared->log_failed = 0;
+  return rv;
+}
+
+
+#endif /* #ifndef WIN32 */
+
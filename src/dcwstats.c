@@ -0,0 +1,337 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwstats.h>
+#include "dcwstats_hooks.h"
+
+#include <string.h>
+
+#ifdef DCWPROTO_STATS
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#endif
+
+
+
+/*
+
+  Histogram bucket functions begin here...
+  (always built; they only do arithmetic)
+
+*/
+#define LATENCY_LINEAR_BUCKETS 8
+#define LATENCY_SUB_BITS       2 /* 4 buckets per power of two */
+
+unsigned long long WIN32_EXPORT
+dcwstats_latency_floor(const unsigned bucket) {
+  unsigned exponent;
+  unsigned sub;
+
+  if (bucket < LATENCY_LINEAR_BUCKETS) return bucket;
+  exponent = ((bucket - LATENCY_LINEAR_BUCKETS) >> LATENCY_SUB_BITS) + 3;
+  sub      = (bucket - LATENCY_LINEAR_BUCKETS) & ((1 << LATENCY_SUB_BITS) - 1);
+  return ((1ULL << LATENCY_SUB_BITS) + sub) << (exponent - LATENCY_SUB_BITS);
+}
+
+unsigned long long WIN32_EXPORT
+dcwstats_latency_percentile(const struct dcwstats_counters * const counters, const double percentile) {
+  unsigned long long total;
+  unsigned long long target;
+  unsigned long long seen;
+  unsigned i;
+
+  total = 0;
+  for (i = 0; i < DCWSTATS_LATENCY_BUCKETS; i++) total += counters->latency[i];
+  if (total == 0) return 0;
+
+  target = (unsigned long long)((percentile / 100.0) * (double)total);
+  if (target < 1) target = 1;
+  if (target > total) target = total;
+
+  seen = 0;
+  for (i = 0; i < DCWSTATS_LATENCY_BUCKETS; i++) {
+    seen += counters->latency[i];
+    if (seen >= target) return dcwstats_latency_floor(i);
+  }
+  return dcwstats_latency_floor(DCWSTATS_LATENCY_BUCKETS - 1);
+}
+
+
+
+#ifndef DCWPROTO_STATS
+/*
+
+  Compiled-out stubs...
+
+*/
+int WIN32_EXPORT
+dcwstats_enabled(void) {
+  return 0;
+}
+
+void WIN32_EXPORT
+dcwstats_snapshot(struct dcwstats_snapshot * const output) {
+  memset(output, 0, sizeof(*output));
+}
+
+void WIN32_EXPORT
+dcwstats_set_latency(const int enabled) {
+  (void)enabled;
+}
+
+#else /* #ifndef DCWPROTO_STATS */
+/*
+
+  Per-thread counter functions begin here...
+  Each thread gets a heap block on first use, linked into a registry so
+  snapshots can find it. Only the owning thread writes a block, using
+  relaxed atomic loads/stores rather than read-modify-write, so recording is
+  a few plain adds. A thread's block is folded into "retired" when it exits.
+
+*/
+struct thread_stats {
+  struct dcwstats_snapshot   counters;
+  struct thread_stats       *prev;
+  struct thread_stats       *next;
+};
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_stats *registry;
+static struct dcwstats_snapshot retired;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static int latency_enabled;
+/* initial-exec keeps the per-call TLS access to a single load, even in the shared library */
+static _Thread_local struct thread_stats *local_stats __attribute__((tls_model("initial-exec")));
+
+#define COUNTER_ADD(COUNTER, N) \
+  __atomic_store_n(&(COUNTER), __atomic_load_n(&(COUNTER), __ATOMIC_RELAXED) + (N), __ATOMIC_RELAXED)
+
+static void
+counters_add(struct dcwstats_counters * const output, const struct dcwstats_counters * const input) {
+  unsigned i;
+
+  for (i = 0; i < 256; i++) {
+    output->messages[i] += __atomic_load_n(&input->messages[i], __ATOMIC_RELAXED);
+    output->failures[i] += __atomic_load_n(&input->failures[i], __ATOMIC_RELAXED);
+  }
+  for (i = 0; i < DCWSTATS_REASON_COUNT; i++) {
+    output->reasons[i] += __atomic_load_n(&input->reasons[i], __ATOMIC_RELAXED);
+  }
+  output->bytes += __atomic_load_n(&input->bytes, __ATOMIC_RELAXED);
+  for (i = 0; i < DCWSTATS_LATENCY_BUCKETS; i++) {
+    output->latency[i] += __atomic_load_n(&input->latency[i], __ATOMIC_RELAXED);
+  }
+}
+
+static void
+thread_exit(void *arg) {
+  struct thread_stats * const stats = arg;
+
+  pthread_mutex_lock(&registry_lock);
+  counters_add(&retired.marshal, &stats->counters.marshal);
+  counters_add(&retired.serialize, &stats->counters.serialize);
+  if (stats->prev != NULL) stats->prev->next = stats->next;
+  else registry = stats->next;
+  if (stats->next != NULL) stats->next->prev = stats->prev;
+  pthread_mutex_unlock(&registry_lock);
+
+  /* a codec call from a later TSD destructor must start a new block, not write to this one */
+  local_stats = NULL;
+  free(stats);
+}
+
+static void
+key_init(void) {
+  pthread_key_create(&key, thread_exit);
+}
+
+/* returns NULL only if the allocation fails, in which case nothing is recorded */
+static struct thread_stats *
+thread_stats_get(void) {
+  struct thread_stats *stats;
+
+  if (local_stats != NULL) return local_stats;
+
+  pthread_once(&key_once, key_init);
+  stats = calloc(1, sizeof(*stats));
+  if (stats == NULL) return NULL;
+
+  pthread_mutex_lock(&registry_lock);
+  stats->next = registry;
+  if (registry != NULL) registry->prev = stats;
+  registry = stats;
+  pthread_mutex_unlock(&registry_lock);
+
+  pthread_setspecific(key, stats);
+  local_stats = stats;
+  return stats;
+}
+
+static unsigned
+latency_bucket(const unsigned long long ns) {
+  unsigned exponent;
+  unsigned bucket;
+
+  if (ns < LATENCY_LINEAR_BUCKETS) return (unsigned)ns;
+  exponent = 63 - (unsigned)__builtin_clzll(ns);
+  bucket   = LATENCY_LINEAR_BUCKETS + ((exponent - 3) << LATENCY_SUB_BITS) + (unsigned)((ns >> (exponent - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1));
+  return (bucket < DCWSTATS_LATENCY_BUCKETS) ? bucket : (DCWSTATS_LATENCY_BUCKETS - 1);
+}
+
+static unsigned long long
+now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long long)ts.tv_sec * 1000000000ULL) + (unsigned long long)ts.tv_nsec;
+}
+
+
+
+/*
+
+  Failure classification...
+  dcwmsg_marshal() and dcwmsg_marshal_ex() get the failure reason from their
+  one parse. Only dcwmsg_marshal_batch() re-parses a failed message with the
+  dcwmsg_marshal_ex() code, so its success path never pays for the reason.
+
+*/
+static enum dcwstats_reason
+reason_from_error(const enum dcwmsg_error error) {
+  switch (error) {
+  case DCWMSG_ERR_COUNT_TOO_BIG:  return DCWSTATS_COUNT_TOO_BIG;
+  case DCWMSG_ERR_SSID_TOO_LONG:  return DCWSTATS_SSID_TOO_LONG;
+  case DCWMSG_ERR_UNKNOWN_ID:     return DCWSTATS_UNKNOWN_ID;
+  default:                        return DCWSTATS_TRUNCATED;
+  }
+}
+
+static enum dcwstats_reason
+classify_serialize(const struct dcwmsg * const input) {
+  switch (input->id) {
+  case DCWMSG_STA_JOIN:
+  case DCWMSG_STA_UNJOIN:
+  case DCWMSG_STA_NACK:
+  case DCWMSG_AP_REJECT_STA:
+    if (input->sta_join.data_macaddr_count > DCWMSG_MAX_ENTRIES) return DCWSTATS_COUNT_TOO_BIG;
+    return DCWSTATS_BUFFER_TOO_SMALL;
+  case DCWMSG_STA_ACK:
+    if (input->sta_ack.bonded_data_channel_count > DCWMSG_MAX_ENTRIES) return DCWSTATS_COUNT_TOO_BIG;
+    return DCWSTATS_BUFFER_TOO_SMALL;
+  case DCWMSG_AP_ACCEPT_STA:
+    if (input->ap_accept_sta.data_ssid_count > DCWMSG_MAX_ENTRIES) return DCWSTATS_COUNT_TOO_BIG;
+    return DCWSTATS_BUFFER_TOO_SMALL;
+  case DCWMSG_AP_ACK_DISCONNECT:
+  case DCWMSG_AP_QUIT:
+    return DCWSTATS_BUFFER_TOO_SMALL;
+  default:
+    return DCWSTATS_UNKNOWN_ID;
+  }
+}
+
+
+
+/*
+
+  Recording hooks (called from dcwproto.c)...
+
+*/
+unsigned long long
+dcwstats_hook_start(void) {
+  if (!__atomic_load_n(&latency_enabled, __ATOMIC_RELAXED)) return 0;
+  return now_ns();
+}
+
+static void
+record(struct dcwstats_counters * const counters, const unsigned id, const int ok, const unsigned bytes, const unsigned long long start) {
+  if (ok) {
+    COUNTER_ADD(counters->messages[id], 1);
+    COUNTER_ADD(counters->bytes, bytes);
+  }
+  if (start != 0) COUNTER_ADD(counters->latency[latency_bucket(now_ns() - start)], 1);
+}
+
+void
+dcwstats_hook_marshal_error(const unsigned char * const buf, const unsigned buf_len, const enum dcwmsg_error error, const unsigned long long start) {
+  struct thread_stats * const stats = thread_stats_get();
+  const unsigned id = (buf_len > 0) ? buf[0] : 0;
+
+  if (stats == NULL) return;
+  record(&stats->counters.marshal, id, (error == DCWMSG_OK), buf_len, start);
+  if (error != DCWMSG_OK) {
+    COUNTER_ADD(stats->counters.marshal.failures[id], 1);
+    COUNTER_ADD(stats->counters.marshal.reasons[reason_from_error(error)], 1);
+  }
+}
+
+void
+dcwstats_hook_serialize(const struct dcwmsg * const input, const unsigned buf_len, const unsigned result, const unsigned long long start) {
+  struct thread_stats * const stats = thread_stats_get();
+  const unsigned id = (unsigned char)(unsigned)input->id;
+
+  if (stats == NULL) return;
+  record(&stats->counters.serialize, id, (result != 0), result, start);
+  if (result == 0) {
+    COUNTER_ADD(stats->counters.serialize.failures[id], 1);
+    COUNTER_ADD(stats->counters.serialize.reasons[(buf_len < 1) ? DCWSTATS_BUFFER_TOO_SMALL : classify_serialize(input)], 1);
+  }
+}
+
+
+
+/*
+
+  Public stats functions begin here...
+
+*/
+int WIN32_EXPORT
+dcwstats_enabled(void) {
+  return 1;
+}
+
+void WIN32_EXPORT
+dcwstats_snapshot(struct dcwstats_snapshot * const output) {
+  const struct thread_stats *stats;
+
+  memset(output, 0, sizeof(*output));
+  pthread_mutex_lock(&registry_lock);
+  counters_add(&output->marshal, &retired.marshal);
+  counters_add(&output->serialize, &retired.serialize);
+  for (stats = registry; stats != NULL; stats = stats->next) {
+    counters_add(&output->marshal, &stats->counters.marshal);
+    counters_add(&output->serialize, &stats->counters.serialize);
+  }
+  pthread_mutex_unlock(&registry_lock);
+}
+
+void WIN32_EXPORT
+dcwstats_set_latency(const int enabled) {
+  __atomic_store_n(&latency_enabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+#endif /* #ifndef DCWPROTO_STATS */
+
@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWSTATS_H_INCLUDED
+#define DCWSTATS_H_INCLUDED
+
+#include <dcwproto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Marshal/serialize instrumentation...
+  Only recorded when the library is configured with --enable-stats;
+  otherwise dcwstats_enabled() returns 0, snapshots are all zero and
+  dcwmsg_marshal() / dcwmsg_serialize() carry no instrumentation at all.
+
+  Each thread counts into its own block (no atomic read-modify-write on the
+  hot path); dcwstats_snapshot() sums every live thread plus the totals left
+  behind by threads that have exited. Counters only ever go up, so interval
+  rates come from diffing two snapshots.
+*/
+enum dcwstats_reason {
+  DCWSTATS_TRUNCATED        = 0, /* input ended inside the message */
+  DCWSTATS_COUNT_TOO_BIG    = 1, /* entry count over DCWMSG_MAX_ENTRIES */
+  DCWSTATS_SSID_TOO_LONG    = 2, /* SSID length byte over 32 */
+  DCWSTATS_UNKNOWN_ID       = 3,
+  DCWSTATS_BUFFER_TOO_SMALL = 4, /* serialize output buffer */
+};
+#define DCWSTATS_REASON_COUNT 5
+
+/*
+  Latency histogram buckets are log-linear (HDR style): values below 8ns get
+  a bucket each, then every power of two is split into 4 buckets, so a
+  bucket is within 25% of the values it holds. The last bucket also takes
+  everything above ~8.6 seconds.
+*/
+#define DCWSTATS_LATENCY_BUCKETS 128
+
+struct dcwstats_counters {
+  unsigned long long  messages[256];  /* successful calls, by message id */
+  unsigned long long  failures[256];  /* failed calls, by message id byte */
+  unsigned long long  reasons[DCWSTATS_REASON_COUNT];
+  unsigned long long  bytes;          /* marshal: input bytes, serialize: bytes written */
+  unsigned long long  latency[DCWSTATS_LATENCY_BUCKETS]; /* nanoseconds, when enabled */
+};
+
+struct dcwstats_snapshot {
+  struct dcwstats_counters  marshal;
+  struct dcwstats_counters  serialize;
+};
+
+int WIN32_EXPORT dcwstats_enabled(void);
+void WIN32_EXPORT dcwstats_snapshot(struct dcwstats_snapshot * const /* output */);
+
+/* latency timing costs two clock reads per call, so it has its own switch (default off) */
+void WIN32_EXPORT dcwstats_set_latency(const int /* enabled */);
+
+unsigned long long WIN32_EXPORT dcwstats_latency_floor(const unsigned /* bucket */);
+/* lower bound (ns) of the bucket holding the given percentile (0..100); 0 if empty */
+unsigned long long WIN32_EXPORT dcwstats_latency_percentile(const struct dcwstats_counters * const /* counters */, const double /* percentile */);
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWSTATS_H_INCLUDED */
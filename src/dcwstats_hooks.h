@@ -0,0 +1,38 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWSTATS_HOOKS_H_INCLUDED
+#define DCWSTATS_HOOKS_H_INCLUDED
+
+/*
+  Library-internal recording hooks for dcwstats (not installed). Only
+  referenced when DCWPROTO_STATS is defined.
+*/
+#ifdef DCWPROTO_STATS
+#include <dcwproto.h>
+
+/* returns 0 when latency timing is off */
+unsigned long long dcwstats_hook_start(void);
+void dcwstats_hook_marshal_error(const unsigned char * const /* buf */, const unsigned /* buf_len */, const enum dcwmsg_error /* error */, const unsigned long long /* start */);
+void dcwstats_hook_serialize(const struct dcwmsg * const /* input */, const unsigned /* buf_len */, const unsigned /* result */, const unsigned long long /* start */);
+#endif
+
+
+#endif /* #ifndef DCWSTATS_HOOKS_H_INCLUDED */
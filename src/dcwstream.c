@@ -0,0 +1,107 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+
+
+#include <config.h>
+#include <dcwstream.h>
+
+#include <string.h>
+
+
+
+static unsigned
+read_frame_len(const unsigned char * const header) {
+  return ((unsigned)header[0] << 8) | (unsigned)header[1];
+}
+
+void WIN32_EXPORT
+dcwstream_decoder_init(struct dcwstream_decoder * const decoder) {
+  decoder->have      = 0;
+  decoder->frame_len = 0;
+}
+
+int WIN32_EXPORT
+dcwstream_decode(struct dcwstream_decoder * const decoder, struct dcwmsg * const output, const unsigned char ** const buf, unsigned * const buf_len) {
+  unsigned frame_len;
+  unsigned want;
+
+  /* fast path: nothing buffered and a whole frame sits in the input */
+  if ((decoder->have == 0) && ((*buf_len) >= DCWSTREAM_HEADER_SIZE)) {
+    frame_len = read_frame_len(*buf);
+    if ((frame_len < 1) || (frame_len > DCWMSG_MAX_SERIALIZED_SIZE)) return DCWSTREAM_ERROR;
+    if ((*buf_len) >= (DCWSTREAM_HEADER_SIZE + frame_len)) {
+      if (!dcwmsg_marshal(output, (*buf) + DCWSTREAM_HEADER_SIZE, frame_len)) return DCWSTREAM_ERROR;
+      (*buf)     += DCWSTREAM_HEADER_SIZE + frame_len;
+      (*buf_len) -= DCWSTREAM_HEADER_SIZE + frame_len;
+      return DCWSTREAM_MESSAGE;
+    }
+  }
+
+  /* slow path: accumulate the partial frame */
+  while ((*buf_len) > 0) {
+    if (decoder->frame_len == 0) {
+      want = DCWSTREAM_HEADER_SIZE - decoder->have;
+    }
+    else {
+      want = (DCWSTREAM_HEADER_SIZE + decoder->frame_len) - decoder->have;
+    }
+    if (want > (*buf_len)) want = (*buf_len);
+
+    memcpy(&decoder->frame[decoder->have], *buf, want);
+    decoder->have += want;
+    (*buf)        += want;
+    (*buf_len)    -= want;
+
+    if (decoder->frame_len == 0) {
+      if (decoder->have < DCWSTREAM_HEADER_SIZE) continue;
+      decoder->frame_len = read_frame_len(decoder->frame);
+      if ((decoder->frame_len < 1) || (decoder->frame_len > DCWMSG_MAX_SERIALIZED_SIZE)) {
+        dcwstream_decoder_init(decoder);
+        return DCWSTREAM_ERROR;
+      }
+      continue;
+    }
+
+    if (decoder->have < (DCWSTREAM_HEADER_SIZE + decoder->frame_len)) continue;
+
+    /* frame complete... */
+    frame_len = decoder->frame_len;
+    dcwstream_decoder_init(decoder);
+    if (!dcwmsg_marshal(output, &decoder->frame[DCWSTREAM_HEADER_SIZE], frame_len)) return DCWSTREAM_ERROR;
+    return DCWSTREAM_MESSAGE;
+  }
+
+  return DCWSTREAM_NEED_MORE;
+}
+
+unsigned WIN32_EXPORT
+dcwstream_frame(unsigned char * const buf, const struct dcwmsg * const input, const unsigned buf_len) {
+  unsigned size;
+
+  if (buf_len < DCWSTREAM_HEADER_SIZE) return 0;
+  size = dcwmsg_serialize_exact(buf + DCWSTREAM_HEADER_SIZE, input, buf_len - DCWSTREAM_HEADER_SIZE);
+  if (size == 0) return 0;
+
+  buf[0] = (unsigned char)(size >> 8);
+  buf[1] = (unsigned char)(size & 0xFF);
+  return DCWSTREAM_HEADER_SIZE + size;
+}
+
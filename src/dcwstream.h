@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+#ifndef DCWSTREAM_H_INCLUDED
+#define DCWSTREAM_H_INCLUDED
+
+#include <dcwproto.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Stream framing for DCW over TCP / unix stream sockets...
+  Each frame is a 2-byte big-endian length followed by one serialized DCW
+  message of exactly that length.
+*/
+#define DCWSTREAM_HEADER_SIZE  2
+#define DCWSTREAM_MAX_FRAME    (DCWSTREAM_HEADER_SIZE + DCWMSG_MAX_SERIALIZED_SIZE)
+
+enum dcwstream_status {
+  DCWSTREAM_ERROR     = -1, /* malformed frame; the stream is out of sync and should be dropped */
+  DCWSTREAM_NEED_MORE =  0, /* all input consumed, no complete frame yet */
+  DCWSTREAM_MESSAGE   =  1, /* one message decoded; input may have bytes left */
+};
+
+struct dcwstream_decoder {
+  unsigned       have;       /* bytes buffered in frame[] */
+  unsigned       frame_len;  /* payload length once the header is in, else 0 */
+  unsigned char  frame[DCWSTREAM_MAX_FRAME];
+};
+
+void WIN32_EXPORT dcwstream_decoder_init(struct dcwstream_decoder * const /* decoder */);
+
+/*
+  Feeds input to the decoder. *buf / *buf_len are advanced past whatever was
+  consumed; call again with the same pointers after each DCWSTREAM_MESSAGE
+  until DCWSTREAM_NEED_MORE. Frames that arrive whole within one chunk are
+  marshaled straight from the caller's buffer; only partial frames are
+  copied into the decoder.
+*/
+int WIN32_EXPORT dcwstream_decode(struct dcwstream_decoder * const /* decoder */, struct dcwmsg * const /* output */, const unsigned char ** const /* buf */, unsigned * const /* buf_len */);
+
+/* writes one frame (header + message); returns bytes written or 0 on failure */
+unsigned WIN32_EXPORT dcwstream_frame(unsigned char * const /* buf */, const struct dcwmsg * const /* input */, const unsigned /* buf_len */);
+
+
+#ifdef __cplusplus
+}; //extern "C" {
+#endif
+
+
+#endif /* #ifndef DCWSTREAM_H_INCLUDED */
@@ -0,0 +1,556 @@
+/*
+* Copyright (c) 2018 Cable Television Laboratories, Inc. ("CableLabs")
+*                    and others.  All rights reserved.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* Created by Jon Dennis (j.dennis@cablelabs.com)
+*/
+
+
+/*
+  dcwreplay -- replays captured DCW traffic through the codec offline.
+
+  Every DCW payload in the input files is run through dcwmsg_marshal(), then
+  dcwmsg_serialize(), and the re-serialized bytes are compared with the
+  original. Marshal and serialize throughput are reported separately.
+
+  Inputs are either classic pcap files (Ethernet, Linux cooked v1/v2, raw IP
+  or BSD loopback; UDP over IPv4/IPv6, unfragmented) or the length-prefixed
+  capture format: a sequence of records, each an 8-byte big-endian timestamp
+  in nanoseconds, a 2-byte big-endian payload length and the payload. The
+  format is detected from the pcap magic number.
+
+  Usage: dcwreplay [-p <udp port>] [-n <passes>] [-r <rate scale>] [-v] <file>...
+    -p  pcap only: keep UDP datagrams to or from this port (default: all)
+    -n  number of passes over the messages at full speed (default 1)
+    -r  instead of full speed, replay once at the captured pace times this
+        factor (e.g. 2 for twice as fast)
+    -v  print each round-trip mismatch
+*/
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <config.h>
+#include <dcwproto.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PCAP_MAGIC_US       0xA1B2C3D4u
+#define PCAP_MAGIC_NS       0xA1B23C4Du
+#define PCAP_GLOBAL_HEADER  24
+#define PCAP_RECORD_HEADER  16
+
+#define LINKTYPE_NULL         0
+#define LINKTYPE_ETHERNET     1
+#define LINKTYPE_RAW_OLD      12
+#define LINKTYPE_RAW_OLD2     14
+#define LINKTYPE_RAW          101
+#define LINKTYPE_LINUX_SLL    113
+#define LINKTYPE_IPV4         228
+#define LINKTYPE_IPV6         229
+#define LINKTYPE_LINUX_SLL2   276
+
+#define ETHERTYPE_IPV4  0x0800
+#define ETHERTYPE_IPV6  0x86DD
+#define ETHERTYPE_VLAN  0x8100
+#define ETHERTYPE_QINQ  0x88A8
+
+#define LP_RECORD_HEADER  10
+
+struct replay_record {
+  unsigned long long    ts_ns;
+  const unsigned char  *data;
+  unsigned              len;
+};
+
+struct replay_set {
+  struct replay_record  *records;
+  unsigned               count;
+  unsigned               capacity;
+  unsigned long          frames;    /* pcap records / lp records read */
+  unsigned long          skipped;   /* frames that held no usable UDP payload */
+  int                    udp_port;  /* -1 for any */
+};
+
+struct replay_totals {
+  unsigned long          marshal_failed;
+  unsigned long          reasons[DCWMSG_ERR_UNKNOWN_ID + 1];
+  unsigned long          serialize_failed;
+  unsigned long          mismatched;
+  unsigned long long     bytes;
+};
+
+static int verbose;
+
+
+
+/*
+
+  Input parsing functions begin here...
+
+*/
+static unsigned
+get_be16(const unsigned char * const p) {
+  return ((unsigned)p[0] << 8) | (unsigned)p[1];
+}
+
+static unsigned
+get_be32(const unsigned char * const p) {
+  return ((unsigned)p[0] << 24) | ((unsigned)p[1] << 16) | ((unsigned)p[2] << 8) | (unsigned)p[3];
+}
+
+static unsigned
+get_le32(const unsigned char * const p) {
+  return ((unsigned)p[3] << 24) | ((unsigned)p[2] << 16) | ((unsigned)p[1] << 8) | (unsigned)p[0];
+}
+
+static int
+set_append(struct replay_set * const set, const unsigned long long ts_ns, const unsigned char * const data, const unsigned len) {
+  struct replay_record *records;
+  unsigned capacity;
+
+  if (set->count == set->capacity) {
+    capacity = set->capacity ? (set->capacity * 2) : 4096;
+    records  = realloc(set->records, capacity * sizeof(*records));
+    if (records == NULL) return 0;
+    set->records  = records;
+    set->capacity = capacity;
+  }
+  set->records[set->count].ts_ns = ts_ns;
+  set->records[set->count].data  = data;
+  set->records[set->count].len   = len;
+  set->count++;
+  return 1;
+}
+
+/* finds the UDP payload in an IPv4/IPv6 packet; returns 0 if there is none */
+static int
+ip_udp_payload(const unsigned char * const pkt, const unsigned pkt_len, const int udp_port, const unsigned char ** const payload, unsigned * const payload_len) {
+  const unsigned char *udp;
+  unsigned ip_len;
+  unsigned header_len;
+  unsigned udp_len;
+
+  if (pkt_len < 1) return 0;
+  switch (pkt[0] >> 4) {
+  case 4:
+    if (pkt_len < 20) return 0;
+    header_len = (pkt[0] & 0x0F) * 4;
+    ip_len     = get_be16(&pkt[2]);
+    if ((header_len < 20) || (ip_len < header_len) || (ip_len > pkt_len)) return 0;
+    if (pkt[9] != 17) return 0; /* not UDP */
+    if (get_be16(&pkt[6]) & 0x3FFF) return 0; /* a fragment */
+    break;
+  case 6:
+    if (pkt_len < 40) return 0;
+    header_len = 40;
+    ip_len     = 40 + get_be16(&pkt[4]);
+    if (ip_len > pkt_len) return 0;
+    if (pkt[6] != 17) return 0; /* not UDP (extension headers are not followed) */
+    break;
+  default:
+    return 0;
+  }
+
+  udp = &pkt[header_len];
+  if ((ip_len - header_len) < 8) return 0;
+  udp_len = get_be16(&udp[4]);
+  if ((udp_len < 8) || (udp_len > (ip_len - header_len))) return 0;
+  if ((udp_port >= 0) && (get_be16(&udp[0]) != (unsigned)udp_port) && (get_be16(&udp[2]) != (unsigned)udp_port)) return 0;
+
+  (*payload)     = &udp[8];
+  (*payload_len) = udp_len - 8;
+  return 1;
+}
+
+/* strips the link layer; returns 0 if the frame does not carry IP */
+static int
+link_ip_packet(const unsigned linktype, const unsigned char * const frame, const unsigned frame_len, const unsigned char ** const pkt, unsigned * const pkt_len) {
+  unsigned offset;
+  unsigned ethertype;
+
+  switch (linktype) {
+  case LINKTYPE_ETHERNET:
+    if (frame_len < 14) return 0;
+    ethertype = get_be16(&frame[12]);
+    offset    = 14;
+    while ((ethertype == ETHERTYPE_VLAN) || (ethertype == ETHERTYPE_QINQ)) {
+      if (frame_len < (offset + 4)) return 0;
+      ethertype = get_be16(&frame[offset + 2]);
+      offset   += 4;
+    }
+    if ((ethertype != ETHERTYPE_IPV4) && (ethertype != ETHERTYPE_IPV6)) return 0;
+    break;
+  case LINKTYPE_LINUX_SLL:
+    if (frame_len < 16) return 0;
+    ethertype = get_be16(&frame[14]);
+    if ((ethertype != ETHERTYPE_IPV4) && (ethertype != ETHERTYPE_IPV6)) return 0;
+    offset = 16;
+    break;
+  case LINKTYPE_LINUX_SLL2:
+    if (frame_len < 20) return 0;
+    ethertype = get_be16(&frame[0]);
+    if ((ethertype != ETHERTYPE_IPV4) && (ethertype != ETHERTYPE_IPV6)) return 0;
+    offset = 20;
+    break;
+  case LINKTYPE_NULL:
+    offset = 4; /* host byte order address family; the IP version nibble is enough */
+    break;
+  case LINKTYPE_RAW:
+  case LINKTYPE_RAW_OLD:
+  case LINKTYPE_RAW_OLD2:
+  case LINKTYPE_IPV4:
+  case LINKTYPE_IPV6:
+    offset = 0;
+    break;
+  default:
+    return 0;
+  }
+
+  if (frame_len < offset) return 0;
+  (*pkt)     = &frame[offset];
+  (*pkt_len) = frame_len - offset;
+  return 1;
+}
+
+static int
+parse_pcap(struct replay_set * const set, const unsigned char * const data, const size_t data_len, const char * const path) {
+  unsigned (*get32)(const unsigned char *);
+  const unsigned char *payload;
+  const unsigned char *pkt;
+  unsigned long long ts_ns;
+  unsigned payload_len;
+  unsigned pkt_len;
+  unsigned incl_len;
+  unsigned linktype;
+  unsigned frac_ns;
+  unsigned magic;
+  size_t offset;
+
+  magic = get_le32(data);
+  get32 = get_le32;
+  if ((magic != PCAP_MAGIC_US) && (magic != PCAP_MAGIC_NS)) {
+    get32 = get_be32;
+    magic = get_be32(data);
+  }
+  frac_ns  = (magic == PCAP_MAGIC_NS) ? 1 : 1000;
+  linktype = get32(&data[20]) & 0xFFFF;
+
+  for (offset = PCAP_GLOBAL_HEADER; (data_len - offset) >= PCAP_RECORD_HEADER; offset += incl_len) {
+    ts_ns    = ((unsigned long long)get32(&data[offset]) * 1000000000ULL) + ((unsigned long long)get32(&data[offset + 4]) * frac_ns);
+    incl_len = get32(&data[offset + 8]);
+    offset  += PCAP_RECORD_HEADER;
+    if (incl_len > (data_len - offset)) {
+      fprintf(stderr, "%s: truncated pcap record at offset %lu\n", path, (unsigned long)offset);
+      break;
+    }
+    set->frames++;
+
+    if (!link_ip_packet(linktype, &data[offset], incl_len, &pkt, &pkt_len) ||
+        !ip_udp_payload(pkt, pkt_len, set->udp_port, &payload, &payload_len)) {
+      set->skipped++;
+      continue;
+    }
+    if (!set_append(set, ts_ns, payload, payload_len)) return 0;
+  }
+  return 1;
+}
+
+static int
+parse_lp(struct replay_set * const set, const unsigned char * const data, const size_t data_len, const char * const path) {
+  unsigned long long ts_ns;
+  unsigned len;
+  size_t offset;
+
+  for (offset = 0; (data_len - offset) >= LP_RECORD_HEADER; offset += len) {
+    ts_ns   = ((unsigned long long)get_be32(&data[offset]) << 32) | get_be32(&data[offset + 4]);
+    len     = get_be16(&data[offset + 8]);
+    offset += LP_RECORD_HEADER;
+    if (len > (data_len - offset)) {
+      fprintf(stderr, "%s: truncated record at offset %lu\n", path, (unsigned long)offset);
+      break;
+    }
+    set->frames++;
+    if (!set_append(set, ts_ns, &data[offset], len)) return 0;
+  }
+  return 1;
+}
+
+/* the file contents stay allocated for the life of the process; records point into them */
+static int
+load_file(struct replay_set * const set, const char * const path) {
+  unsigned char *data;
+  size_t data_len;
+  size_t capacity;
+  size_t rv;
+  FILE *fp;
+
+  fp = fopen(path, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return 0;
+  }
+
+  data     = NULL;
+  data_len = 0;
+  capacity = 0;
+  for (;;) {
+    if (data_len == capacity) {
+      capacity = capacity ? (capacity * 2) : (1 << 20);
+      data     = realloc(data, capacity);
+      if (data == NULL) {
+        fprintf(stderr, "%s: out of memory\n", path);
+        fclose(fp);
+        return 0;
+      }
+    }
+    rv = fread(&data[data_len], 1, capacity - data_len, fp);
+    if (rv == 0) break;
+    data_len += rv;
+  }
+  if (ferror(fp)) {
+    fprintf(stderr, "%s: read error\n", path);
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+
+  if ((data_len >= PCAP_GLOBAL_HEADER) &&
+      ((get_le32(data) == PCAP_MAGIC_US) || (get_le32(data) == PCAP_MAGIC_NS) ||
+       (get_be32(data) == PCAP_MAGIC_US) || (get_be32(data) == PCAP_MAGIC_NS))) {
+    return parse_pcap(set, data, data_len, path);
+  }
+  return parse_lp(set, data, data_len, path);
+}
+
+
+
+/*
+
+  Replay functions begin here...
+
+*/
+static double
+now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec;
+}
+
+static void
+print_mismatch(const struct replay_record * const record, const unsigned index, const unsigned char * const output, const unsigned output_len, const unsigned input_len) {
+  unsigned i;
+
+  printf("mismatch: message %u (id 0x%02X): %u bytes in, %u bytes out\n  in: ", index, record->data[0], input_len, output_len);
+  for (i = 0; i < input_len; i++) printf("%02X", record->data[i]);
+  printf("\n out: ");
+  for (i = 0; i < output_len; i++) printf("%02X", output[i]);
+  printf("\n");
+}
+
+/* checks every message once: marshal, serialize and compare */
+static void
+check_round_trip(const struct replay_set * const set, struct replay_totals * const totals) {
+  unsigned char output[DCWMSG_MAX_SERIALIZED_SIZE];
+  const struct replay_record *record;
+  struct dcwmsg msg;
+  enum dcwmsg_error error;
+  unsigned output_len;
+  unsigned consumed;
+  unsigned i;
+
+  for (i = 0; i < set->count; i++) {
+    record = &set->records[i];
+    totals->bytes += record->len;
+
+    if (!dcwmsg_marshal(&msg, record->data, record->len)) {
+      error = dcwmsg_marshal_ex(&msg, record->data, record->len, &consumed);
+      totals->marshal_failed++;
+      totals->reasons[(error == DCWMSG_OK) ? DCWMSG_ERR_TRUNCATED : error]++;
+      continue;
+    }
+
+    output_len = dcwmsg_serialize(output, &msg, sizeof(output));
+    if (output_len == 0) {
+      totals->serialize_failed++;
+      continue;
+    }
+
+    /* compare against the bytes the message actually occupies, not any trailing padding */
+    if (dcwmsg_marshal_ex(&msg, record->data, record->len, &consumed) != DCWMSG_OK) consumed = record->len;
+    if ((output_len != consumed) || (memcmp(output, record->data, consumed) != 0)) {
+      totals->mismatched++;
+      if (verbose) print_mismatch(record, i, output, output_len, consumed);
+    }
+  }
+}
+
+/* full speed; returns elapsed ns for "passes" runs of the given op over every message */
+static double
+time_marshal(const struct replay_set * const set, struct dcwmsg * const msgs, const unsigned long passes) {
+  unsigned long pass;
+  unsigned i;
+  double start;
+
+  start = now_ns();
+  for (pass = 0; pass < passes; pass++) {
+    for (i = 0; i < set->count; i++) dcwmsg_marshal(&msgs[i], set->records[i].data, set->records[i].len);
+  }
+  return now_ns() - start;
+}
+
+static double
+time_serialize(const struct replay_set * const set, const struct dcwmsg * const msgs, const int * const valid, const unsigned long passes, unsigned long long * const bytes) {
+  unsigned char output[DCWMSG_MAX_SERIALIZED_SIZE];
+  unsigned long pass;
+  unsigned i;
+  double start;
+
+  (*bytes) = 0;
+  start = now_ns();
+  for (pass = 0; pass < passes; pass++) {
+    for (i = 0; i < set->count; i++) {
+      if (valid[i]) (*bytes) += dcwmsg_serialize(output, &msgs[i], sizeof(output));
+    }
+  }
+  return now_ns() - start;
+}
+
+/* one paced pass at the captured inter-arrival times divided by "scale" */
+static double
+run_paced(const struct replay_set * const set, const double scale) {
+  unsigned char output[DCWMSG_MAX_SERIALIZED_SIZE];
+  struct dcwmsg msg;
+  struct timespec ts;
+  double start;
+  double offset;
+  double due;
+  double now;
+  unsigned i;
+
+  start = now_ns();
+  for (i = 0; i < set->count; i++) {
+    /* records from several captures need not be in timestamp order; anything
+       stamped before the first record is sent straight away */
+    offset = (double)(long long)(set->records[i].ts_ns - set->records[0].ts_ns);
+    if (offset < 0.0) offset = 0.0;
+    due = start + (offset / scale);
+    now = now_ns();
+    if (due > (now + 50000.0)) {
+      ts.tv_sec  = (time_t)((due - now) / 1e9);
+      ts.tv_nsec = (long)((due - now) - ((double)ts.tv_sec * 1e9));
+      nanosleep(&ts, NULL);
+    }
+    while (now_ns() < due) ; /* spin the last stretch */
+
+    if (dcwmsg_marshal(&msg, set->records[i].data, set->records[i].len)) {
+      dcwmsg_serialize(output, &msg, sizeof(output));
+    }
+  }
+  return now_ns() - start;
+}
+
+static void
+usage(const char * const argv0) {
+  fprintf(stderr, "Usage: %s [-p <udp port>] [-n <passes>] [-r <rate scale>] [-v] <file>...\n", argv0);
+}
+
+int
+main(int argc, char *argv[]) {
+  struct replay_totals totals;
+  struct replay_set set;
+  unsigned long long serialize_bytes;
+  unsigned long passes;
+  unsigned long valid_count;
+  struct dcwmsg *msgs;
+  int *valid;
+  double scale;
+  double elapsed;
+  unsigned i;
+  int opt;
+
+  memset(&set, 0, sizeof(set));
+  memset(&totals, 0, sizeof(totals));
+  set.udp_port = -1;
+  passes       = 1;
+  scale        = 0.0;
+  while ((opt = getopt(argc, argv, "p:n:r:v")) != -1) {
+    switch (opt) {
+    case 'p': set.udp_port = atoi(optarg); break;
+    case 'n': passes = strtoul(optarg, NULL, 10); break;
+    case 'r': scale = atof(optarg); break;
+    case 'v': verbose = 1; break;
+    default:  usage(argv[0]); return 2;
+    }
+  }
+  if ((optind >= argc) || (passes == 0) || (scale < 0.0)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  for (; optind < argc; optind++) {
+    if (!load_file(&set, argv[optind])) return 2;
+  }
+  printf("frames: %lu, DCW payloads: %u, skipped: %lu\n", set.frames, set.count, set.skipped);
+  if (set.count == 0) return 0;
+
+  check_round_trip(&set, &totals);
+  printf("marshal failures: %lu (truncated %lu, count too big %lu, ssid too long %lu, unknown id %lu)\n",
+    totals.marshal_failed,
+    totals.reasons[DCWMSG_ERR_TRUNCATED],
+    totals.reasons[DCWMSG_ERR_COUNT_TOO_BIG],
+    totals.reasons[DCWMSG_ERR_SSID_TOO_LONG],
+    totals.reasons[DCWMSG_ERR_UNKNOWN_ID]);
+  printf("serialize failures: %lu\n", totals.serialize_failed);
+  printf("round-trip mismatches: %lu\n", totals.mismatched);
+
+  if (scale > 0.0) {
+    elapsed = run_paced(&set, scale);
+    printf("paced x%g: %u messages in %.3f s (%.0f msgs/sec)\n", scale, set.count, elapsed / 1e9, (double)set.count * 1e9 / elapsed);
+  }
+  else {
+    msgs  = malloc(sizeof(*msgs) * set.count);
+    valid = malloc(sizeof(*valid) * set.count);
+    if ((msgs == NULL) || (valid == NULL)) {
+      fprintf(stderr, "out of memory\n");
+      return 2;
+    }
+
+    elapsed = time_marshal(&set, msgs, passes);
+    printf("marshal:   %.0f msgs/sec, %.1f MB/sec\n",
+      (double)set.count * (double)passes * 1e9 / elapsed,
+      (double)totals.bytes * (double)passes * 1e3 / elapsed);
+
+    valid_count = 0;
+    for (i = 0; i < set.count; i++) {
+      valid[i] = dcwmsg_marshal(&msgs[i], set.records[i].data, set.records[i].len);
+      if (valid[i]) valid_count++;
+    }
+    elapsed = time_serialize(&set, msgs, valid, passes, &serialize_bytes);
+    printf("serialize: %.0f msgs/sec, %.1f MB/sec\n",
+      (double)valid_count * (double)passes * 1e9 / elapsed,
+      (double)serialize_bytes * 1e3 / elapsed);
+
+    free(msgs);
+    free(valid);
+  }
+
+  return (totals.mismatched == 0) ? 0 : 1;
+}